@@ -0,0 +1,128 @@
+#include <algorithm>
+#include "AddrIndex.h"
+
+int AddrIndex::add_scope(uint64_t id, Dwarf32::Tag tag, int parent)
+{
+  AddrScope s;
+  s.id = id;
+  s.tag = tag;
+  s.parent = parent;
+  if ( parent >= 0 )
+    s.depth = m_scopes[parent].depth + 1;
+  m_scopes.push_back(s);
+  return (int)m_scopes.size() - 1;
+}
+
+void AddrIndex::add_range(int scope, uint64_t start, uint64_t end)
+{
+  if ( start >= end ) return;
+  m_raw.push_back( { start, end, scope } );
+}
+
+void AddrIndex::add_decl(uint64_t id, const char *name, const char *link_name, uint64_t origin)
+{
+  m_decls[id] = { name, link_name, origin };
+}
+
+void AddrIndex::clear()
+{
+  m_scopes.clear();
+  m_raw.clear();
+  m_decls.clear();
+  m_starts.clear();
+  m_ends.clear();
+  m_idx.clear();
+}
+
+void AddrIndex::add_segment(uint64_t start, uint64_t end, int scope)
+{
+  if ( start >= end ) return;
+  // merge with previous segment of the same scope
+  if ( !m_starts.empty() && m_ends.back() == start && m_idx.back() == scope )
+  {
+    m_ends.back() = end;
+    return;
+  }
+  m_starts.push_back(start);
+  m_ends.push_back(end);
+  m_idx.push_back(scope);
+}
+
+// sweep ranges sorted by start (outer scopes first) keeping stack of active ranges
+// nested ranges split outer ones so each address has exactly one innermost segment
+void AddrIndex::build()
+{
+  m_starts.clear();
+  m_ends.clear();
+  m_idx.clear();
+  if ( m_raw.empty() ) return;
+  std::sort(m_raw.begin(), m_raw.end(), [&](const raw_range &a, const raw_range &b) {
+    if ( a.start != b.start ) return a.start < b.start;
+    if ( a.end != b.end ) return a.end > b.end;
+    return m_scopes[a.scope].depth < m_scopes[b.scope].depth;
+  });
+  m_starts.reserve(m_raw.size());
+  m_ends.reserve(m_raw.size());
+  m_idx.reserve(m_raw.size());
+  std::vector<raw_range> stack;
+  uint64_t pos = m_raw.front().start;
+  for ( auto r: m_raw )
+  {
+    while ( !stack.empty() && stack.back().end <= r.start )
+    {
+      add_segment(pos, stack.back().end, stack.back().scope);
+      pos = std::max(pos, stack.back().end);
+      stack.pop_back();
+    }
+    if ( !stack.empty() )
+    {
+      add_segment(pos, r.start, stack.back().scope);
+      // broken nesting - clip to enclosing range
+      if ( r.end > stack.back().end )
+        r.end = stack.back().end;
+    }
+    pos = r.start;
+    stack.push_back(r);
+  }
+  while ( !stack.empty() )
+  {
+    add_segment(pos, stack.back().end, stack.back().scope);
+    pos = std::max(pos, stack.back().end);
+    stack.pop_back();
+  }
+  m_raw.clear();
+  m_raw.shrink_to_fit();
+}
+
+int AddrIndex::find(uint64_t pc) const
+{
+  auto si = std::upper_bound(m_starts.begin(), m_starts.end(), pc);
+  if ( si == m_starts.begin() ) return -1;
+  size_t i = si - m_starts.begin() - 1;
+  if ( pc >= m_ends[i] ) return -1;
+  return m_idx[i];
+}
+
+bool AddrIndex::find_chain(uint64_t pc, std::vector<const AddrScope *> &res) const
+{
+  for ( int i = find(pc); i >= 0; i = m_scopes[i].parent )
+    res.push_back(&m_scopes[i]);
+  return !res.empty();
+}
+
+const char *AddrIndex::get_name(const AddrScope *s) const
+{
+  if ( s->link_name ) return s->link_name;
+  if ( s->name ) return s->name;
+  // follow origin, limit depth to avoid loops in broken dwarf
+  uint64_t origin = s->origin;
+  for ( int i = 0; i < 8 && origin; i++ )
+  {
+    auto di = m_decls.find(origin);
+    if ( di == m_decls.end() ) break;
+    if ( di->second.link_name ) return di->second.link_name;
+    if ( di->second.name ) return di->second.name;
+    origin = di->second.origin;
+  }
+  return nullptr;
+}
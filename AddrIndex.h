@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include "dwarf32.h"
+
+// scope with address ranges - subprogram, inlined subroutine or lexical block
+struct AddrScope
+{
+  uint64_t id;          // tag id
+  uint64_t origin = 0;  // DW_AT_abstract_origin or DW_AT_specification
+  const char *name = nullptr;
+  const char *link_name = nullptr;
+  int parent = -1;      // index of enclosing scope
+  unsigned short depth = 0;
+  Dwarf32::Tag tag;
+};
+
+// whole-binary interval index of functions address ranges
+// after build() ranges stored as non-overlapping segments with innermost scope for each
+// in sorted m_starts and parallel m_ends/m_idx - so lookup is just binary search
+class AddrIndex
+{
+ public:
+  int add_scope(uint64_t id, Dwarf32::Tag tag, int parent);
+  inline AddrScope &scope(int idx)
+  {
+    return m_scopes[idx];
+  }
+  void add_range(int scope, uint64_t start, uint64_t end);
+  // names of subprograms without addresses (declarations and abstract instances)
+  void add_decl(uint64_t id, const char *name, const char *link_name, uint64_t origin);
+  void build();
+  // returns index of innermost scope containing pc or -1
+  int find(uint64_t pc) const;
+  // fills chain of scopes from innermost to outer function
+  bool find_chain(uint64_t pc, std::vector<const AddrScope *> &) const;
+  // resolve name through abstract_origin/specification chain
+  const char *get_name(const AddrScope *) const;
+  size_t size() const
+  {
+    return m_starts.size();
+  }
+  void clear();
+ protected:
+  struct raw_range {
+    uint64_t start, end;
+    int scope;
+  };
+  struct decl_name {
+    const char *name, *link_name;
+    uint64_t origin;
+  };
+  std::vector<AddrScope> m_scopes;
+  std::vector<raw_range> m_raw;
+  std::unordered_map<uint64_t, decl_name> m_decls;
+  // built index
+  std::vector<uint64_t> m_starts, m_ends;
+  std::vector<int> m_idx;
+  void add_segment(uint64_t start, uint64_t end, int scope);
+};
@@ -0,0 +1,227 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+// memory-mappable binary database of types, functions & vars produced by BinRender
+// all sections are aligned to 8 bytes, integers have byte order of producing machine
+// reader can mmap whole file and use bdb_view below without any deserialization
+// this format also can be used as on-disk cache of parsed dwarf
+
+#define BDB_MAGIC "DWDB"
+#define BDB_VERSION 1
+
+enum bdb_sect {
+  bs_strings = 0, // count is size in bytes, offset 0 is empty string
+  bs_units,
+  bs_elements, // sorted by id (offset of DIE)
+  bs_members,
+  bs_params,
+  bs_enums,
+  bs_parents,
+  bs_names, // sorted by name
+  bs_addrs, // sorted by address
+  bs_max
+};
+
+struct bdb_section {
+  uint64_t off; // from start of file
+  uint64_t count;
+};
+
+struct bdb_hdr {
+  char magic[4];
+  uint32_t version;
+  uint32_t hdr_size;
+  uint32_t n_sections;
+  bdb_section sec[bs_max];
+};
+
+// strings are offsets in string table
+struct bdb_unit {
+  uint32_t name,
+   comp_dir,
+   producer,
+   package;
+  uint32_t lang;
+  uint32_t pad;
+  uint64_t base_addr;
+};
+
+enum bdb_flags {
+  bf_noret = 1,
+  bf_decl = 2,
+  bf_const_expr = 4,
+  bf_has_range = 8,
+  bf_enum_class = 0x10,
+  bf_gnu_vector = 0x20,
+  bf_tensor = 0x40,
+  bf_dumped = 0x80,
+  bf_inlined = 0x100,
+  bf_virt = 0x200, // for methods
+  bf_artificial = 0x400,
+};
+
+// arrays of members, params, enums & parents are ranges [first, first + n)
+struct bdb_element {
+  uint64_t id,
+   type_id,
+   owner, // id of owner or 0
+   addr,
+   size,
+   count;
+  uint32_t name,
+   link_name,
+   file,
+   unit;
+  uint32_t members, n_members,
+   params, n_params,
+   enums, n_enums,
+   parents, n_parents;
+  uint16_t kind; // ElementType
+  unsigned char ate, addr_class;
+  uint32_t flags;
+};
+
+struct bdb_member {
+  uint64_t id,
+   type_id,
+   offset;
+  uint32_t name;
+  int32_t bit_offset,
+   bit_size;
+  unsigned char access,
+   addr_class;
+  uint16_t pad;
+};
+
+struct bdb_param {
+  uint64_t id, // type id
+   param_id;
+  uint32_t name;
+  unsigned char pdir;
+  unsigned char flags; // 1 - ellipsis, 2 - variable, 4 - artificial, 8 - optional
+  uint16_t pad;
+};
+
+struct bdb_enum {
+  uint64_t value;
+  uint32_t name;
+  uint32_t pad;
+};
+
+struct bdb_parent {
+  uint64_t id,
+   offset;
+  uint32_t access;
+  uint32_t virtual_;
+};
+
+struct bdb_name {
+  uint32_t name;
+  uint32_t el; // index in elements
+};
+
+struct bdb_addr {
+  uint64_t addr;
+  uint32_t el;
+  uint32_t pad;
+};
+
+// read-only access to mapped database
+struct bdb_view
+{
+  const char *base = nullptr;
+  size_t size = 0;
+  const bdb_hdr *hdr = nullptr;
+  // returns false if this is not valid database
+  bool attach(const void *data, size_t len)
+  {
+    if ( len < sizeof(bdb_hdr) )
+      return false;
+    auto h = (const bdb_hdr *)data;
+    if ( memcmp(h->magic, BDB_MAGIC, 4) || h->version != BDB_VERSION || h->n_sections < bs_max )
+      return false;
+    // each section must be aligned and fit in file
+    static const size_t el_sizes[bs_max] = {
+      1, sizeof(bdb_unit), sizeof(bdb_element), sizeof(bdb_member), sizeof(bdb_param),
+      sizeof(bdb_enum), sizeof(bdb_parent), sizeof(bdb_name), sizeof(bdb_addr)
+    };
+    for ( int i = 0; i < bs_max; i++ )
+    {
+      auto &s = h->sec[i];
+      if ( (s.off & 7) || s.off > len || s.count > (len - s.off) / el_sizes[i] )
+        return false;
+    }
+    // string table must have at least empty string at offset 0 and terminate last string
+    auto &ss = h->sec[bs_strings];
+    if ( !ss.count || ((const char *)data)[ss.off + ss.count - 1] )
+      return false;
+    base = (const char *)data;
+    size = len;
+    hdr = h;
+    return true;
+  }
+  template <typename T>
+  inline const T *sect(bdb_sect s) const
+  {
+    return (const T *)(base + hdr->sec[s].off);
+  }
+  inline uint64_t count(bdb_sect s) const
+  {
+    return hdr->sec[s].count;
+  }
+  inline const char *str(uint32_t off) const
+  {
+    return sect<char>(bs_strings) + off;
+  }
+  const bdb_element *find_id(uint64_t id) const
+  {
+    auto els = sect<bdb_element>(bs_elements);
+    uint64_t lo = 0, hi = count(bs_elements);
+    while( lo < hi )
+    {
+      auto mid = (lo + hi) / 2;
+      if ( els[mid].id < id )
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    if ( lo < count(bs_elements) && els[lo].id == id )
+      return els + lo;
+    return nullptr;
+  }
+  // first entry in names index with this name, equal names follow it
+  const bdb_name *find_name(const char *name) const
+  {
+    auto names = sect<bdb_name>(bs_names);
+    uint64_t lo = 0, hi = count(bs_names);
+    while( lo < hi )
+    {
+      auto mid = (lo + hi) / 2;
+      if ( strcmp(str(names[mid].name), name) < 0 )
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    if ( lo < count(bs_names) && !strcmp(str(names[lo].name), name) )
+      return names + lo;
+    return nullptr;
+  }
+  // element with biggest address <= addr
+  const bdb_element *find_addr(uint64_t addr) const
+  {
+    auto addrs = sect<bdb_addr>(bs_addrs);
+    uint64_t lo = 0, hi = count(bs_addrs);
+    while( lo < hi )
+    {
+      auto mid = (lo + hi) / 2;
+      if ( addrs[mid].addr <= addr )
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    if ( !lo )
+      return nullptr;
+    return sect<bdb_element>(bs_elements) + addrs[lo - 1].el;
+  }
+};
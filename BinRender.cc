@@ -0,0 +1,213 @@
+#include <algorithm>
+#include "BinRender.h"
+
+uint32_t BinRender::add_str(const char *s)
+{
+  if ( !s )
+    return 0;
+  auto si = m_str_idx.find(s);
+  if ( si != m_str_idx.end() )
+    return si->second;
+  uint32_t res = m_strs.size();
+  m_strs.append(s);
+  m_strs.push_back(0);
+  m_str_idx.emplace(s, res);
+  return res;
+}
+
+void BinRender::RenderUnit(int last)
+{
+  uint32_t unit = m_units.size();
+  bdb_unit u;
+  memset(&u, 0, sizeof(u));
+  u.name = add_str(cu.cu_name);
+  u.comp_dir = add_str(cu.cu_comp_dir);
+  u.producer = add_str(cu.cu_producer);
+  u.package = add_str(cu.cu_package);
+  u.lang = cu.cu_lang;
+  u.base_addr = cu.cu_base_addr;
+  m_units.push_back(u);
+  for ( auto &e: elements_ )
+  {
+    if ( e.type_ == ElementType::ns_start || e.type_ == ElementType::ns_end || e.type_ == ElementType::lexical_block )
+      continue;
+    if ( e.type_ == ElementType::var_type && e.dumped_ )
+      continue;
+    add_element(e, unit);
+    if ( e.m_comp )
+      for ( auto &m: e.m_comp->methods_ )
+        add_element(m, unit);
+  }
+}
+
+void BinRender::add_element(Element &e, uint32_t unit)
+{
+  bdb_element be;
+  memset(&be, 0, sizeof(be));
+  be.id = e.id_;
+  be.type_id = e.type_ == ElementType::member ? get_replaced_type(e.type_id_) : e.type_id_;
+  be.owner = e.owner_ ? e.owner_->id_ : 0;
+  be.addr = e.addr_;
+  be.size = e.size_;
+  be.count = e.count_;
+  be.name = add_str(e.name_);
+  if ( e.link_name_ && e.link_name_ != e.name_ )
+    be.link_name = add_str(e.link_name_);
+  auto fname = e.get_fullname();
+  be.file = fname ? add_str(fname->c_str()) : add_str(e.fname_);
+  be.unit = unit;
+  be.kind = e.type_;
+  be.ate = e.ate_;
+  be.addr_class = e.addr_class_;
+  if ( e.noret_ ) be.flags |= bf_noret;
+  if ( e.decl_ ) be.flags |= bf_decl;
+  if ( e.const_expr_ ) be.flags |= bf_const_expr;
+  if ( e.has_range_ ) be.flags |= bf_has_range;
+  if ( e.enum_class_ ) be.flags |= bf_enum_class;
+  if ( e.gnu_vector_ ) be.flags |= bf_gnu_vector;
+  if ( e.tensor_ ) be.flags |= bf_tensor;
+  if ( e.dumped_ ) be.flags |= bf_dumped;
+  if ( e.inlined_ ) be.flags |= bf_inlined;
+  if ( e.type_ == ElementType::method )
+  {
+    Method &m = static_cast<Method &>(e);
+    if ( m.virt_ ) be.flags |= bf_virt;
+    if ( m.art_ ) be.flags |= bf_artificial;
+  }
+  if ( e.addr_ )
+    m_addrs.push_back({ e.addr_, e.id_ });
+  else if ( e.has_range_ )
+  {
+    std::list<std::pair<uint64_t, uint64_t> > ranges;
+    if ( lookup_range(e.id_, ranges) )
+      for ( auto &r: ranges )
+        m_addrs.push_back({ r.first, e.id_ });
+  }
+  if ( e.m_comp )
+  {
+    auto c = e.m_comp;
+    be.members = m_members.size();
+    be.n_members = c->members_.size();
+    for ( auto &m: c->members_ )
+    {
+      bdb_member bm;
+      memset(&bm, 0, sizeof(bm));
+      bm.id = m.id_;
+      bm.type_id = m.type_id_ ? get_replaced_type(m.type_id_) : 0;
+      bm.offset = m.offset_;
+      bm.name = add_str(m.name_);
+      bm.bit_offset = m.bit_offset_;
+      bm.bit_size = m.bit_size_;
+      bm.access = m.access_;
+      bm.addr_class = m.addr_class_;
+      m_members.push_back(bm);
+    }
+    be.params = m_params.size();
+    be.n_params = c->params_.size();
+    for ( auto &p: c->params_ )
+    {
+      bdb_param bp;
+      memset(&bp, 0, sizeof(bp));
+      bp.id = p.id;
+      bp.param_id = p.param_id;
+      bp.name = add_str(p.name);
+      bp.pdir = p.pdir;
+      bp.flags = (p.ellipsis ? 1 : 0) | (p.var_ ? 2 : 0) | (p.art_ ? 4 : 0) | (p.optional_ ? 8 : 0);
+      m_params.push_back(bp);
+    }
+    be.enums = m_enums.size();
+    be.n_enums = c->enums_.size();
+    for ( auto &en: c->enums_ )
+      m_enums.push_back({ en.value, add_str(en.name), 0 });
+    be.parents = m_parents.size();
+    be.n_parents = c->parents_.size();
+    for ( auto &p: c->parents_ )
+      m_parents.push_back({ get_replaced_type(p.id), p.offset, (uint32_t)p.access, p.virtual_ });
+  }
+  m_els.push_back(be);
+}
+
+void BinRender::put_pad(uint64_t &off)
+{
+  static const char zeros[8] = { 0 };
+  size_t pad = (8 - (off & 7)) & 7;
+  if ( pad )
+    g_sink->put(zeros, pad);
+  off += pad;
+}
+
+template <typename T>
+void BinRender::put_sect(const std::vector<T> &v, uint64_t &off)
+{
+  size_t size = v.size() * sizeof(T);
+  if ( size )
+    g_sink->put((const char *)v.data(), size);
+  off += size;
+  put_pad(off);
+}
+
+void BinRender::end_output()
+{
+  if ( !g_sink )
+    return;
+  // element table in DIE offset order
+  std::sort(m_els.begin(), m_els.end(), [](const bdb_element &a, const bdb_element &b) { return a.id < b.id; });
+  auto el_idx = [&](uint64_t id) -> uint32_t {
+    auto ei = std::lower_bound(m_els.begin(), m_els.end(), id, [](const bdb_element &a, uint64_t id) { return a.id < id; });
+    return ei - m_els.begin();
+  };
+  std::vector<bdb_addr> addrs;
+  addrs.reserve(m_addrs.size());
+  for ( auto &a: m_addrs )
+    addrs.push_back({ a.first, el_idx(a.second), 0 });
+  std::sort(addrs.begin(), addrs.end(), [](const bdb_addr &a, const bdb_addr &b) { return a.addr < b.addr; });
+  // names index
+  std::vector<bdb_name> names;
+  for ( uint32_t i = 0; i < m_els.size(); i++ )
+  {
+    if ( m_els[i].name )
+      names.push_back({ m_els[i].name, i });
+    if ( m_els[i].link_name )
+      names.push_back({ m_els[i].link_name, i });
+  }
+  const char *strs = m_strs.data();
+  std::sort(names.begin(), names.end(), [strs](const bdb_name &a, const bdb_name &b) {
+    int r = strcmp(strs + a.name, strs + b.name);
+    if ( r )
+      return r < 0;
+    return a.el < b.el;
+  });
+  // header
+  bdb_hdr h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, BDB_MAGIC, 4);
+  h.version = BDB_VERSION;
+  h.hdr_size = sizeof(h);
+  h.n_sections = bs_max;
+  // calc offsets first - sections are written sequentially after header
+  uint64_t off = sizeof(h);
+  auto align = [](uint64_t v) { return (v + 7) & ~(uint64_t)7; };
+  h.sec[bs_strings] = { off, m_strs.size() }; off = align(off + m_strs.size());
+  h.sec[bs_units] = { off, m_units.size() }; off = align(off + m_units.size() * sizeof(bdb_unit));
+  h.sec[bs_elements] = { off, m_els.size() }; off = align(off + m_els.size() * sizeof(bdb_element));
+  h.sec[bs_members] = { off, m_members.size() }; off = align(off + m_members.size() * sizeof(bdb_member));
+  h.sec[bs_params] = { off, m_params.size() }; off = align(off + m_params.size() * sizeof(bdb_param));
+  h.sec[bs_enums] = { off, m_enums.size() }; off = align(off + m_enums.size() * sizeof(bdb_enum));
+  h.sec[bs_parents] = { off, m_parents.size() }; off = align(off + m_parents.size() * sizeof(bdb_parent));
+  h.sec[bs_names] = { off, names.size() }; off = align(off + names.size() * sizeof(bdb_name));
+  h.sec[bs_addrs] = { off, addrs.size() };
+  g_sink->put((const char *)&h, sizeof(h));
+  // and now data in the same order
+  off = sizeof(h);
+  g_sink->put(m_strs.data(), m_strs.size());
+  off += m_strs.size();
+  put_pad(off);
+  put_sect(m_units, off);
+  put_sect(m_els, off);
+  put_sect(m_members, off);
+  put_sect(m_params, off);
+  put_sect(m_enums, off);
+  put_sect(m_parents, off);
+  put_sect(names, off);
+  put_sect(addrs, off);
+}
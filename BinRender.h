@@ -0,0 +1,32 @@
+#pragma once
+#include "TreeBuilder.h"
+#include "BinDb.h"
+
+// collects all units and writes binary database described in BinDb.h
+class BinRender: public TreeBuilder
+{
+  public:
+    BinRender(ErrLog *e): TreeBuilder(e)
+    {
+      add_str("");
+    }
+    // must be called after all units were processed
+    void end_output();
+  protected:
+    virtual void RenderUnit(int last);
+    void add_element(Element &, uint32_t unit);
+    uint32_t add_str(const char *);
+    template <typename T>
+    void put_sect(const std::vector<T> &, uint64_t &off);
+    void put_pad(uint64_t &off);
+    std::string m_strs;
+    std::unordered_map<std::string, uint32_t> m_str_idx;
+    std::vector<bdb_unit> m_units;
+    std::vector<bdb_element> m_els;
+    std::vector<bdb_member> m_members;
+    std::vector<bdb_param> m_params;
+    std::vector<bdb_enum> m_enums;
+    std::vector<bdb_parent> m_parents;
+    // address & id of element, index is known only after sorting of elements
+    std::vector<std::pair<uint64_t, uint64_t> > m_addrs;
+};
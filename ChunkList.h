@@ -0,0 +1,200 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <utility>
+#include <new>
+#include <iterator>
+#include <cstddef>
+#include "MemStats.h"
+
+// append-only container with stable addresses of items
+// items stored in chunks with geometric growth of size, so there are few allocations
+// instead of one heap node per item like in std::list. all items destroyed in bulk by clear
+// container can be moved - chunks moved too, so pointers to items remain valid
+// First & Max are sizes of first and biggest chunks, small ones are for children of single element
+// both are powers of 2, so chunk of item can be calculated from its index
+// K is kind of memory counter for --mem-stats
+template <typename T, size_t First = 32, size_t Max = 4096, MemKind K = mk_max>
+class ChunkList
+{
+  static_assert( First && !(First & (First - 1)), "First must be power of 2" );
+  static_assert( Max >= First && !(Max & (Max - 1)), "Max must be power of 2" );
+  // number of growing chunks First, 2 * First ... Max and total size of them
+  static constexpr size_t s_grow = __builtin_ctzll(Max / First) + 1;
+  static constexpr size_t s_grow_size = 2 * Max - First;
+  struct chunk {
+    T *data;
+    size_t count, cap;
+  };
+ public:
+  template <typename V>
+  class iter
+  {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef V value_type;
+    typedef ptrdiff_t difference_type;
+    typedef V *pointer;
+    typedef V &reference;
+    iter(const std::vector<chunk> *c, size_t ci, size_t pos)
+     : m_c(c), m_ci(ci), m_pos(pos)
+    {}
+    V &operator*() const
+    {
+      return (*m_c)[m_ci].data[m_pos];
+    }
+    V *operator->() const
+    {
+      return (*m_c)[m_ci].data + m_pos;
+    }
+    iter &operator++()
+    {
+      if ( ++m_pos >= (*m_c)[m_ci].count )
+      {
+        m_ci++;
+        m_pos = 0;
+      }
+      return *this;
+    }
+    iter operator++(int)
+    {
+      iter res = *this;
+      ++*this;
+      return res;
+    }
+    bool operator==(const iter &o) const
+    {
+      return m_ci == o.m_ci && m_pos == o.m_pos;
+    }
+    bool operator!=(const iter &o) const
+    {
+      return !(*this == o);
+    }
+   protected:
+    const std::vector<chunk> *m_c;
+    size_t m_ci, m_pos;
+  };
+  typedef iter<T> iterator;
+  typedef iter<const T> const_iterator;
+
+  ChunkList() = default;
+  ChunkList(const ChunkList &) = delete;
+  ChunkList &operator=(const ChunkList &) = delete;
+  ChunkList(ChunkList &&o) noexcept
+   : m_chunks(std::move(o.m_chunks)), m_size(o.m_size)
+  {
+    o.m_chunks.clear();
+    o.m_size = 0;
+  }
+  ChunkList &operator=(ChunkList &&o) noexcept
+  {
+    if ( this != &o )
+    {
+      clear();
+      m_chunks = std::move(o.m_chunks);
+      m_size = o.m_size;
+      o.m_chunks.clear();
+      o.m_size = 0;
+    }
+    return *this;
+  }
+  ~ChunkList()
+  {
+    clear();
+  }
+  template <typename... Args>
+  T &emplace_back(Args&&... args)
+  {
+    if ( m_chunks.empty() || m_chunks.back().count == m_chunks.back().cap )
+      add_chunk();
+    auto &c = m_chunks.back();
+    T *res = new (c.data + c.count) T(std::forward<Args>(args)...);
+    c.count++;
+    m_size++;
+    if constexpr ( K != mk_max )
+      g_mem[K].objects++;
+    return *res;
+  }
+  void push_back(T &&v)
+  {
+    emplace_back(std::move(v));
+  }
+  T &back()
+  {
+    auto &c = m_chunks.back();
+    return c.data[c.count - 1];
+  }
+  T &front()
+  {
+    return m_chunks.front().data[0];
+  }
+  // all chunks except last are full, so chunk index is log2 of idx while chunks grow
+  // and then each has Max items
+  T &operator[](size_t idx)
+  {
+    if ( idx >= m_size )
+      return back();
+    if ( idx < s_grow_size )
+    {
+      size_t ci = 63 - __builtin_clzll(idx / First + 1);
+      return m_chunks[ci].data[idx - First * ((size_t(1) << ci) - 1)];
+    }
+    idx -= s_grow_size;
+    return m_chunks[s_grow + idx / Max].data[idx % Max];
+  }
+  T &at(size_t idx)
+  {
+    return (*this)[idx];
+  }
+  inline size_t size() const
+  {
+    return m_size;
+  }
+  inline bool empty() const
+  {
+    return !m_size;
+  }
+  void clear()
+  {
+    std::allocator<T> a;
+    for ( auto &c: m_chunks )
+    {
+      for ( size_t i = 0; i < c.count; i++ )
+        c.data[i].~T();
+      a.deallocate(c.data, c.cap);
+      if constexpr ( K != mk_max )
+        g_mem[K].sub(c.cap * sizeof(T), c.count);
+    }
+    m_chunks.clear();
+    m_size = 0;
+  }
+  iterator begin()
+  {
+    return iterator(&m_chunks, 0, 0);
+  }
+  iterator end()
+  {
+    return iterator(&m_chunks, m_chunks.size(), 0);
+  }
+  const_iterator begin() const
+  {
+    return const_iterator(&m_chunks, 0, 0);
+  }
+  const_iterator end() const
+  {
+    return const_iterator(&m_chunks, m_chunks.size(), 0);
+  }
+ protected:
+  void add_chunk()
+  {
+    size_t cap = m_chunks.empty() ? First : m_chunks.back().cap * 2;
+    if ( cap > Max )
+      cap = Max;
+    std::allocator<T> a;
+    m_chunks.push_back( { a.allocate(cap), 0, cap } );
+    if constexpr ( K != mk_max )
+      g_mem[K].add(cap * sizeof(T), 0);
+  }
+  std::vector<chunk> m_chunks;
+  size_t m_size = 0;
+};
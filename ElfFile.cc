@@ -1,12 +1,15 @@
 #include "ElfFile.h"
 #include "debug.h"
+#include "Timings.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <zlib.h>
 #include <elf.h>
+#include <algorithm>
 
-int g_opt_d = 0,
+int g_opt_a = 0,
+    g_opt_d = 0,
     g_opt_f = 0,
     g_opt_F = 0,
     g_opt_g = 0,
@@ -15,6 +18,8 @@ int g_opt_d = 0,
     g_opt_m = 0,
     g_opt_s = 0,
     g_opt_L = 0,
+    g_opt_M = 0, // memory budget in Mb for -g option
+    g_opt_T = 0, // threads for rendering, 0 - number of cpus
     g_opt_V = 0,
     g_opt_v = 0,
     g_opt_x = 0,
@@ -45,6 +50,7 @@ void dump2file(ELFIO::section *s, const char *pfx, const void *data, size_t size
 template <typename T>
 bool ElfFile::uncompressed_section(ELFIO::section *s, const unsigned char * &data, size_t &size)
 {
+  PhaseTimer pt(tp_decompress);
   data = nullptr;
   if ( s->get_size() < sizeof(T) )
   {
@@ -91,6 +97,8 @@ bool ElfFile::check_compressed_section(ELFIO::section *s, dwarf_section &dw)
     dw.free_ = uncompressed_section<Elf64_Chdr>(s, dw.s_, dw.size_);
   else
     dw.free_ = uncompressed_section<Elf32_Chdr>(s, dw.s_, dw.size_);
+  if ( dw.free_ )
+    g_mem[mk_sections].add(dw.size_);
   return dw.free_;
 }
 
@@ -98,6 +106,7 @@ const size_t czSize = 4 + sizeof(uint64_t);
 
 bool ElfFile::unzip_section(ELFIO::section *s, const unsigned char * &data, size_t &size)
 {
+  PhaseTimer pt(tp_decompress);
   if ( s->get_size() < czSize )
   {
     tree_builder->e_->error("section %s is too short, size %lX\n", s->get_name().c_str(), s->get_size());
@@ -142,16 +151,54 @@ ElfReaderOwner::ElfReaderOwner(std::string filepath, bool& success, TreeBuilder
   ElfFile(tb)
 {
   // read elf file
-  if ( !m_elf.load(filepath.c_str()) )
+  bool loaded;
+  {
+    PhaseTimer pt(tp_load);
+    loaded = m_elf.load(filepath.c_str());
+  }
+  if ( !loaded )
   {
     tb->e_->error("ERR: Failed to open '%s'\n", filepath.c_str());
     success = false;
     return;
   }
   reader = &m_elf;
+  check_shnum(filepath.c_str());
   cmn_read(success);
 }
 
+static uint64_t raw_get(const unsigned char *p, int size, bool lsb)
+{
+  uint64_t res = 0;
+  for ( int i = 0; i < size; i++ )
+    res |= (uint64_t)p[lsb ? i : size - 1 - i] << (8 * i);
+  return res;
+}
+
+// with more than 0xff00 sections e_shnum is 0 and real count stored in sh_size of section 0
+// ELFIO reads only e_shnum sections, so such files cannot be processed - just report it
+void ElfReaderOwner::check_shnum(const char *fname)
+{
+  FILE *fp = fopen(fname, "rb");
+  if ( !fp ) return;
+  unsigned char hdr[0x40], shdr[0x40];
+  bool is64 = reader->get_class() == ELFCLASS64,
+    lsb = reader->get_encoding() == ELFDATA2LSB;
+  uint64_t shnum = 0, shoff = 0;
+  if ( fread(hdr, 1, sizeof(hdr), fp) == sizeof(hdr) )
+  {
+    shoff = is64 ? raw_get(hdr + 0x28, 8, lsb) : raw_get(hdr + 0x20, 4, lsb);
+    shnum = is64 ? raw_get(hdr + 0x3c, 2, lsb) : raw_get(hdr + 0x30, 2, lsb);
+  }
+  if ( !shnum && shoff && !fseek(fp, shoff, SEEK_SET) && fread(shdr, 1, sizeof(shdr), fp) == sizeof(shdr) )
+  {
+    shnum = is64 ? raw_get(shdr + 0x20, 8, lsb) : raw_get(shdr + 0x14, 4, lsb);
+    if ( shnum > reader->sections.size() )
+      tree_builder->e_->warning("%s has %ld sections, only %d of them can be read\n", fname, shnum, (int)reader->sections.size());
+  }
+  fclose(fp);
+}
+
 void ElfFile::cmn_read(bool& success)
 {
   if ( reader->get_class() == ELFCLASS32 )
@@ -175,10 +222,11 @@ void ElfFile::cmn_read(bool& success)
    *zloclists = nullptr,
    *zrnglists = nullptr,
    *zranges = nullptr,
-   *zframe = nullptr;
+   *zframe = nullptr,
+   *zaranges = nullptr;
   // Search the debug sections, mandatory are .debug_info and .debug_abbrev
-  Elf_Half n = reader->sections.size();
-  for ( Elf_Half i = 0; i < n; i++) {
+  Elf_Word n = reader->sections.size();
+  for ( Elf_Word i = 0; i < n; i++) {
     section *s = reader->sections[i];
     auto sn = s->get_name();
     const char* name = sn.c_str();
@@ -190,64 +238,69 @@ void ElfFile::cmn_read(bool& success)
     }
     if ( machine == EM_CUDA ) {
       if ( !g_opt_m && !strcmp(name, ".nv_debug_info_reg_sass") ) {
-        cuda_sass_regs.asgn(s);
+        cuda_sass_regs.asgn(s, i);
         continue;
       } else if ( !g_opt_m && g_opt_F && !strcmp(name, ".nv_debug_line_sass")) {
-        debug_line_.asgn(s);
+        debug_line_.asgn(s, i);
         check_compressed_section(s, debug_line_);
         continue;
       } else if ( g_opt_m && !strcmp(name, ".nv_debug_info_reg_sass") ) { // prefix .nv.merc was removed above
-        cuda_sass_mregs.asgn(s);
+        cuda_sass_mregs.asgn(s, i);
         continue;
       }
     }
     if (!strcmp(name, ".debug_info")) {
-      debug_info_.asgn(s);
+      debug_info_.asgn(s, i);
       check_compressed_section(s, debug_info_);
     } else if (!strcmp(name, ".debug_abbrev")) {
-      debug_abbrev_.asgn(s);
+      debug_abbrev_.asgn(s, i);
       check_compressed_section(s, debug_abbrev_);
     } else if (!strcmp(name, ".debug_str")) {
-      debug_str_.asgn(s);
+      debug_str_.asgn(s, i);
       check_compressed_section(s, debug_str_);
       tree_builder->debug_str_ = debug_str_.s_;
       tree_builder->debug_str_size_ = debug_str_.size_;
     } else if (!strcmp(s->get_name().c_str(), ".debug_loclists")) {
-      debug_loclists_.asgn(s);
+      debug_loclists_.asgn(s, i);
       check_compressed_section(s, debug_loclists_);
     } else if (!strcmp(s->get_name().c_str(), ".debug_str_offsets")) {
-      debug_str_offsets_.asgn(s);
+      debug_str_offsets_.asgn(s, i);
       check_compressed_section(s, debug_str_offsets_);
       // printf("debug_str_offsets_size %lx\n", debug_str_offsets_.size_);
     } else if (!strcmp(s->get_name().c_str(), ".debug_addr")) {
-      debug_addr_.asgn(s);
+      debug_addr_.asgn(s, i);
       check_compressed_section(s, debug_addr_);
     } else if (g_opt_f && !strcmp(name, ".debug_frame")) {
-      debug_frame_.asgn(s);
+      debug_frame_.asgn(s, i);
       check_compressed_section(s, debug_frame_);
+    } else if (g_opt_f && !strcmp(name, ".eh_frame_hdr")) {
+      eh_frame_hdr_.asgn(s, i);
     } else if (g_opt_f && !strcmp(name, ".eh_frame")) {
       is_eh = true;
-      debug_frame_.asgn(s);
+      debug_frame_.asgn(s, i);
       check_compressed_section(s, debug_frame_);
     // in go binaries .eh_frame section called .gopclntab
     } else if ( g_opt_f && !strcmp(name, ".gopclntab") && debug_frame_.empty()) {
       is_eh = true;
-      debug_frame_.asgn(s);
+      debug_frame_.asgn(s, i);
       check_compressed_section(s, debug_frame_);
-    } else if (g_opt_f && !strcmp(name, ".debug_ranges")) {
-      debug_ranges_.asgn(s);
+    } else if ((g_opt_f || g_opt_a) && !strcmp(name, ".debug_ranges")) {
+      debug_ranges_.asgn(s, i);
       check_compressed_section(s, debug_ranges_);
-    } else if (g_opt_f && !strcmp(name, ".debug_rnglists")) {
-      debug_rnglists_.asgn(s);
+    } else if ((g_opt_f || g_opt_a) && !strcmp(name, ".debug_rnglists")) {
+      debug_rnglists_.asgn(s, i);
       check_compressed_section(s, debug_rnglists_);
+    } else if (g_opt_a && !strcmp(name, ".debug_aranges")) {
+      debug_aranges_.asgn(s, i);
+      check_compressed_section(s, debug_aranges_);
     } else if (!strcmp(name, ".debug_loc")) {
-      debug_loc_.asgn(s);
+      debug_loc_.asgn(s, i);
       check_compressed_section(s, debug_loc_);
     } else if (g_opt_F && debug_line_.empty() && !strcmp(name, ".debug_line")) {
-      debug_line_.asgn(s);
+      debug_line_.asgn(s, i);
       check_compressed_section(s, debug_line_);
     } else if (g_opt_F && !strcmp(name, ".debug_line_str")) {
-      debug_line_str_.asgn(s);
+      debug_line_str_.asgn(s, i);
       check_compressed_section(s, debug_line_str_);
     } // check compressed versions
     else if ( !strcmp(name, ".zdebug_info") )
@@ -268,12 +321,14 @@ void ElfFile::cmn_read(bool& success)
       zaddr = s;
     else if ( !strcmp(name, ".zdebug_loclists") )
       zloclists = s;
-    else if ( g_opt_f && !strcmp(name, ".zdebug_rnglists") )
+    else if ( (g_opt_f || g_opt_a) && !strcmp(name, ".zdebug_rnglists") )
       zrnglists = s;
-    else if ( g_opt_f && !strcmp(name, ".zdebug_ranges") )
+    else if ( (g_opt_f || g_opt_a) && !strcmp(name, ".zdebug_ranges") )
       zranges = s;
     else if ( g_opt_f && !strcmp(name, ".zdebug_frame") )
       zframe = s;
+    else if ( g_opt_a && !strcmp(name, ".zdebug_aranges") )
+      zaranges = s;
   }
   // check if we need to decompress some sections
 #define UNPACK_ZSECTION(zsec, dw_sec) \
@@ -286,6 +341,7 @@ void ElfFile::cmn_read(bool& success)
       return; \
     } \
     dw_sec.free_ = true; \
+    g_mem[mk_sections].add(dw_sec.size_); \
   }
   UNPACK_ZSECTION(zinfo, debug_info_)
   UNPACK_ZSECTION(zabbrev, debug_abbrev_)
@@ -303,17 +359,46 @@ void ElfFile::cmn_read(bool& success)
   UNPACK_ZSECTION(zrnglists, debug_rnglists_)
   UNPACK_ZSECTION(zranges, debug_ranges_)
   UNPACK_ZSECTION(zframe, debug_frame_)
+  UNPACK_ZSECTION(zaranges, debug_aranges_)
 
   tree_builder->m_rnames = get_regnames(machine, reader->get_class() == ELFCLASS64);
   tree_builder->has_rngx = (debug_rnglists_.s_ != nullptr);
   success = (debug_info_.s_ && debug_abbrev_.s_);
   if ( !success) return;
-  success = try_apply_debug_relocs();
+  {
+    PhaseTimer pt(tp_relocs);
+    success = try_apply_debug_relocs();
+  }
   if ( !success ) return;
   if ( !had_relocs )
     tree_builder->m_snames = this;
-  parse_rnglists();
-  if ( g_opt_f ) parse_frames();
+  {
+    PhaseTimer pt(tp_rnglists);
+    parse_rnglists();
+  }
+  if ( g_opt_f )
+  {
+    // stripped section headers - try PT_GNU_EH_FRAME segment
+    if ( eh_frame_hdr_.empty() )
+    {
+      Elf_Half sn = reader->segments.size();
+      for ( Elf_Half i = 0; i < sn; i++ )
+      {
+        segment *seg = reader->segments[i];
+        if ( seg->get_type() != PT_GNU_EH_FRAME || !seg->get_data() ) continue;
+        eh_frame_hdr_.s_ = reinterpret_cast<const unsigned char*>(seg->get_data());
+        eh_frame_hdr_.size_ = seg->get_file_size();
+        eh_frame_hdr_.vma_ = seg->get_virtual_address();
+        break;
+      }
+      if ( !eh_frame_hdr_.empty() && debug_frame_.empty() )
+        locate_eh_frame();
+    }
+    // with .eh_frame_hdr FDEs are decoded lazily in find_fde
+    PhaseTimer pt(tp_frames);
+    if ( !setup_eh_frame_hdr() )
+      parse_frames();
+  }
 }
 
 // static
@@ -359,11 +444,26 @@ int64_t ElfFile::SLEB128(const unsigned char* &data, size_t& bytes_available) {
 }
 
 // CFA processing
+// FDE covering pc, with .eh_frame_hdr it is decoded here. must be called under m_lists_lock
+std::map<uint64_t, ElfFile::fde_item>::iterator ElfFile::find_fde(uint64_t pc)
+{
+  auto fi = m_dfa.upper_bound(pc);
+  if ( fi == m_dfa.begin() || pc >= (--fi)->second.end )
+  {
+    // not decoded yet
+    if ( !m_eh_table || !find_fde_lazy(pc) ) return m_dfa.end();
+    fi = m_dfa.upper_bound(pc);
+    if ( fi == m_dfa.begin() || pc >= (--fi)->second.end ) return m_dfa.end();
+  }
+  return fi;
+}
+
 bool ElfFile::find_dfa(uint64_t pc, uint64_t &res)
 {
-  auto fi = m_dfa.find(pc);
-  if ( fi == m_dfa.end() ) return false;
-  res = fi->second;
+  std::lock_guard<std::mutex> lock(m_lists_lock);
+  auto fi = find_fde(pc);
+  if ( fi == m_dfa.end() || !fi->second.has_dfa ) return false;
+  res = fi->second.dfa;
   return true;
 }
 
@@ -390,12 +490,20 @@ bool ElfFile::find_dfa(uint64_t pc, uint64_t &res)
 struct one_cie {
  unsigned char version, ptr_size, segment_size, fde_encoding = 0;
  const unsigned char *aug_data;
+ const unsigned char *init = nullptr, *init_end = nullptr; // initial instructions
  unsigned int code_factor, ra;
  int data_factor;
  const unsigned char *augmentation;
  uint64_t aug_data_len;
 };
 
+struct one_fde {
+ uint64_t pc_begin = 0, pc_range = 0;
+ unsigned int encoded_ptr_size = 0;
+ const unsigned char *instr = nullptr, *end = nullptr;
+ one_cie cie;
+};
+
 uint64_t ElfFile::byte_get(const unsigned char *start, unsigned int size)
 {
   switch (size) {
@@ -531,121 +639,527 @@ uint64_t ElfFile::get_encoded_value(const unsigned char **pdata, int encoding, c
   return val;
 }
 
+// read one CIE/FDE at start, returns pointer to next entry or nullptr if section is broken
+// is_fde is false for CIE
+const unsigned char *ElfFile::read_fde(const unsigned char *start, one_fde &fde, bool &is_fde)
+{
+  const unsigned char *end = debug_frame_.s_ + debug_frame_.size_;
+  const unsigned char *saved_start = start;
+  uint64_t length, cie_id;
+  unsigned int offset_size = 4,
+    save_eh_addr_size = eh_addr_size;
+  one_cie &cie = fde.cie;
+  is_fde = false;
+  if ( end - start < 4 ) return nullptr;
+  length = endc( *(const uint32_t *)start );
+  start += 4;
+  if ( length == 0xffffffff )
+  {
+    if ( end - start < 8 ) return nullptr;
+    length = endc(*(const uint64_t *)(start));
+    start += 8;
+    offset_size = 8;
+  }
+  if ( length > (uint64_t)(end - start) || length < offset_size ) return nullptr;
+  auto block_end = start + length;
+  // read cie_id
+  if ( offset_size == 4 )
+    cie_id = endc( *(const uint32_t *)start );
+  else
+    cie_id = endc( *(const uint64_t *)start );
+  start += offset_size;
+  if ( is_eh ? !cie_id :
+   (offset_size == 4 && cie_id == DW_CIE_ID) || (offset_size == 8 && cie_id == DW64_CIE_ID)
+  )
+  {
+    cie.init = read_cie(start, block_end, cie);
+    cie.init_end = block_end;
+    eh_addr_size = save_eh_addr_size;
+    if ( g_opt_d ) {
+      printf("CIE:\n version %d\n", cie.version);
+      printf(" Augmentation: %s\n", cie.augmentation);
+      if ( cie.version > 4 ) {
+        printf(" pointer_size: %u\n", cie.ptr_size);
+        printf(" segment size: %u\n", cie.segment_size);
+      }
+    }
+    return block_end;
+  }
+  uint64_t cie_off = cie_id;
+  if ( is_eh ) {
+    uint64_t sign = (uint64_t) 1 << (offset_size * 8 - 1);
+    cie_off = (cie_off ^ sign) - sign;
+    cie_off = start - 4 - debug_frame_.s_ - cie_off;
+  }
+  if ( cie_off >= debug_frame_.size_ ) return block_end;
+  unsigned int off_size = 4;
+  const unsigned char *cie_scan = debug_frame_.s_ + cie_off;
+  if ( end - cie_scan < 4 ) return nullptr;
+  length = endc( *(const uint32_t *)cie_scan );
+  cie_scan += 4;
+  if ( length == 0xffffffff )
+  {
+    if ( end - cie_scan < 8 ) return nullptr;
+    length = endc(*(const uint64_t *)(cie_scan));
+    cie_scan += 8;
+    off_size = 8;
+  }
+  if ( length < off_size || length > (uint64_t)(end - cie_scan) ) return nullptr;
+  const unsigned char *cie_end = cie_scan + length;
+  // read c_id
+  uint64_t c_id;
+  if ( off_size == 4 )
+    c_id = endc( *(const uint32_t *)cie_scan );
+  else
+    c_id = endc( *(const uint64_t *)cie_scan );
+  cie_scan += off_size;
+  if ( is_eh ? c_id == 0
+       : ((off_size == 4 && c_id == DW_CIE_ID) || (off_size == 8 && c_id == DW64_CIE_ID))
+     )
+  {
+    cie.init = read_cie(cie_scan, cie_end, cie);
+    cie.init_end = cie_end;
+  } else
+    return block_end;
+  eh_addr_size = cie.ptr_size;
+  fde.encoded_ptr_size = save_eh_addr_size;
+  if ( cie.fde_encoding )
+   fde.encoded_ptr_size = size_of_encoded_value( cie.fde_encoding );
+  // skip segment
+  if ( cie.segment_size )
+    start += cie.segment_size;
+  // pc_begin
+  fde.pc_begin = get_encoded_value(&start, cie.fde_encoding, block_end);
+  if ( block_end - start < (ptrdiff_t)fde.encoded_ptr_size ) return block_end;
+  fde.pc_range = byte_get(start, fde.encoded_ptr_size);
+  start += fde.encoded_ptr_size;
+  if (cie.augmentation[0] == 'z')
+  {
+    size_t ba = block_end - start;
+    auto skip = ULEB128(start, ba);
+    start += skip;
+  }
+  eh_addr_size = save_eh_addr_size;
+  if ( g_opt_d ) {
+    printf("Off %lx ptr_size %d cie_id %lX pc=%lX len %lX\n", saved_start - debug_frame_.s_,
+     cie.ptr_size, cie_id, fde.pc_begin, fde.pc_range);
+  }
+  if ( start > block_end ) return block_end;
+  fde.instr = start;
+  fde.end = block_end;
+  is_fde = true;
+  return block_end;
+}
+
+// store FDE in m_dfa, returns iterator to it
+std::map<uint64_t, ElfFile::fde_item>::iterator ElfFile::add_fde(one_fde &fde, const unsigned char *start)
+{
+  fde_item item{ fde.pc_begin + fde.pc_range, 0, false };
+  item.fde = start;
+  item.has_dfa = parse_dfa(fde.instr, fde.end, fde.encoded_ptr_size, item.dfa);
+  if ( item.has_dfa && g_opt_d )
+    printf(" pc %lX frame %lx\n", fde.pc_begin, item.dfa);
+  return m_dfa.insert_or_assign(fde.pc_begin, item).first;
+}
+
 // ripped from dwarf.c function display_debug_frames
 bool ElfFile::parse_frames()
 {
   if ( debug_frame_.empty() ) return false;
   const unsigned char *start = debug_frame_.s_, 
    *end = start + debug_frame_.size_;
-  one_cie cie;
-  unsigned int save_eh_addr_size = eh_addr_size;
   while( start < end )
   {
-    const unsigned char *saved_start = start;
-    uint64_t length, cie_id;
-    unsigned int offset_size = 4,  
-      encoded_ptr_size = save_eh_addr_size;
-    length = endc( *(const uint32_t *)start );
-    start += 4;
-    if ( !length ) {
+    if ( end - start >= 4 && !endc( *(const uint32_t *)start ) ) {
+      start += 4;
       while( start < end && !*start ) start++;
       continue;
     }
-    if ( length == 0xffffffff )
+    one_fde fde;
+    bool is_fde;
+    auto next = read_fde(start, fde, is_fde);
+    if ( !next ) return false;
+    if ( is_fde )
+      add_fde(fde, start);
+    start = next;
+  }
+  return true;
+}
+
+// read encoded value from .eh_frame_hdr
+uint64_t ElfFile::read_hdr_value(const unsigned char *&p, int encoding)
+{
+  const unsigned char *end = eh_frame_hdr_.s_ + eh_frame_hdr_.size_;
+  uint64_t base = 0;
+  if ( (encoding & 0x70) == DW_EH_PE_pcrel )
+    base = eh_frame_hdr_.vma_ + (p - eh_frame_hdr_.s_);
+  else if ( (encoding & 0x70) == DW_EH_PE_datarel )
+    base = eh_frame_hdr_.vma_;
+  unsigned int size = size_of_encoded_value(encoding);
+  if ( p >= end || size > (size_t)(end - p) )
+  {
+    p = end;
+    return 0;
+  }
+  uint64_t val = (encoding & DW_EH_PE_signed) ? byte_get_signed(p, size) : byte_get(p, size);
+  p += size;
+  return base + val;
+}
+
+// find .eh_frame by eh_frame_ptr from header in PT_LOAD segments
+// size of .eh_frame is unknown so it lasts to end of segment
+bool ElfFile::locate_eh_frame()
+{
+  if ( eh_frame_hdr_.size_ < 4 || eh_frame_hdr_.s_[0] != 1 || eh_frame_hdr_.s_[1] == DW_EH_PE_omit ) return false;
+  const unsigned char *p = eh_frame_hdr_.s_ + 4;
+  auto eh_frame_ptr = read_hdr_value(p, eh_frame_hdr_.s_[1]);
+  Elf_Half sn = reader->segments.size();
+  for ( Elf_Half i = 0; i < sn; i++ )
+  {
+    segment *seg = reader->segments[i];
+    if ( seg->get_type() != PT_LOAD || !seg->get_data() ) continue;
+    auto va = seg->get_virtual_address();
+    if ( eh_frame_ptr < va || eh_frame_ptr - va >= seg->get_file_size() ) continue;
+    is_eh = true;
+    debug_frame_.s_ = reinterpret_cast<const unsigned char*>(seg->get_data()) + (eh_frame_ptr - va);
+    debug_frame_.size_ = seg->get_file_size() - (eh_frame_ptr - va);
+    debug_frame_.vma_ = eh_frame_ptr;
+    if ( g_opt_v )
+      printf(".eh_frame at %lX from PT_GNU_EH_FRAME\n", eh_frame_ptr);
+    return true;
+  }
+  return false;
+}
+
+// check .eh_frame_hdr binary search table, see https://refspecs.linuxfoundation.org/LSB_1.3.0/gLSB/gLSB/ehframehdr.html
+bool ElfFile::setup_eh_frame_hdr()
+{
+  if ( !is_eh || eh_frame_hdr_.size_ < 4 || debug_frame_.empty() ) return false;
+  const unsigned char *p = eh_frame_hdr_.s_;
+  auto version = p[0];
+  int eh_frame_ptr_enc = p[1],
+   fde_count_enc = p[2],
+   table_enc = p[3];
+  if ( version != 1 || eh_frame_ptr_enc == DW_EH_PE_omit || fde_count_enc == DW_EH_PE_omit ) return false;
+  // binary search table must contain fixed size datarel entries
+  if ( table_enc != (DW_EH_PE_datarel | DW_EH_PE_sdata4) ) return false;
+  p += 4;
+  auto eh_frame_ptr = read_hdr_value(p, eh_frame_ptr_enc);
+  // debug_frame_ can be .debug_frame
+  if ( eh_frame_ptr != debug_frame_.vma_ ) return false;
+  auto count = read_hdr_value(p, fde_count_enc);
+  if ( !count || count * 8 > (uint64_t)(eh_frame_hdr_.s_ + eh_frame_hdr_.size_ - p) ) return false;
+  m_eh_table = p;
+  m_eh_count = count;
+  if ( g_opt_v )
+    printf("eh_frame_hdr has %ld FDEs\n", count);
+  return true;
+}
+
+// binary search in .eh_frame_hdr table and decode found FDE
+bool ElfFile::find_fde_lazy(uint64_t pc)
+{
+  size_t lo = 0, hi = m_eh_count;
+  while( lo < hi )
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    uint64_t loc = eh_frame_hdr_.vma_ + byte_get_signed(m_eh_table + mid * 8, 4);
+    if ( loc <= pc )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if ( !lo ) return false;
+  // each entry is decoded once, even when it does not cover pc or is broken
+  if ( !m_eh_tried.insert(lo - 1).second ) return false;
+  uint64_t fde_addr = eh_frame_hdr_.vma_ + byte_get_signed(m_eh_table + (lo - 1) * 8 + 4, 4);
+  if ( fde_addr < debug_frame_.vma_ || fde_addr - debug_frame_.vma_ >= debug_frame_.size_ ) return false;
+  one_fde fde;
+  bool is_fde;
+  auto fde_start = debug_frame_.s_ + (fde_addr - debug_frame_.vma_);
+  if ( !read_fde(fde_start, fde, is_fde) || !is_fde ) return false;
+  add_fde(fde, fde_start);
+  return true;
+}
+
+static void set_reg_rule(std::vector<CFARule> &regs, const CFARule &r)
+{
+  auto ri = std::lower_bound(regs.begin(), regs.end(), r.reg,
+    [](const CFARule &a, uint16_t reg) { return a.reg < reg; });
+  if ( ri != regs.end() && ri->reg == r.reg )
+    *ri = r;
+  else
+    regs.insert(ri, r);
+}
+
+static void restore_reg_rule(std::vector<CFARule> &regs, uint16_t reg, const std::vector<CFARule> *initial)
+{
+  if ( initial )
+  {
+    auto ii = std::lower_bound(initial->begin(), initial->end(), reg,
+      [](const CFARule &a, uint16_t reg) { return a.reg < reg; });
+    if ( ii != initial->end() && ii->reg == reg )
     {
-      if ( end - start < 8 ) return false;
-      length = endc(*(const uint64_t *)(start));
-      start += 8;
-      offset_size = 8;
+      set_reg_rule(regs, *ii);
+      return;
     }
-    if ( length > (uint64_t)(end - start) ) return false;
-    auto block_end = start + length;
-    // read cie_id
-    if ( offset_size == 4 )
-      cie_id = endc( *(const uint32_t *)start );
-    else
-      cie_id = endc( *(const uint64_t *)start );
-    start += offset_size;
-    if ( is_eh ? !cie_id :
-     (offset_size == 4 && cie_id == DW_CIE_ID) || (offset_size == 8 && cie_id == DW64_CIE_ID)
-    )
+  }
+  auto ri = std::lower_bound(regs.begin(), regs.end(), reg,
+    [](const CFARule &a, uint16_t reg) { return a.reg < reg; });
+  if ( ri != regs.end() && ri->reg == reg )
+    regs.erase(ri);
+}
+
+void ElfFile::push_cfa_row(uint64_t start, uint64_t end, cfa_state &st, std::vector<std::pair<uint64_t, cfa_row> > &rows)
+{
+  if ( start >= end ) return;
+  if ( !rows.empty() )
+  {
+    auto &prev = rows.back().second;
+    bool same_regs = prev.regs_count == st.regs.size() &&
+      std::equal(st.regs.begin(), st.regs.end(), m_cfa_regs.begin() + prev.regs_idx);
+    // extend previous row if rules are the same
+    if ( same_regs && prev.end == start && prev.cfa == st.cfa )
     {
-      start = read_cie(start, end, cie);
-      if ( start == end ) break;
-      if ( g_opt_d ) {
-        printf("CIE:\n version %d\n", cie.version);
-        printf(" Augmentation: %s\n", cie.augmentation);
-        if ( cie.version > 4 ) {
-          printf(" pointer_size: %u\n", cie.ptr_size);
-          printf(" segment size: %u\n", cie.segment_size);
-        }
-      }
-    } else {
-      uint64_t cie_off = cie_id;
-      if ( is_eh ) {
-        uint64_t sign = (uint64_t) 1 << (offset_size * 8 - 1);
-        cie_off = (cie_off ^ sign) - sign;
-        cie_off = start - 4 - debug_frame_.s_ - cie_off;
-      }
-      // skip for now looking in chunks
-      unsigned int off_size = 4;
-      const unsigned char *cie_scan = debug_frame_.s_ + cie_off;
-      length = endc( *(const uint32_t *)cie_scan );
-      cie_scan += 4;
-      if ( length == 0xffffffff )
-      {
-        if ( end - cie_scan < 8 ) return false;
-        length = endc(*(const uint64_t *)(cie_scan));
-        cie_scan += 8;
-        off_size = 8;
-      }
-      if ( !length ) return false;
-      const unsigned char *cie_end = cie_scan + length;
-      // read c_id
-      uint64_t c_id;
-      if ( off_size == 4 )
-        c_id = endc( *(const uint32_t *)cie_scan );
-      else
-        c_id = endc( *(const uint64_t *)cie_scan );
-      cie_scan += off_size;
-      if ( is_eh ? c_id == 0
-           : ((off_size == 4 && c_id == DW_CIE_ID) || (off_size == 8 && c_id == DW64_CIE_ID))
-         )
-        read_cie(cie_scan, cie_end, cie);
-    }
-    eh_addr_size = cie.ptr_size;
-    if ( cie.fde_encoding )
-     encoded_ptr_size = size_of_encoded_value( cie.fde_encoding );
-    // skip segment
-    if ( cie.segment_size )
-      start += cie.segment_size;
-    // pc_begin
-    auto pc_begin = get_encoded_value(&start, cie.fde_encoding, block_end);
-    auto pc_range = byte_get(start, encoded_ptr_size);
-    start += encoded_ptr_size;
-    if (cie.augmentation[0] == 'z')
+      prev.end = end;
+      return;
+    }
+    // share rules for registers with previous row
+    if ( same_regs )
     {
-      size_t ba = block_end - start;
-      auto skip = ULEB128(start, ba);
-      start += skip;
+      rows.push_back( { start, { end, st.cfa, prev.regs_idx, prev.regs_count } } );
+      return;
     }
-    if ( g_opt_d ) {
-      printf("Off %lx ptr_size %d cie_id %lX pc=%lX len %lX\n", saved_start - debug_frame_.s_,
-       cie.ptr_size, cie_id, pc_begin, pc_range);
+  }
+  rows.push_back( { start, { end, st.cfa, (uint32_t)m_cfa_regs.size(), (uint32_t)st.regs.size() } } );
+  m_cfa_regs.insert(m_cfa_regs.end(), st.regs.begin(), st.regs.end());
+}
+
+// evaluate CFA program, when rows is null - this is initial instructions of CIE
+bool ElfFile::exec_cfa(const unsigned char *start, const unsigned char *block_end, one_fde &fde, cfa_state &st,
+  const cfa_state *initial, uint64_t &loc, std::vector<std::pair<uint64_t, cfa_row> > *rows)
+{
+  std::vector<cfa_state> saved;
+  size_t ba = block_end - start;
+  uint64_t new_loc, uval;
+  CFARule r;
+  auto &cie = fde.cie;
+  while( start < block_end )
+  {
+    auto op = *start;
+    start++;
+    ba--;
+    new_loc = loc;
+    r = CFARule();
+    switch( op & 0xc0 ? op & 0xc0 : op )
+    {
+      case Dwarf32::dwarf_cfa::DW_CFA_nop:
+      case Dwarf32::dwarf_cfa::DW_CFA_GNU_window_save:
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_advance_loc:
+        new_loc = loc + (op & 0x3f) * cie.code_factor;
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_set_loc: {
+        auto next = start;
+        new_loc = get_encoded_value(&next, cie.fde_encoding, block_end);
+        ba -= next - start;
+        start = next;
+       } break;
+      case Dwarf32::dwarf_cfa::DW_CFA_advance_loc1:
+        if ( ba < 1 ) return false;
+        new_loc = loc + byte_get(start, 1) * cie.code_factor;
+        ba -= 1;
+        start++;
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_advance_loc2:
+        if ( ba < 2 ) return false;
+        new_loc = loc + byte_get(start, 2) * cie.code_factor;
+        ba -= 2;
+        start += 2;
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_advance_loc4:
+        if ( ba < 4 ) return false;
+        new_loc = loc + byte_get(start, 4) * cie.code_factor;
+        ba -= 4;
+        start += 4;
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_MIPS_advance_loc8:
+        if ( ba < 8 ) return false;
+        new_loc = loc + byte_get(start, 8) * cie.code_factor;
+        start += 8; ba -= 8;
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_def_cfa:
+        st.cfa.type = cfa_reg_off;
+        st.cfa.reg = ULEB128(start, ba);
+        st.cfa.off = ULEB128(start, ba);
+        st.cfa.len = 0;
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_def_cfa_sf:
+        st.cfa.type = cfa_reg_off;
+        st.cfa.reg = ULEB128(start, ba);
+        st.cfa.off = SLEB128(start, ba) * cie.data_factor;
+        st.cfa.len = 0;
+       break;
+      // next 3 are valid only when CFA is already register + offset
+      case Dwarf32::dwarf_cfa::DW_CFA_def_cfa_register:
+        if ( st.cfa.type != cfa_reg_off ) return false;
+        st.cfa.reg = ULEB128(start, ba);
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_def_cfa_offset:
+        if ( st.cfa.type != cfa_reg_off ) return false;
+        st.cfa.off = ULEB128(start, ba);
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_def_cfa_offset_sf:
+        if ( st.cfa.type != cfa_reg_off ) return false;
+        st.cfa.off = SLEB128(start, ba) * cie.data_factor;
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_def_cfa_expression:
+        uval = ULEB128(start, ba);
+        if ( ba < uval ) return false;
+        st.cfa.type = cfa_expr;
+        st.cfa.reg = 0;
+        st.cfa.expr = start;
+        st.cfa.len = uval;
+        ba -= uval;
+        start += uval;
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_offset:
+        r.reg = op & 0x3f;
+        r.type = cfa_offset;
+        r.off = ULEB128(start, ba) * cie.data_factor;
+        set_reg_rule(st.regs, r);
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_offset_extended:
+      case Dwarf32::dwarf_cfa::DW_CFA_val_offset:
+        r.reg = ULEB128(start, ba);
+        r.type = op == Dwarf32::dwarf_cfa::DW_CFA_val_offset ? cfa_val_offset : cfa_offset;
+        r.off = ULEB128(start, ba) * cie.data_factor;
+        set_reg_rule(st.regs, r);
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_offset_extended_sf:
+      case Dwarf32::dwarf_cfa::DW_CFA_val_offset_sf:
+        r.reg = ULEB128(start, ba);
+        r.type = op == Dwarf32::dwarf_cfa::DW_CFA_val_offset_sf ? cfa_val_offset : cfa_offset;
+        r.off = SLEB128(start, ba) * cie.data_factor;
+        set_reg_rule(st.regs, r);
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_GNU_negative_offset_extended:
+        r.reg = ULEB128(start, ba);
+        r.type = cfa_offset;
+        r.off = -(int64_t)ULEB128(start, ba) * cie.data_factor;
+        set_reg_rule(st.regs, r);
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_restore:
+        restore_reg_rule(st.regs, op & 0x3f, initial ? &initial->regs : nullptr);
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_restore_extended:
+        restore_reg_rule(st.regs, ULEB128(start, ba), initial ? &initial->regs : nullptr);
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_undefined:
+      case Dwarf32::dwarf_cfa::DW_CFA_same_value:
+        r.reg = ULEB128(start, ba);
+        r.type = op == Dwarf32::dwarf_cfa::DW_CFA_undefined ? cfa_undefined : cfa_same_value;
+        set_reg_rule(st.regs, r);
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_register:
+        r.reg = ULEB128(start, ba);
+        r.type = cfa_register;
+        r.off = ULEB128(start, ba);
+        set_reg_rule(st.regs, r);
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_expression:
+      case Dwarf32::dwarf_cfa::DW_CFA_val_expression:
+        r.reg = ULEB128(start, ba);
+        r.type = op == Dwarf32::dwarf_cfa::DW_CFA_expression ? cfa_expression : cfa_val_expression;
+        uval = ULEB128(start, ba);
+        if ( ba < uval ) return false;
+        r.expr = start;
+        r.len = uval;
+        ba -= uval;
+        start += uval;
+        set_reg_rule(st.regs, r);
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_remember_state:
+        saved.push_back(st);
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_restore_state:
+        if ( saved.empty() ) return false;
+        // CFA rule is saved too like in gcc & llvm unwinders
+        st = saved.back();
+        saved.pop_back();
+       break;
+      case Dwarf32::dwarf_cfa::DW_CFA_GNU_args_size:
+        ULEB128(start, ba);
+       break;
+      default:
+        // unknown opcode, we can't know its length
+        return false;
     }
-    uint64_t res = 0;
-    if ( parse_dfa(start, block_end, encoded_ptr_size, res) )
+    if ( new_loc != loc )
     {
-      m_dfa[pc_begin] = res;
-      if ( g_opt_d )
-        printf(" pc %lX frame %lx\n", pc_begin, res);
+      if ( rows )
+        push_cfa_row(loc, new_loc, st, *rows);
+      loc = new_loc;
     }
-    start = block_end;
-    eh_addr_size = save_eh_addr_size;
   }
   return true;
 }
 
+bool ElfFile::compile_fde(one_fde &fde)
+{
+  if ( !fde.cie.init ) return false;
+  cfa_state initial, st;
+  uint64_t loc = fde.pc_begin;
+  if ( !exec_cfa(fde.cie.init, fde.cie.init_end, fde, initial, nullptr, loc, nullptr) ) return false;
+  st = initial;
+  loc = fde.pc_begin;
+  std::vector<std::pair<uint64_t, cfa_row> > rows;
+  bool res = exec_cfa(fde.instr, fde.end, fde, st, &initial, loc, &rows);
+  if ( res )
+    push_cfa_row(loc, fde.pc_begin + fde.pc_range, st, rows);
+  // DW_CFA_set_loc can move location back
+  if ( !std::is_sorted(rows.begin(), rows.end(), [](const auto &a, const auto &b) { return a.first < b.first; }) )
+    std::stable_sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+  for ( auto &r: rows )
+  {
+    m_cfa_pcs.push_back(r.first);
+    m_cfa_rows.push_back(r.second);
+  }
+  return res;
+}
+
+// rows are compiled on demand for FDE covering pc
+bool ElfFile::find_cfa(uint64_t pc, CFARow &res)
+{
+  std::lock_guard<std::mutex> lock(m_lists_lock);
+  auto fi = find_fde(pc);
+  if ( fi == m_dfa.end() ) return false;
+  auto &item = fi->second;
+  if ( !item.compiled )
+  {
+    item.compiled = true;
+    item.rows_idx = m_cfa_pcs.size();
+    one_fde fde;
+    bool is_fde;
+    if ( item.fde && read_fde(item.fde, fde, is_fde) && is_fde && !compile_fde(fde) )
+      tree_builder->e_->warning("FDE at %lX has bad CFA program\n", fi->first);
+    item.rows_count = m_cfa_pcs.size() - item.rows_idx;
+  }
+  auto pb = m_cfa_pcs.begin() + item.rows_idx,
+   pe = pb + item.rows_count;
+  auto pi = std::upper_bound(pb, pe, pc);
+  if ( pi == pb ) return false;
+  size_t i = pi - m_cfa_pcs.begin() - 1;
+  auto &row = m_cfa_rows[i];
+  if ( pc >= row.end ) return false;
+  res.start = m_cfa_pcs[i];
+  res.end = row.end;
+  res.cfa = row.cfa;
+  res.regs = m_cfa_regs.data() + row.regs_idx;
+  res.count = row.regs_count;
+  return true;
+}
+
 // parse DFA to find first DW_CFA_def_cfa_offset
 bool ElfFile::parse_dfa(const unsigned char *start, const unsigned char *block_end, unsigned char ptr_size, uint64_t &res)
 {
@@ -731,9 +1245,43 @@ bool ElfFile::parse_dfa(const unsigned char *start, const unsigned char *block_e
 bool ElfFile::get_rnglistx(int64_t off, uint64_t base_addr, unsigned char addr_size,
  std::list<std::pair<uint64_t, uint64_t> > &res)
 {
-  if ( !debug_rnglists_.empty() ) return get_rnglistx_(off, res);
-  if ( !debug_ranges_.empty() ) return get_old_range(off, base_addr, addr_size, res);
-  return false;
+  if ( debug_rnglists_.empty() && debug_ranges_.empty() ) return false;
+  // rnglists can contain DW_RLE_base_addressx so addr_base is part of key, for old .debug_ranges - addr_size
+  list_key key{ (uint64_t)off, base_addr, debug_rnglists_.empty() ? addr_size : (uint64_t)addr_base };
+  std::lock_guard<std::mutex> lock(m_lists_lock);
+  auto ci = m_rng_cache.find(key);
+  if ( ci != m_rng_cache.end() )
+  {
+    m_list_stat.rng_hits++;
+    res = ci->second.second;
+    return ci->second.first;
+  }
+  m_list_stat.rng_misses++;
+  bool ok;
+  if ( !debug_rnglists_.empty() ) ok = get_rnglistx_(off, res);
+  else ok = get_old_range(off, base_addr, addr_size, res);
+  // store failed lookups too to avoid repeated decoding & warnings
+  auto &cached = m_rng_cache[key];
+  cached.first = ok;
+  cached.second = res;
+  add_list_mem(cached.second);
+  return ok;
+}
+
+void ElfFile::clear_list_caches()
+{
+  std::lock_guard<std::mutex> lock(m_lists_lock);
+  m_loc_cache.clear();
+  m_rng_cache.clear();
+  g_mem[mk_loclists].sub(m_list_items_mem, 0);
+  m_list_items_mem = 0;
+}
+
+void ElfFile::process_unit(int last)
+{
+  tree_builder->ProcessUnit(last);
+  if ( !g_opt_g )
+    clear_list_caches();
 }
 
 // ripped from dwarf.c function display_debug_ranges_list
@@ -775,14 +1323,12 @@ bool ElfFile::get_rnglistx_(int64_t off, std::list<std::pair<uint64_t, uint64_t>
 {
   if ( debug_rnglists_.empty() ) return false;
   if ( off < 0 || (size_t)off >= debug_rnglists_.size_ ) return false;
-  // find rnglist_ctx for this off
-  rnglist_ctx *ctx = nullptr;
-  for ( auto &r: m_rnglists )
-    if ( off >= r.start && off < r.end ) {
-      ctx = &r;
-      break;
-    }
-  if ( !ctx ) return false;
+  // find rnglist_ctx for this off - m_rnglists is sorted by start
+  auto ri = std::upper_bound(m_rnglists.begin(), m_rnglists.end(), off,
+    [](int64_t v, const rnglist_ctx &r) { return v < r.start; });
+  if ( ri == m_rnglists.begin() ) return false;
+  rnglist_ctx *ctx = &*(--ri);
+  if ( off >= ctx->end ) return false;
   unsigned int debug_addr_section_hdr_len = ctx->offset_size == 4 ? 8 : 16;
   const unsigned char *next = debug_rnglists_.s_ + off;
   auto finish = debug_rnglists_.s_ + ctx->end;
@@ -1241,8 +1787,8 @@ bool ElfFile::SaveSections(std::string &fn)
     tree_builder->e_->warning("SaveSections: failed to open '%s'\n", fn.c_str());
     return false;
   }
-  Elf_Half n = orig.sections.size();
-  for ( Elf_Half i = 0; i < n; i++) 
+  Elf_Word n = orig.sections.size();
+  for ( Elf_Word i = 0; i < n; i++) 
   {
     section *s = orig.sections[i];
     m_orig_sects.push_back({ s->get_name(), s->get_address(), s->get_size()});
@@ -1263,8 +1809,8 @@ int ElfFile::find_sname(uint64_t addr, std::string &sname)
     }
     return 0;
   }
-  Elf_Half n = reader->sections.size();
-  for ( Elf_Half i = 0; i < n; i++) 
+  Elf_Word n = reader->sections.size();
+  for ( Elf_Word i = 0; i < n; i++) 
   {
     section *s = reader->sections[i];
     auto s_addr = s->get_address();
@@ -1572,6 +2118,27 @@ bool ElfFile::get_loc(uint64_t off, std::list<LocListXItem> &out_list, uint64_t
   return !out_list.empty();
 }
 
+const std::list<LocListXItem> *ElfFile::get_cached_loclistx(uint64_t off, uint64_t func_base)
+{
+  list_key key{ off, func_base, debug_loc_.s_ ? 0 : (uint64_t)addr_base };
+  std::lock_guard<std::mutex> lock(m_lists_lock);
+  auto ci = m_loc_cache.find(key);
+  if ( ci != m_loc_cache.end() )
+  {
+    m_list_stat.loc_hits++;
+    return ci->second.empty() ? nullptr : &ci->second;
+  }
+  m_list_stat.loc_misses++;
+  auto &res = m_loc_cache[key];
+  if ( !get_loclistx(off, res, func_base) )
+  {
+    res.clear();
+    return nullptr;
+  }
+  add_list_mem(res);
+  return &res;
+}
+
 // ripped from functions display_offset_entry_loclists & display_loclists_list in dwarf.c
 bool ElfFile::get_loclistx(uint64_t off, std::list<LocListXItem> &out_list, uint64_t func_base)
 {
@@ -3136,162 +3703,507 @@ bool ElfFile::LogDwarfInfo(Dwarf32::Attribute attribute,
   return false;
 }
 
-bool ElfFile::GetAllClasses() 
+// info & info_bytes are copies so attribute still will be processed in LogDwarfInfo
+void ElfFile::collect_scope_attr(Dwarf32::Attribute attribute, Dwarf32::Form form, const unsigned char *info,
+  size_t info_bytes, const void* unit_base)
 {
-  const unsigned char* info = reinterpret_cast<const unsigned char*>(debug_info_.s_);
-  size_t info_bytes = debug_info_.size_;
-  m_curr_lines = debug_line_.s_;
+  switch(attribute)
+  {
+    case Dwarf32::Attribute::DW_AT_low_pc:
+      m_ps.low = FormDataValue(form, info, info_bytes);
+      m_ps.has_low = true;
+     break;
+    case Dwarf32::Attribute::DW_AT_high_pc:
+      // in dwarf4+ high_pc with constant class is offset from low_pc
+      m_ps.high_is_off = form != Dwarf32::Form::DW_FORM_addr &&
+        form != Dwarf32::Form::DW_FORM_addrx && form != Dwarf32::Form::DW_FORM_addrx1 &&
+        form != Dwarf32::Form::DW_FORM_addrx2 && form != Dwarf32::Form::DW_FORM_addrx3 &&
+        form != Dwarf32::Form::DW_FORM_addrx4;
+      m_ps.high = FormDataValue(form, info, info_bytes);
+      m_ps.has_high = true;
+     break;
+    case Dwarf32::Attribute::DW_AT_ranges:
+      if ( !debug_ranges_.empty() || !debug_rnglists_.empty() )
+        read_range(form, info, info_bytes, m_ps.rng);
+     break;
+    case Dwarf32::Attribute::DW_AT_abstract_origin:
+    case Dwarf32::Attribute::DW_AT_specification:
+      m_ps.origin = FormDataValue(form, info, info_bytes);
+      if (form != Dwarf32::Form::DW_FORM_ref_addr)
+        m_ps.origin += reinterpret_cast<const unsigned char*>(unit_base) - debug_info_.s_;
+     break;
+    case Dwarf32::Attribute::DW_AT_name:
+      m_ps.name = FormStringValue(form, info, info_bytes);
+     break;
+    case Dwarf32::Attribute::DW_AT_MIPS_linkage_name:
+    case Dwarf32::Attribute::DW_AT_linkage_name:
+      m_ps.link_name = FormStringValue(form, info, info_bytes);
+     break;
+    default: ;
+  }
+}
 
-  while (info_bytes > 0) {
-    // process previous compilation unit
-    tree_builder->ProcessUnit();
-    // Load the compilation unit information
-    const unsigned char* cu_start = info;
-    cu_base = cu_start - debug_info_.s_;
-    const Dwarf32::CompilationUnitHdr* unit_hdr =
-        reinterpret_cast<const Dwarf32::CompilationUnitHdr*>(info);
-    const unsigned char* info_end;
-    uint32_t abbrev_offset = endc(unit_hdr->debug_abbrev_offset);
-    dversion = endc(unit_hdr->version);
-    if ( dversion < 5 )
+void ElfFile::add_addr_scope()
+{
+  while ( !m_scope_stack.empty() && m_scope_stack.back().first > m_level )
+    m_scope_stack.pop_back();
+  auto tag = m_section->type;
+  if ( tag == Dwarf32::Tag::DW_TAG_subprogram && (m_ps.name || m_ps.link_name || m_ps.origin) )
+    m_aindex->add_decl(m_tag_id, m_ps.name, m_ps.link_name, m_ps.origin);
+  std::list<std::pair<uint64_t, uint64_t> > ranges;
+  if ( m_ps.rng != (uint64_t)-1 )
+  {
+    if ( !debug_rnglists_.empty() )
+      get_rnglistx_(m_ps.rng, ranges);
+    else
+      get_old_range(m_ps.rng, tree_builder->cu.cu_base_addr, address_size_, ranges);
+  } else if ( m_ps.has_low && m_ps.has_high )
+    ranges.push_back( { m_ps.low, m_ps.high_is_off ? m_ps.low + m_ps.high : m_ps.high } );
+  if ( ranges.empty() )
+    return;
+  int idx = m_aindex->add_scope(m_tag_id, tag, m_scope_stack.empty() ? -1 : m_scope_stack.back().second);
+  auto &sc = m_aindex->scope(idx);
+  sc.origin = m_ps.origin;
+  sc.name = m_ps.name;
+  sc.link_name = m_ps.link_name;
+  for ( auto &r: ranges )
+    m_aindex->add_range(idx, r.first, r.second);
+  if ( m_section->has_children )
+    m_scope_stack.push_back( { m_level + 1, idx } );
+}
+
+// read header of compilation unit at info, returns pointer to first tag
+const unsigned char *ElfFile::read_unit_hdr(const unsigned char* info, const unsigned char* &info_end, uint32_t &abbrev_offset)
+{
+  const Dwarf32::CompilationUnitHdr* unit_hdr =
+      reinterpret_cast<const Dwarf32::CompilationUnitHdr*>(info);
+  abbrev_offset = endc(unit_hdr->debug_abbrev_offset);
+  dversion = endc(unit_hdr->version);
+  if ( dversion < 5 )
+  {
+    address_size_ = endc(unit_hdr->address_size);
+    DBG_PRINTF("unit_length         = 0x%x\n", unit_hdr->unit_length);
+    DBG_PRINTF("version             = %d\n", dversion);
+    DBG_PRINTF("debug_abbrev_offset = 0x%x\n", unit_hdr->debug_abbrev_offset);
+    DBG_PRINTF("address_size        = %d\n", unit_hdr->address_size);
+    info_end = info + endc(unit_hdr->unit_length) + sizeof(uint32_t);
+    info += sizeof(Dwarf32::CompilationUnitHdr);
+  } else {
+    const Dwarf32::CompilationUnitHdr5* unit_hdr5 =
+      reinterpret_cast<const Dwarf32::CompilationUnitHdr5*>(info);
+    dversion = endc(unit_hdr5->version);
+    address_size_ = endc(unit_hdr5->address_size);
+    DBG_PRINTF("unit_length         = 0x%x\n", unit_hdr5->unit_length);
+    DBG_PRINTF("version             = %d\n", dversion);
+    DBG_PRINTF("unit_type           = %d\n", unit_hdr5->unit_type);
+    DBG_PRINTF("address_size        = %d\n", unit_hdr5->address_size);
+    abbrev_offset = endc(unit_hdr5->debug_abbrev_offset);
+    DBG_PRINTF("debug_abbrev_offset = 0x%x\n", abbrev_offset);
+    info_end = info + endc(unit_hdr5->unit_length) + sizeof(uint32_t);
+    info += sizeof(Dwarf32::CompilationUnitHdr5);
+    if ( unit_hdr5->unit_type == Dwarf32::unit_type::DW_UT_type )
     {
-      address_size_ = endc(unit_hdr->address_size);
-      DBG_PRINTF("unit_length         = 0x%x\n", unit_hdr->unit_length);
-      DBG_PRINTF("version             = %d\n", dversion);
-      DBG_PRINTF("debug_abbrev_offset = 0x%x\n", unit_hdr->debug_abbrev_offset);
-      DBG_PRINTF("address_size        = %d\n", unit_hdr->address_size);
-      info_end = info + endc(unit_hdr->unit_length) + sizeof(uint32_t);
-      info += sizeof(Dwarf32::CompilationUnitHdr);
-      info_bytes -= sizeof(Dwarf32::CompilationUnitHdr);
-    } else {
-      const Dwarf32::CompilationUnitHdr5* unit_hdr5 =
-        reinterpret_cast<const Dwarf32::CompilationUnitHdr5*>(info);
-      dversion = endc(unit_hdr5->version);
-      address_size_ = endc(unit_hdr5->address_size);
-      DBG_PRINTF("unit_length         = 0x%x\n", unit_hdr5->unit_length);
-      DBG_PRINTF("version             = %d\n", dversion);
-      DBG_PRINTF("unit_type           = %d\n", unit_hdr5->unit_type);
-      DBG_PRINTF("address_size        = %d\n", unit_hdr5->address_size);
-      abbrev_offset = endc(unit_hdr5->debug_abbrev_offset);
-      DBG_PRINTF("debug_abbrev_offset = 0x%x\n", abbrev_offset);
-      info_end = info + endc(unit_hdr5->unit_length) + sizeof(uint32_t);
-      info += sizeof(Dwarf32::CompilationUnitHdr5);
-      info_bytes -= sizeof(Dwarf32::CompilationUnitHdr5);
-      if ( unit_hdr5->unit_type == Dwarf32::unit_type::DW_UT_type )
-      {
-        DBG_PRINTF("signature        = %lX\n", *(const uint64_t *)info);
-        info += 8 + address_size_;
-        info_bytes -= 8 + address_size_;
-      }
-      if ( unit_hdr5->unit_type == Dwarf32::unit_type::DW_UT_split_compile ||
-           unit_hdr5->unit_type == Dwarf32::unit_type::DW_UT_skeleton
-         )
+      DBG_PRINTF("signature        = %lX\n", *(const uint64_t *)info);
+      info += 8 + address_size_;
+    }
+    if ( unit_hdr5->unit_type == Dwarf32::unit_type::DW_UT_split_compile ||
+         unit_hdr5->unit_type == Dwarf32::unit_type::DW_UT_skeleton
+       )
+    {
+      info += 8;
+    }
+    DBG_PRINTF("hdr5: %lx\n", info-debug_info_.s_);
+  }
+  return info;
+}
+
+// parse single compilation unit at info
+// seq_lines is false when units are not processed sequentially - then we can't track .debug_line
+bool ElfFile::ParseUnit(const unsigned char* &info, size_t &info_bytes, bool seq_lines)
+{
+  // Load the compilation unit information
+  const unsigned char* cu_start = info;
+  cu_base = cu_start - debug_info_.s_;
+  const unsigned char* info_end;
+  uint32_t abbrev_offset;
+  auto first_tag = read_unit_hdr(info, info_end, abbrev_offset);
+  info_bytes -= first_tag - info;
+  info = first_tag;
+  UnitTime *ut = g_timings ? add_unit_time(cu_base, info_end - cu_start) : nullptr;
+  // read debug lines
+  if ( !seq_lines )
+    reset_lines();
+  else if ( !read_debug_lines() )
+    debug_line_.clean();
+
+  bool abbrevs;
+  {
+    PhaseTimer pt(tp_abbrevs);
+    abbrevs = LoadAbbrevTags(abbrev_offset);
+  }
+  if ( !abbrevs ) {
+    tree_builder->e_->error("ERR: Can't load the compilation, abbrev_offset %X\n", abbrev_offset);
+    return false;
+  }
+  if ( g_opt_d && g_outf )
+    fprintf(g_outf, "reset level\n");
+  m_level = 0;
+
+  // reset bases for new compilation unit
+  offsets_base = 0;
+  addr_base = 0;
+  loclist_base = 0;
+  PhaseTimer pt(tp_parse, ut ? &ut->parse_ns : nullptr);
+  // For all compilation tags
+  while (info < info_end) {
+    m_tag_id = info - debug_info_.s_; 
+    uint32_t info_number = ElfFile::ULEB128(info, info_bytes);
+    DBG_PRINTF(".info+%lx\t Info Number %X\n", info-debug_info_.s_, info_number);
+    if (!info_number) { // reserved
+      if ( m_level )
       {
-        info += 8;
-        info_bytes -= 8;
+        m_level--;
+        tree_builder->pop_stack(info-debug_info_.s_);
       }
-      DBG_PRINTF("hdr5: %lx\n", info-debug_info_.s_);
+      continue;
     }
-    // read debug lines
-    if ( !read_debug_lines() )
-      debug_line_.clean();
+    if ( ut ) ut->dies++;
 
-    if (!LoadAbbrevTags(abbrev_offset)) {
-      tree_builder->e_->error("ERR: Can't load the compilation, abbrev_offset %X\n", abbrev_offset);
+    std::map<unsigned int, struct TagSection>::iterator it_section = compilation_unit_.find(info_number);
+    if (it_section == compilation_unit_.end()) {
+      tree_builder->e_->error("ERR: Can't find tag number %X\n", info_number);
       return false;
     }
-    if ( g_opt_d && g_outf )
-      fprintf(g_outf, "reset level\n");
-    m_level = 0;
-
-    // reset bases for new compilation unit
-    offsets_base = 0;
-    addr_base = 0;
-    loclist_base = 0;
-    // For all compilation tags
-    while (info < info_end) {
-      m_tag_id = info - debug_info_.s_; 
-      uint32_t info_number = ElfFile::ULEB128(info, info_bytes);
-      DBG_PRINTF(".info+%lx\t Info Number %X\n", info-debug_info_.s_, info_number);
-      if (!info_number) { // reserved
-        if ( m_level )
-        {
-          m_level--;
-          tree_builder->pop_stack(info-debug_info_.s_);
-        }
-        continue;
-      }
-
-      std::map<unsigned int, struct TagSection>::iterator it_section = compilation_unit_.find(info_number);
-      if (it_section == compilation_unit_.end()) {
-        tree_builder->e_->error("ERR: Can't find tag number %X\n", info_number);
-        return false;
-      }
-      m_section = &it_section->second;
-      const unsigned char* abbrev = m_section->ptr;
-      size_t abbrev_bytes = debug_abbrev_.size_ - (abbrev - debug_abbrev_.s_);
+    m_section = &it_section->second;
+    const unsigned char* abbrev = m_section->ptr;
+    size_t abbrev_bytes = debug_abbrev_.size_ - (abbrev - debug_abbrev_.s_);
 //      if ( m_tag_id == 0x4671b6 ) {
 //  printf("before RegisterNewTag(%X) m_regged %d taf %lX\n", m_section->type, m_regged, m_tag_id);
 //      }
-      m_regged = RegisterNewTag(m_section->type);
-      bool added = m_regged;
-      m_next = 0;
+    m_regged = RegisterNewTag(m_section->type);
+    bool added = m_regged;
+    m_next = 0;
+    bool is_scope = m_aindex && is_addr_scope(m_section->type);
+    if ( is_scope )
+    {
+      memset(&m_ps, 0, sizeof(m_ps));
+      m_ps.rng = (uint64_t)-1;
+    }
 
-      if ( g_opt_d && g_outf )
-        fprintf(g_outf, "%d GetAllClasses %lx size %lx regged %d\n", m_level, m_tag_id, abbrev_bytes, m_regged);
+    if ( g_opt_d && g_outf )
+      fprintf(g_outf, "%d GetAllClasses %lx size %lx regged %d\n", m_level, m_tag_id, abbrev_bytes, m_regged);
 
-      // For all attributes
-      while (*abbrev) 
-      {
-        curr_asgn = nullptr;
-        Dwarf32::Attribute abbrev_attribute = static_cast<Dwarf32::Attribute>(
-            ElfFile::ULEB128(abbrev, abbrev_bytes));
-        Dwarf32::Form abbrev_form = 
-            static_cast<Dwarf32::Form>(ElfFile::ULEB128(abbrev, abbrev_bytes));
-        if ( abbrev_form == Dwarf32::Form::DW_FORM_implicit_const )
-          m_implicit_const = ElfFile::SLEB128(abbrev, abbrev_bytes);
+    // For all attributes
+    while (*abbrev) 
+    {
+      curr_asgn = nullptr;
+      Dwarf32::Attribute abbrev_attribute = static_cast<Dwarf32::Attribute>(
+          ElfFile::ULEB128(abbrev, abbrev_bytes));
+      Dwarf32::Form abbrev_form = 
+          static_cast<Dwarf32::Form>(ElfFile::ULEB128(abbrev, abbrev_bytes));
+      if ( abbrev_form == Dwarf32::Form::DW_FORM_implicit_const )
+        m_implicit_const = ElfFile::SLEB128(abbrev, abbrev_bytes);
 
-        if ( g_opt_d && g_outf )
-          fprintf(g_outf,".info+%lx\t %02x %02x\n", info-debug_info_.s_, 
-                                                abbrev_attribute, abbrev_form);
-        bool logged = LogDwarfInfo(abbrev_attribute, abbrev_form, info, info_bytes, cu_start);
-        if (!logged) {
-          DBG_PRINTF("abbrev_form %X\n", abbrev_form);
-          ElfFile::PassData(abbrev_form, info, info_bytes);
-        }
-      }
-      // now tag has fully readed names so we can check if it really not filtered
-      if ( m_regged )
-        m_regged = tree_builder->PostProcessTag();
-        
-      if ( !m_regged /* && m_level */ && m_next )
-      {
-        const unsigned char* info2 = cu_start + m_next;
-        if ( g_opt_d && g_outf )
-          fprintf(g_outf, "%lX m_next %lX - %lX\n", info - debug_info_.s_, m_next, info2 - debug_info_.s_);
-        if ( info2 > info )
-        {
-          info_bytes -= info2 - info;
-          info = info2;
-          if ( !info_bytes )
-            break;
-          else
-            goto skip_level;
-        }
+      if ( g_opt_d && g_outf )
+        fprintf(g_outf,".info+%lx\t %02x %02x\n", info-debug_info_.s_, 
+                                              abbrev_attribute, abbrev_form);
+      if ( is_scope )
+        collect_scope_attr(abbrev_attribute, abbrev_form, info, info_bytes, cu_start);
+      bool logged = LogDwarfInfo(abbrev_attribute, abbrev_form, info, info_bytes, cu_start);
+      if (!logged) {
+        DBG_PRINTF("abbrev_form %X\n", abbrev_form);
+        ElfFile::PassData(abbrev_form, info, info_bytes);
       }
-      if ( m_section->has_children )
+    }
+    // now tag has fully readed names so we can check if it really not filtered
+    if ( m_regged )
+      m_regged = tree_builder->PostProcessTag();
+    if ( is_scope )
+      add_addr_scope();
+    // don't skip children of functions when collecting address index - they can contain inlined subroutines
+    if ( !m_regged /* && m_level */ && m_next && !is_scope )
+    {
+      const unsigned char* info2 = cu_start + m_next;
+      if ( g_opt_d && g_outf )
+        fprintf(g_outf, "%lX m_next %lX - %lX\n", info - debug_info_.s_, m_next, info2 - debug_info_.s_);
+      if ( info2 > info )
       {
-        m_level++;
-        tree_builder->add2stack(added);
+        info_bytes -= info2 - info;
+        info = info2;
+        if ( !info_bytes )
+          break;
+        else
+          goto skip_level;
       }
-skip_level:
-       ;
     }
+    if ( m_section->has_children )
+    {
+      m_level++;
+      tree_builder->add2stack(added);
+    }
+skip_level:
+     ;
+  }
+  return true;
+}
+
+bool ElfFile::GetAllClasses() 
+{
+  const unsigned char* info = reinterpret_cast<const unsigned char*>(debug_info_.s_);
+  size_t info_bytes = debug_info_.size_;
+  m_curr_lines = debug_line_.s_;
+
+  while (info_bytes > 0) {
+    // process previous compilation unit
+    process_unit();
+    if ( !ParseUnit(info, info_bytes, true) )
+      return false;
   }
   // process last compilation unit
-  tree_builder->ProcessUnit(1);
+  process_unit(1);
+  if ( m_aindex )
+    m_aindex->build();
 
   return true;
 }
 
+// read address ranges of compilation units from .debug_aranges
+// returns set of units described there
+bool ElfFile::parse_aranges(std::set<uint64_t> &units)
+{
+  if ( debug_aranges_.empty() ) return false;
+  const unsigned char *start = debug_aranges_.s_,
+   *finish = start + debug_aranges_.size_;
+  while( start + 4 < finish )
+  {
+    auto set_start = start;
+    uint64_t len = endc(*(const uint32_t *)start);
+    start += 4;
+    unsigned int off_size = 4;
+    if ( 0xffffffff == len )
+    {
+      if ( finish - start < 8 ) return false;
+      len = endc(*(const uint64_t *)start);
+      start += 8;
+      off_size = 8;
+    }
+    if ( len > uint64_t(finish - start) || len < 2 + off_size + 2 )
+    {
+      tree_builder->e_->warning("bad aranges set length %lx at %lx\n", len, set_start - debug_aranges_.s_);
+      return !units.empty();
+    }
+    auto set_end = start + len;
+    start += 2; // version
+    uint64_t cu_off = off_size == 4 ? endc(*(const uint32_t *)start) : endc(*(const uint64_t *)start);
+    start += off_size;
+    unsigned char asize = *start++;
+    unsigned char seg_size = *start++;
+    if ( seg_size || (asize != 4 && asize != 8) || cu_off >= debug_info_.size_ )
+    {
+      start = set_end;
+      continue;
+    }
+    // tuples are aligned to twice the address size from start of set
+    unsigned int tuple = 2 * asize;
+    size_t hdr = start - set_start;
+    if ( hdr % tuple )
+      start += tuple - hdr % tuple;
+    units.insert(cu_off);
+    for ( ; start + tuple <= set_end; start += tuple )
+    {
+      uint64_t addr, length;
+      if ( asize == 8 )
+      {
+        addr = endc(*(const uint64_t *)start);
+        length = endc(*(const uint64_t *)(start + 8));
+      } else {
+        addr = endc(*(const uint32_t *)start);
+        length = endc(*(const uint32_t *)(start + 4));
+      }
+      if ( !addr && !length ) break;
+      if ( length )
+        m_cu_ranges.push_back( { addr, addr + length, cu_off } );
+    }
+    start = set_end;
+  }
+  return !units.empty();
+}
+
+// cheap scan of compile_unit tag only for DW_AT_low_pc/DW_AT_high_pc/DW_AT_ranges
+bool ElfFile::scan_unit_ranges(const unsigned char *info, const unsigned char *info_end, uint32_t abbrev_offset)
+{
+  uint64_t cu_off = cu_base;
+  size_t info_bytes = info_end - info;
+  uint32_t number = ElfFile::ULEB128(info, info_bytes);
+  if ( !number || abbrev_offset >= debug_abbrev_.size_ ) return false;
+  // find abbrev for first tag
+  const unsigned char *abbrev = debug_abbrev_.s_ + abbrev_offset;
+  size_t abbrev_bytes = debug_abbrev_.size_ - abbrev_offset;
+  const unsigned char *attrs = nullptr;
+  while( abbrev_bytes > 0 && abbrev[0] )
+  {
+    auto n = ElfFile::ULEB128(abbrev, abbrev_bytes);
+    auto tag = ElfFile::ULEB128(abbrev, abbrev_bytes);
+    abbrev++; abbrev_bytes--; // has_children
+    if ( n == number )
+    {
+      if ( tag != Dwarf32::Tag::DW_TAG_compile_unit && tag != Dwarf32::Tag::DW_TAG_partial_unit ) return false;
+      attrs = abbrev;
+      break;
+    }
+    while (abbrev_bytes > 0 && abbrev[0]) {
+      ElfFile::ULEB128(abbrev, abbrev_bytes);
+      unsigned long form = ElfFile::ULEB128(abbrev, abbrev_bytes);
+      if (form == Dwarf32::Form::DW_FORM_implicit_const)
+        ElfFile::SLEB128(abbrev, abbrev_bytes);
+    }
+    abbrev += 2;
+    abbrev_bytes -= 2;
+  }
+  if ( !attrs ) return false;
+  // two passes - first to get bases, second to read addresses bcs DW_AT_addr_base can follow DW_AT_low_pc
+  addr_base = rnglists_base = 0;
+  uint64_t low = 0, high = 0, rng = (uint64_t)-1;
+  bool has_low = false, has_high = false, high_is_off = false;
+  const unsigned char *tag_start = info;
+  size_t tag_bytes = info_bytes;
+  for ( int pass = 0; pass < 2; pass++ )
+  {
+    abbrev = attrs;
+    abbrev_bytes = debug_abbrev_.size_ - (attrs - debug_abbrev_.s_);
+    info = tag_start;
+    info_bytes = tag_bytes;
+    while (*abbrev)
+    {
+      auto attribute = static_cast<Dwarf32::Attribute>(ElfFile::ULEB128(abbrev, abbrev_bytes));
+      auto form = static_cast<Dwarf32::Form>(ElfFile::ULEB128(abbrev, abbrev_bytes));
+      if ( form == Dwarf32::Form::DW_FORM_implicit_const )
+        m_implicit_const = ElfFile::SLEB128(abbrev, abbrev_bytes);
+      if ( !pass && attribute == Dwarf32::Attribute::DW_AT_addr_base )
+        addr_base = FormDataValue(form, info, info_bytes);
+      else if ( !pass && attribute == Dwarf32::Attribute::DW_AT_rnglists_base )
+        rnglists_base = FormDataValue(form, info, info_bytes);
+      else if ( pass && attribute == Dwarf32::Attribute::DW_AT_low_pc )
+      {
+        low = FormDataValue(form, info, info_bytes);
+        has_low = true;
+      } else if ( pass && attribute == Dwarf32::Attribute::DW_AT_high_pc )
+      {
+        high_is_off = form != Dwarf32::Form::DW_FORM_addr &&
+          form != Dwarf32::Form::DW_FORM_addrx && form != Dwarf32::Form::DW_FORM_addrx1 &&
+          form != Dwarf32::Form::DW_FORM_addrx2 && form != Dwarf32::Form::DW_FORM_addrx3 &&
+          form != Dwarf32::Form::DW_FORM_addrx4;
+        high = FormDataValue(form, info, info_bytes);
+        has_high = true;
+      } else if ( pass && attribute == Dwarf32::Attribute::DW_AT_ranges &&
+                  (!debug_ranges_.empty() || !debug_rnglists_.empty()) )
+        read_range(form, info, info_bytes, rng);
+      else
+        ElfFile::PassData(form, info, info_bytes);
+    }
+  }
+  if ( (size_t)addr_base > debug_addr_.size_ ) addr_base = 0;
+  if ( (size_t)rnglists_base > debug_rnglists_.size_ ) rnglists_base = 0;
+  size_t old_size = m_cu_ranges.size();
+  if ( rng != (uint64_t)-1 )
+  {
+    std::list<std::pair<uint64_t, uint64_t> > ranges;
+    if ( !debug_rnglists_.empty() )
+      get_rnglistx_(rng, ranges);
+    else
+      get_old_range(rng, low, address_size_, ranges);
+    for ( auto &r: ranges )
+      if ( r.first < r.second )
+        m_cu_ranges.push_back( { r.first, r.second, cu_off } );
+  } else if ( has_low && has_high )
+  {
+    uint64_t end = high_is_off ? low + high : high;
+    if ( low < end )
+      m_cu_ranges.push_back( { low, end, cu_off } );
+  }
+  return old_size != m_cu_ranges.size();
+}
+
+// build sorted address -> unit offset table
+bool ElfFile::build_cu_index()
+{
+  std::set<uint64_t> units;
+  m_cu_ranges.clear();
+  parse_aranges(units);
+  // units missing in .debug_aranges - clang for example does not produce it by default
+  const unsigned char* info = debug_info_.s_;
+  while( info + sizeof(Dwarf32::CompilationUnitHdr) < debug_info_.s_ + debug_info_.size_ )
+  {
+    const unsigned char *info_end;
+    uint32_t abbrev_offset;
+    cu_base = info - debug_info_.s_;
+    auto first_tag = read_unit_hdr(info, info_end, abbrev_offset);
+    if ( info_end <= info || info_end > debug_info_.s_ + debug_info_.size_ ) break;
+    if ( units.find(cu_base) == units.end() )
+      scan_unit_ranges(first_tag, info_end, abbrev_offset);
+    info = info_end;
+  }
+  std::sort(m_cu_ranges.begin(), m_cu_ranges.end(), [](const cu_range &a, const cu_range &b) {
+    return a.start < b.start;
+  });
+  // ranges can be nested or overlapped, so keep max end of all ranges before each
+  m_cu_max_end.resize(m_cu_ranges.size());
+  uint64_t max_end = 0;
+  for ( size_t i = 0; i < m_cu_ranges.size(); i++ )
+  {
+    if ( m_cu_ranges[i].end > max_end )
+      max_end = m_cu_ranges[i].end;
+    m_cu_max_end[i] = max_end;
+  }
+  return !m_cu_ranges.empty();
+}
+
+// add offsets of all units containing addr - with ICF there can be several
+bool ElfFile::find_units(uint64_t addr, std::set<uint64_t> &units) const
+{
+  auto ri = std::upper_bound(m_cu_ranges.begin(), m_cu_ranges.end(), addr,
+    [](uint64_t v, const cu_range &r) { return v < r.start; });
+  bool res = false;
+  for ( size_t i = ri - m_cu_ranges.begin(); i && addr < m_cu_max_end[i - 1]; i-- )
+  {
+    if ( addr < m_cu_ranges[i - 1].end )
+    {
+      units.insert(m_cu_ranges[i - 1].cu_off);
+      res = true;
+    }
+  }
+  return res;
+}
+
+// parse only units owning addresses
+bool ElfFile::GetUnitsByAddr(const std::vector<uint64_t> &addrs)
+{
+  if ( m_cu_ranges.empty() && !build_cu_index() )
+  {
+    tree_builder->e_->warning("cannot find address ranges of compilation units\n");
+    return false;
+  }
+  std::set<uint64_t> units;
+  for ( auto a: addrs )
+    find_units(a, units);
+  if ( g_opt_v && g_sink )
+    g_sink->printf("// %ld unit ranges, %ld units to parse\n", m_cu_ranges.size(), units.size());
+  bool res = true;
+  for ( auto cu_off: units )
+  {
+    process_unit();
+    const unsigned char* info = debug_info_.s_ + cu_off;
+    size_t info_bytes = debug_info_.size_ - cu_off;
+    if ( !ParseUnit(info, info_bytes, false) )
+    {
+      res = false;
+      break;
+    }
+  }
+  process_unit(1);
+  if ( m_aindex )
+    m_aindex->build();
+  return res;
+}
+
 
@@ -1,14 +1,19 @@
 #pragma once
 #include <string>
 #include <map>
+#include <set>
+#include <unordered_set>
 #include <vector>
+#include <mutex>
 #include <elfio/elfio.hpp>
 #include "dwarf32.h"
 #include "TreeBuilder.h"
+#include "AddrIndex.h"
 
 using namespace ELFIO;
 
 struct one_cie;
+struct one_fde;
 struct saved_section
 {
   std::string name;
@@ -35,7 +40,8 @@ typedef struct
 } DWARF2_Internal_LineInfo;
 
 struct dwarf_section {
- Elf_Half idx = 0;
+ Elf_Word idx = 0; // section index, same type as sh_info of reloc sections
+
  bool free_ = false;
  const unsigned char *s_ = nullptr;
  size_t size_ = 0;
@@ -44,7 +50,10 @@ struct dwarf_section {
  void clean()
  {
    if ( free_ && s_ )
+   {
+     g_mem[mk_sections].sub(size_);
      free((void *)s_);
+   }
    s_ = nullptr;
    free_ = false;
  }
@@ -52,10 +61,11 @@ struct dwarf_section {
  {
    clean();
  }
- void asgn(section *s)
+ // section::get_index is Elf_Half, so take real index from caller
+ void asgn(section *s, Elf_Word i)
  {
    clean();
-   idx = s->get_index();
+   idx = i;
    vma_ = s->get_address();
    size_ = s->get_size();
    s_ = reinterpret_cast<const unsigned char*>(s->get_data());
@@ -81,18 +91,35 @@ struct elf_symbol {
   unsigned char bind = 0, type = 0, other = 0;
 };
 
-class ElfFile : public ISectionNames, public IGetLoclistX
+class ElfFile : public ISectionNames, public IGetLoclistX, public IGetCFA
 {
 public:
   ElfFile(TreeBuilder *tb) : tree_builder(tb)
   { }
-  virtual ~ElfFile() {}
+  virtual ~ElfFile()
+  {
+    g_mem[mk_loclists].sub(m_list_items_mem, 0);
+  }
   bool GetAllClasses();
+  // parse only compilation units containing addresses
+  bool GetUnitsByAddr(const std::vector<uint64_t> &);
   bool SaveSections(std::string &fname);
+  // collect address ranges of functions into index during GetAllClasses
+  void SetAddrIndex(AddrIndex *ai)
+  {
+    m_aindex = ai;
+  }
   // ISectionNames
   virtual int find_sname(uint64_t, std::string &) override;
   // IGetLoclistX
   virtual bool get_loclistx(uint64_t off, std::list<LocListXItem> &, uint64_t);
+  virtual const std::list<LocListXItem> *get_cached_loclistx(uint64_t off, uint64_t);
+  virtual const ListCacheStat *get_cache_stat() const
+  {
+    return &m_list_stat;
+  }
+  // IGetCFA
+  virtual bool find_cfa(uint64_t pc, CFARow &);
 private:
   bool unzip_section(ELFIO::section *, const unsigned char * &data, size_t &);
   bool check_compressed_section(ELFIO::section *, dwarf_section &ds);
@@ -109,6 +136,8 @@ private:
       const unsigned char* &info, size_t& bytes_available);
   const char* FormStringValue(Dwarf32::Form form,
       const unsigned char* &info, size_t& bytes_available);
+  const unsigned char *read_unit_hdr(const unsigned char* info, const unsigned char* &info_end, uint32_t &abbrev_offset);
+  bool ParseUnit(const unsigned char* &info, size_t &info_bytes, bool seq_lines);
   bool LoadAbbrevTags(uint32_t abbrev_offset);
   bool RegisterNewTag(Dwarf32::Tag tag);
   template <typename T>
@@ -147,6 +176,10 @@ private:
    debug_ranges_,
   // section with frame info - when opt_f
    debug_frame_,
+  // binary search table for .eh_frame - when opt_f
+   eh_frame_hdr_,
+  // address ranges of compilation units - when opt_a
+   debug_aranges_,
   // cuda sass register mapping
    cuda_sass_regs,
    cuda_sass_mregs; // for mercury
@@ -247,8 +280,77 @@ private:
   bool get_rnglistx_(int64_t off, std::list<std::pair<uint64_t, uint64_t> > &);
   bool get_old_range(int64_t off, uint64_t base_addr, unsigned char addr_size, std::list<std::pair<uint64_t, uint64_t> > &);
   virtual bool get_rnglistx(int64_t off, uint64_t base_addr, unsigned char addr_size, std::list<std::pair<uint64_t, uint64_t> > &);
+  // cache of decoded loclists/rnglists. section is fixed for whole file so key is offset + bases
+  struct list_key {
+    uint64_t off, base, addr_base;
+    bool operator<(const list_key &k) const
+    {
+      if ( off != k.off ) return off < k.off;
+      if ( base != k.base ) return base < k.base;
+      return addr_base < k.addr_base;
+    }
+  };
+  std::map<list_key, std::list<LocListXItem>, std::less<list_key>,
+    MemAlloc<std::pair<const list_key, std::list<LocListXItem> >, mk_loclists> > m_loc_cache;
+  // result of parsing is cached with list
+  typedef std::pair<bool, std::list<std::pair<uint64_t, uint64_t> > > cached_rng;
+  std::map<list_key, cached_rng, std::less<list_key>,
+    MemAlloc<std::pair<const list_key, cached_rng>, mk_loclists> > m_rng_cache;
+  size_t m_list_items_mem = 0; // items of cached lists, map nodes are counted by allocator
+  template <typename T>
+  inline void add_list_mem(const std::list<T> &l)
+  {
+    size_t mem = l.size() * (sizeof(T) + 2 * sizeof(void *));
+    m_list_items_mem += mem;
+    g_mem[mk_loclists].add(mem, 0);
+  }
+  ListCacheStat m_list_stat;
+  // without -g unit is rendered in ProcessUnit, so its lists are not needed after it
+  void process_unit(int last = 0);
+  void clear_list_caches();
+  // caches of lists & lazy FDEs are filled during rendering which can be parallel with -g
+  std::mutex m_lists_lock;
+  // address -> compilation unit offset, sorted by start
+  struct cu_range {
+    uint64_t start, end, cu_off;
+  };
+  std::vector<cu_range> m_cu_ranges;
+  std::vector<uint64_t> m_cu_max_end; // max end of m_cu_ranges[0..i]
+  bool parse_aranges(std::set<uint64_t> &);
+  bool scan_unit_ranges(const unsigned char *info, const unsigned char *info_end, uint32_t abbrev_offset);
+  bool build_cu_index();
+  bool find_units(uint64_t addr, std::set<uint64_t> &) const;
+  // data for functions address index
+  AddrIndex *m_aindex = nullptr;
+  struct pending_scope {
+    uint64_t low, high, origin, rng;
+    bool has_low, has_high, high_is_off;
+    const char *name, *link_name;
+  };
+  pending_scope m_ps;
+  std::vector<std::pair<int, int> > m_scope_stack; // level of children, index of scope
+  static inline bool is_addr_scope(Dwarf32::Tag t)
+  {
+    return t == Dwarf32::Tag::DW_TAG_subprogram ||
+           t == Dwarf32::Tag::DW_TAG_inlined_subroutine ||
+           t == Dwarf32::Tag::DW_TAG_lexical_block;
+  }
+  void collect_scope_attr(Dwarf32::Attribute, Dwarf32::Form, const unsigned char *info, size_t info_bytes, const void* unit_base);
+  void add_addr_scope();
   // data for CFA
-  std::map<uint64_t, uint64_t> m_dfa; // key - address, value - DFA_def_cfa_offset
+  struct fde_item {
+    uint64_t end; // pc_begin + pc_range
+    uint64_t dfa; // DFA_def_cfa_offset
+    bool has_dfa;
+    bool compiled = false; // rows for find_cfa are in m_cfa_pcs/m_cfa_rows
+    uint32_t rows_idx = 0, rows_count = 0;
+    const unsigned char *fde = nullptr; // start of entry in debug_frame_
+  };
+  std::map<uint64_t, fde_item> m_dfa; // key - start address of FDE
+  // sorted table from .eh_frame_hdr, when presents FDEs decoded on demand
+  const unsigned char *m_eh_table = nullptr;
+  uint64_t m_eh_count = 0;
+  std::unordered_set<uint64_t> m_eh_tried; // indexes in m_eh_table already decoded
   int eh_addr_size;
   unsigned int size_of_encoded_value(int);
   uint64_t byte_get(const unsigned char *, unsigned int size);
@@ -256,32 +358,101 @@ private:
   uint64_t get_encoded_value(const unsigned char **pdata, int encoding, const unsigned char *end);
   virtual bool find_dfa(uint64_t pc, uint64_t &res);
   bool parse_frames();
+  const unsigned char *read_fde(const unsigned char *, one_fde &, bool &is_fde);
+  std::map<uint64_t, fde_item>::iterator add_fde(one_fde &, const unsigned char *start);
+  std::map<uint64_t, fde_item>::iterator find_fde(uint64_t pc);
+  uint64_t read_hdr_value(const unsigned char *&, int encoding);
+  bool locate_eh_frame();
+  bool setup_eh_frame_hdr();
+  bool find_fde_lazy(uint64_t pc);
+  // compiled unwind tables - rows of each FDE are sorted by start address in m_cfa_pcs
+  struct cfa_row {
+    uint64_t end;
+    CFARule cfa;
+    uint32_t regs_idx; // index of first rule in m_cfa_regs
+    uint32_t regs_count;
+  };
+  struct cfa_state {
+    CFARule cfa;
+    std::vector<CFARule> regs; // sorted by reg
+  };
+  std::vector<uint64_t> m_cfa_pcs;
+  std::vector<cfa_row> m_cfa_rows;
+  std::vector<CFARule> m_cfa_regs;
+  bool compile_fde(one_fde &);
+  bool exec_cfa(const unsigned char *, const unsigned char *, one_fde &, cfa_state &, const cfa_state *initial, uint64_t &loc,
+    std::vector<std::pair<uint64_t, cfa_row> > *);
+  void push_cfa_row(uint64_t start, uint64_t end, cfa_state &, std::vector<std::pair<uint64_t, cfa_row> > &);
   const unsigned char *read_cie(const unsigned char *, const unsigned char *, one_cie &);
   bool parse_dfa(const unsigned char *, const unsigned char *, unsigned char ptr_size, uint64_t &);
   // relocs
-  dwarf_section *apply_to = nullptr;
   std::vector<elf_symbol> m_symbols;
   Elf_Xword sym_no = 0;
   Elf_Half machine = 0;
   bool uses_msp430x_relocs = false;
   bool had_relocs = false;
-  elf_symbol * saved_sym = nullptr;
-  uint64_t saved_sym1 = 0,
-    saved_sym2 = 0, value;
-  void reset_target_specific_reloc() {
-    saved_sym = nullptr;
-    saved_sym1 = saved_sym2 = 0;
-  }
+  // piece of work for applying relocs - whole reloc section or range of it
+  // has own state and errors buffer so tasks for different targets can run concurrently
+  struct reloc_task {
+    section *rs = nullptr;
+    dwarf_section *apply_to = nullptr;
+    Elf_Word inf = 0;
+    bool is_rela = false;
+    int from = 0, to = 0;
+    size_t applied = 0;
+    BufLog log;
+    // repeated errors are suppressed within task, for chunks of the same section they are
+    // deduplicated when logs are flushed - index of first such message in log or -1
+    int reloc_msg = -1, warn_msg = -1;
+    unsigned int first_reloc = 0, last_reloc = 0;
+    // state of target-specific sym diff relocs
+    elf_symbol *saved_sym = nullptr;
+    uint64_t saved_sym1 = 0,
+      saved_sym2 = 0, value = 0;
+  };
+  // relocs in single section are split to chunks of this size when it is safe
+  static constexpr int reloc_chunk_size = 0x10000;
+  bool can_split_relocs(bool is_rela) const;
+  void apply_relocs(reloc_task &);
   // read ULEB128 from apply_to section
-  uint64_t read_leb128(Elf64_Addr offset, bool sign,
+  uint64_t read_leb128(reloc_task &, Elf64_Addr offset, bool sign,
     unsigned int &length_return, int &status_return);
 
   void byte_put(const unsigned char *, uint64_t, unsigned int size);
   unsigned int get_reloc_type(unsigned int);
-  bool target_specific_reloc_handling(Elf_Half machine, Elf64_Addr, Elf_Word, unsigned, Elf_Sxword add);
+  // relocs of some machines need own processing, see target_reloc_handler
+  typedef bool (ElfFile::*target_reloc_fn)(reloc_task &, Elf64_Addr, Elf_Word, unsigned, Elf_Sxword add);
+  target_reloc_fn target_reloc_handler() const;
+  bool cuda_relocs(reloc_task &, Elf64_Addr, Elf_Word, unsigned, Elf_Sxword add);
+  bool loongarch_relocs(reloc_task &, Elf64_Addr, Elf_Word, unsigned, Elf_Sxword add);
+  bool msp430_relocs(reloc_task &, Elf64_Addr, Elf_Word, unsigned, Elf_Sxword add);
+  bool mn10300_relocs(reloc_task &, Elf64_Addr, Elf_Word, unsigned, Elf_Sxword add);
+  bool rl78_relocs(reloc_task &, Elf64_Addr, Elf_Word, unsigned, Elf_Sxword add);
   bool try_apply_debug_relocs();
-  typedef std::map<Elf_Half, dwarf_section *> RelS;
-  bool apply_debug_relocs(RelS &, std::list<Elf_Half> &);
+  // classification of reloc types, dense table for current machine
+  enum reloc_flags {
+    RF_NONE = 1,      // R_XX_NONE - skip
+    RF_INPLACE = 2,
+    RF_SUBTRACT = 4,
+    RF_PCREL = 8,
+    RF_6BIT = 0x10,
+    RF_6BIT_SUB = 0x20,
+  };
+  struct reloc_class {
+    unsigned char size; // 0 for unsupported relocs
+    unsigned char flags;
+  };
+  static constexpr unsigned int reloc_table_size = 512;
+  std::vector<reloc_class> m_reloc_table;
+  target_reloc_fn m_target_relocs = nullptr;
+  // table was filled for machine without knowledge of 32-bit relocs, warn when such reloc is applied
+  bool m_no_32bit_relocs = false;
+  reloc_class classify_reloc(unsigned int reloc_type, Elf_Half &prev_warn, ErrLog *);
+  void fill_reloc_table();
+  // for --timings
+  void time_reloc_classify(const std::list<reloc_task> &);
+  typedef std::map<Elf_Word, dwarf_section *> RelS;
+  bool apply_debug_relocs(RelS &, std::list<Elf_Word> &);
 };
 
 class ElfReaderOwner: public ElfFile
@@ -290,4 +461,5 @@ class ElfReaderOwner: public ElfFile
    ElfReaderOwner(std::string filepath, bool& success, TreeBuilder *);
  protected:
    elfio m_elf;
+   void check_shnum(const char *);
 };
\ No newline at end of file
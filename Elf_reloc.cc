@@ -1,5 +1,8 @@
 #include "ElfFile.h"
+#include "Timings.h"
 #include <limits.h>
+#include <atomic>
+#include <thread>
 
 // from elf/common.h
 #define EM_IAMCU	   6
@@ -42,6 +45,16 @@ ElfFile::get_reloc_type(unsigned int reloc_info)
   return reloc_info;
 }
 
+static void
+warn_no_32bit_reloc (Elf_Half machine, Elf_Half &prev_warn, ErrLog *e_)
+{
+  /* Avoid repeating the same warning multiple times.  */
+  if (prev_warn != machine)
+    e_->error("Missing knowledge of 32-bit reloc types used in DWARF sections of machine number %d\n",
+	     machine);
+  prev_warn = machine;
+}
+
 static bool
 is_32bit_abs_reloc (Elf_Half machine, unsigned int reloc_type, Elf_Half &prev_warn, ErrLog *e_)
 {
@@ -240,12 +253,7 @@ is_32bit_abs_reloc (Elf_Half machine, unsigned int reloc_type, Elf_Half &prev_wa
     case EM_Z80:
       return reloc_type == 6; /* R_Z80_32.  */
     default:
-
-	/* Avoid repeating the same warning multiple times.  */
-	if (prev_warn != machine)
-	  e_->error("Missing knowledge of 32-bit reloc types used in DWARF sections of machine number %d\n",
-		 machine);
-	prev_warn = machine;
+	warn_no_32bit_reloc(machine, prev_warn, e_);
 	return false;
     }
 }
@@ -832,11 +840,11 @@ is_none_reloc (Elf_Half machine, unsigned int reloc_type)
   return false;
 }
 
-uint64_t ElfFile::read_leb128(Elf64_Addr offset, bool sign,
+uint64_t ElfFile::read_leb128(reloc_task &t, Elf64_Addr offset, bool sign,
     unsigned int &num_read, int &status)
 {
-  const unsigned char *data = apply_to->s_ + offset,
-   *end = apply_to->s_ + apply_to->size_;
+  const unsigned char *data = t.apply_to->s_ + offset,
+   *end = t.apply_to->s_ + t.apply_to->size_;
   uint64_t result = 0;
   unsigned int shift = 0;
   num_read = 0;
@@ -877,255 +885,267 @@ uint64_t ElfFile::read_leb128(Elf64_Addr offset, bool sign,
 
 }
 
-bool ElfFile::target_specific_reloc_handling(Elf_Half machine, Elf64_Addr offset,
- Elf_Word sym_index, unsigned reloc_type, Elf_Sxword add)
+// handler of relocs which need state or special processing for current machine, nullptr if there are none
+ElfFile::target_reloc_fn ElfFile::target_reloc_handler() const
 {
-  unsigned int reloc_size = 0;
-  int leb_ret = 0;
-  uint64_t value = 0;
-  switch (machine)
-    {
+  switch(machine)
+  {
     case EM_CUDA:
-       if ( !g_opt_m )
-       {
-         if ( 0x48 == reloc_type ) { // R_CUDA_UNUSED_CLEAR32
-           byte_put (apply_to->s_ + offset, 0, 4);
-           return true;
-         } else if ( 0x49 == reloc_type ) { // R_CUDA_UNUSED_CLEAR64
-           byte_put (apply_to->s_ + offset, 0, 8);
-           return true;
-         }
-       }
-     break;
+      return g_opt_m ? nullptr : &ElfFile::cuda_relocs;
     case EM_LOONGARCH:
-      {
-	switch (reloc_type)
-	  {
-	    /* For .uleb128 .LFE1-.LFB1, loongarch write 0 to object file
-	       at assembly time.  */
-	    case 107: /* R_LARCH_ADD_ULEB128.  */
-	    case 108: /* R_LARCH_SUB_ULEB128.  */
-	      {
-		if (offset < (size_t)apply_to->size_ )
-		  value = read_leb128 (offset, false, reloc_size, leb_ret);
-		if ( leb_ret != 0 || reloc_size == 0 || reloc_size > 8 )
-		  tree_builder->e_->error("LoongArch ULEB128 field at 0x%lx contains invalid "
-			   "ULEB128 value\n", offset);
-
-		else if (sym_index >= m_symbols.size())
-		  tree_builder->e_->error("%s reloc contains invalid symbol index %d\n",
-			 (reloc_type == 107
-			  ? "R_LARCH_ADD_ULEB128"
-			  : "R_LARCH_SUB_ULEB128"),
-			 sym_index);
-		else
-		  {
-		    if (reloc_type == 107)
-		      value += add + m_symbols[sym_index].addr;
-		    else
-		      value -= add + m_symbols[sym_index].addr;
-
-		    /* Write uleb128 value to p.  */
-		    unsigned char *p = (unsigned char *)apply_to->s_ + offset;
-		    do
-		      {
-			unsigned char c = value & 0x7f;
-			value >>= 7;
-			if (--reloc_size != 0)
-			  c |= 0x80;
-			*p++ = c;
-		      }
-		    while (reloc_size);
-		  }
-
-		return true;
-	      }
-	  }
-	break;
-      }
-
+      return &ElfFile::loongarch_relocs;
     case EM_MSP430:
     case EM_MSP430_OLD:
-      {
-	
-	switch (reloc_type)
-	  {
-	  case 10: /* R_MSP430_SYM_DIFF */
-	  case 12: /* R_MSP430_GNU_SUB_ULEB128 */
-	    if (uses_msp430x_relocs )
-	      break;
-	    /* Fall through.  */
-	  case 21: /* R_MSP430X_SYM_DIFF */
-	  case 23: /* R_MSP430X_GNU_SUB_ULEB128 */
-	    /* PR 21139.  */
-	    if (sym_index >= m_symbols.size())
-	      tree_builder->e_->error("%s reloc contains invalid symbol index "
-		       "%d\n", "MSP430 SYM_DIFF", sym_index);
-	    else
-	      saved_sym = &m_symbols[sym_index];
-	    return true;
-
-	  case 1: /* R_MSP430_32 or R_MSP430_ABS32 */
-	  case 3: /* R_MSP430_16 or R_MSP430_ABS8 */
-	    goto handle_sym_diff;
-
-	  case 5: /* R_MSP430_16_BYTE */
-	  case 9: /* R_MSP430_8 */
-	  case 11: /* R_MSP430_GNU_SET_ULEB128 */
-	    if (uses_msp430x_relocs)
-	      break;
-	    goto handle_sym_diff;
-
-	  case 2: /* R_MSP430_ABS16 */
-	  case 15: /* R_MSP430X_ABS16 */
-	  case 22: /* R_MSP430X_GNU_SET_ULEB128 */
-	    if (! uses_msp430x_relocs )
-	      break;
-	    goto handle_sym_diff;
-
-	  handle_sym_diff:
-	    if (saved_sym != NULL)
-	      {
-		switch (reloc_type)
-		  {
-		  case 1: /* R_MSP430_32 or R_MSP430_ABS32 */
-		    reloc_size = 4;
-		    break;
-		  case 11: /* R_MSP430_GNU_SET_ULEB128 */
-		  case 22: /* R_MSP430X_GNU_SET_ULEB128 */
-		    if (offset < apply_to->size_)
-		      read_leb128 (offset, false, reloc_size, leb_ret);
-		    break;
-		  default:
-		    reloc_size = 2;
-		    break;
-		  }
-
-		if (leb_ret != 0 || reloc_size == 0 || reloc_size > 8)
-		  tree_builder->e_->error("MSP430 ULEB128 field at %lX contains invalid ULEB128 value\n",
-			 offset);
-		else if (sym_index >= m_symbols.size())
-		  tree_builder->e_->error("%s reloc contains invalid symbol index "
-			   "%d \n", "MSP430", sym_index);
-		else
-		  {
-		    value = add + (m_symbols[sym_index].addr - saved_sym->addr);
-
-		    if (apply_to->in_section(offset, reloc_size))
-		      byte_put (apply_to->s_ + offset, value, reloc_size);
-		    else
-		      /* PR 21137 */
-		      tree_builder->e_->error("MSP430 sym diff reloc contains invalid offset: "
-			       "%lX\n", offset);
-		  }
-
-		saved_sym = NULL;
-		return true;
-	      }
-	    break;
-
-	  default:
-	    if (saved_sym != NULL)
-	      tree_builder->e_->error("Unhandled MSP430 reloc type found after SYM_DIFF reloc\n");
-	    break;
-	  }
-	break;
-      }
-
+      return &ElfFile::msp430_relocs;
     case EM_MN10300:
     case EM_CYGNUS_MN10300:
-      {
-	
-	switch (reloc_type)
-	  {
-	  case 34: /* R_MN10300_ALIGN */
-	    return true;
-	  case 33: /* R_MN10300_SYM_DIFF */
-	    if (sym_index >= m_symbols.size())
-	      tree_builder->e_->error("%s reloc contains invalid symbol index "
-		       "%d\n", "MN10300_SYM_DIFF", sym_index);
-	    else
-	      saved_sym = &m_symbols[sym_index];
-	    return true;
-
-	  case 1: /* R_MN10300_32 */
-	  case 2: /* R_MN10300_16 */
-	    if (saved_sym != NULL)
-	      {
-		reloc_size = reloc_type == 1 ? 4 : 2;
-
-		if (sym_index >= m_symbols.size())
-		  tree_builder->e_->error("%s reloc contains invalid symbol index "
-			   "%d\n", "MN10300", sym_index);
-		else
-		  {
-		    value = add + (m_symbols[sym_index].addr - saved_sym->addr);
-
-		    if ( apply_to->in_section(offset, reloc_size))
-		      byte_put (apply_to->s_ + offset, value, reloc_size);
-		    else
-		      tree_builder->e_->error("MN10300 sym diff reloc contains invalid offset:"
-			       " %lX\n", offset);
-		  }
-
-		saved_sym = NULL;
-		return true;
-	      }
-	    break;
-	  default:
-	    if (saved_sym != NULL)
-	      tree_builder->e_->error("Unhandled MN10300 reloc type %d found after SYM_DIFF reloc\n", reloc_type);
-	    break;
-	  }
-	break;
-      }
-
+      return &ElfFile::mn10300_relocs;
     case EM_RL78:
-      {
+      return &ElfFile::rl78_relocs;
+  }
+  return nullptr;
+}
 
-	switch (reloc_type)
-	  {
-	  case 0x80: /* R_RL78_SYM.  */
-	    saved_sym1 = saved_sym2;
-	    if (sym_index >= m_symbols.size())
-	      tree_builder->e_->error("%s reloc contains invalid symbol index %d\n", "RL78_SYM", sym_index);
-	    else
-	      {
-		saved_sym2 = m_symbols[sym_index].addr;
-		saved_sym2 += add;
-	      }
-	    return true;
-
-	  case 0x83: /* R_RL78_OPsub.  */
-	    value = saved_sym1 - saved_sym2;
-	    saved_sym2 = saved_sym1 = 0;
-	    return true;
-	    break;
-
-	  case 0x41: /* R_RL78_ABS32.  */
-	    if ( apply_to->in_section(offset, 4))
-	      byte_put (apply_to->s_ + offset, value, 4);
-	    else
-	      tree_builder->e_->error("RL78 sym diff reloc contains invalid offset: %lX\n", offset);
-	    value = 0;
-	    return true;
-
-	  case 0x43: /* R_RL78_ABS16.  */
-	    if ( apply_to->in_section (offset, 2))
-	      byte_put (apply_to->s_ + offset, value, 2);
-	    else
-	      tree_builder->e_->error("RL78 sym diff reloc contains invalid offset: "
-		       "%lX\n", offset);
-	    value = 0;
-	    return true;
-
-	  default:
-	    break;
-	  }
-	break;
-      }
+bool ElfFile::cuda_relocs(reloc_task &t, Elf64_Addr offset, Elf_Word sym_index, unsigned reloc_type, Elf_Sxword add)
+{
+  if ( 0x48 == reloc_type ) { // R_CUDA_UNUSED_CLEAR32
+    byte_put (t.apply_to->s_ + offset, 0, 4);
+    return true;
+  } else if ( 0x49 == reloc_type ) { // R_CUDA_UNUSED_CLEAR64
+    byte_put (t.apply_to->s_ + offset, 0, 8);
+    return true;
+  }
+  return false;
+}
+
+bool ElfFile::loongarch_relocs(reloc_task &t, Elf64_Addr offset, Elf_Word sym_index, unsigned reloc_type, Elf_Sxword add)
+{
+  unsigned int reloc_size = 0;
+  int leb_ret = 0;
+  uint64_t value = 0;
+  switch (reloc_type)
+    {
+      /* For .uleb128 .LFE1-.LFB1, loongarch write 0 to object file
+         at assembly time.  */
+      case 107: /* R_LARCH_ADD_ULEB128.  */
+      case 108: /* R_LARCH_SUB_ULEB128.  */
+        {
+          if (offset < (size_t)t.apply_to->size_ )
+            value = read_leb128 (t, offset, false, reloc_size, leb_ret);
+          if ( leb_ret != 0 || reloc_size == 0 || reloc_size > 8 )
+            t.log.error("LoongArch ULEB128 field at 0x%lx contains invalid "
+                     "ULEB128 value\n", offset);
+
+          else if (sym_index >= m_symbols.size())
+            t.log.error("%s reloc contains invalid symbol index %d\n",
+                   (reloc_type == 107
+                    ? "R_LARCH_ADD_ULEB128"
+                    : "R_LARCH_SUB_ULEB128"),
+                   sym_index);
+          else
+            {
+              if (reloc_type == 107)
+                value += add + m_symbols[sym_index].addr;
+              else
+                value -= add + m_symbols[sym_index].addr;
+
+              /* Write uleb128 value to p.  */
+              unsigned char *p = (unsigned char *)t.apply_to->s_ + offset;
+              do
+                {
+                  unsigned char c = value & 0x7f;
+                  value >>= 7;
+                  if (--reloc_size != 0)
+                    c |= 0x80;
+                  *p++ = c;
+                }
+              while (reloc_size);
+            }
+
+          return true;
+        }
     }
+  return false;
+}
+
+bool ElfFile::msp430_relocs(reloc_task &t, Elf64_Addr offset, Elf_Word sym_index, unsigned reloc_type, Elf_Sxword add)
+{
+  unsigned int reloc_size = 0;
+  int leb_ret = 0;
+  uint64_t value = 0;
+  switch (reloc_type)
+    {
+    case 10: /* R_MSP430_SYM_DIFF */
+    case 12: /* R_MSP430_GNU_SUB_ULEB128 */
+      if (uses_msp430x_relocs )
+        break;
+      /* Fall through.  */
+    case 21: /* R_MSP430X_SYM_DIFF */
+    case 23: /* R_MSP430X_GNU_SUB_ULEB128 */
+      /* PR 21139.  */
+      if (sym_index >= m_symbols.size())
+        t.log.error("%s reloc contains invalid symbol index "
+                 "%d\n", "MSP430 SYM_DIFF", sym_index);
+      else
+        t.saved_sym = &m_symbols[sym_index];
+      return true;
+
+    case 1: /* R_MSP430_32 or R_MSP430_ABS32 */
+    case 3: /* R_MSP430_16 or R_MSP430_ABS8 */
+      goto handle_sym_diff;
+
+    case 5: /* R_MSP430_16_BYTE */
+    case 9: /* R_MSP430_8 */
+    case 11: /* R_MSP430_GNU_SET_ULEB128 */
+      if (uses_msp430x_relocs)
+        break;
+      goto handle_sym_diff;
+
+    case 2: /* R_MSP430_ABS16 */
+    case 15: /* R_MSP430X_ABS16 */
+    case 22: /* R_MSP430X_GNU_SET_ULEB128 */
+      if (! uses_msp430x_relocs )
+        break;
+      goto handle_sym_diff;
+
+    handle_sym_diff:
+      if (t.saved_sym != NULL)
+        {
+          switch (reloc_type)
+            {
+            case 1: /* R_MSP430_32 or R_MSP430_ABS32 */
+              reloc_size = 4;
+              break;
+            case 11: /* R_MSP430_GNU_SET_ULEB128 */
+            case 22: /* R_MSP430X_GNU_SET_ULEB128 */
+              if (offset < t.apply_to->size_)
+                read_leb128 (t, offset, false, reloc_size, leb_ret);
+              break;
+            default:
+              reloc_size = 2;
+              break;
+            }
+
+          if (leb_ret != 0 || reloc_size == 0 || reloc_size > 8)
+            t.log.error("MSP430 ULEB128 field at %lX contains invalid ULEB128 value\n",
+                   offset);
+          else if (sym_index >= m_symbols.size())
+            t.log.error("%s reloc contains invalid symbol index "
+                     "%d \n", "MSP430", sym_index);
+          else
+            {
+              value = add + (m_symbols[sym_index].addr - t.saved_sym->addr);
+
+              if (t.apply_to->in_section(offset, reloc_size))
+                byte_put (t.apply_to->s_ + offset, value, reloc_size);
+              else
+                /* PR 21137 */
+                t.log.error("MSP430 sym diff reloc contains invalid offset: "
+                         "%lX\n", offset);
+            }
+
+          t.saved_sym = NULL;
+          return true;
+        }
+      break;
+
+    default:
+      if (t.saved_sym != NULL)
+        t.log.error("Unhandled MSP430 reloc type found after SYM_DIFF reloc\n");
+      break;
+    }
+  return false;
+}
+
+bool ElfFile::mn10300_relocs(reloc_task &t, Elf64_Addr offset, Elf_Word sym_index, unsigned reloc_type, Elf_Sxword add)
+{
+  unsigned int reloc_size = 0;
+  uint64_t value = 0;
+  switch (reloc_type)
+    {
+    case 34: /* R_MN10300_ALIGN */
+      return true;
+    case 33: /* R_MN10300_SYM_DIFF */
+      if (sym_index >= m_symbols.size())
+        t.log.error("%s reloc contains invalid symbol index "
+                 "%d\n", "MN10300_SYM_DIFF", sym_index);
+      else
+        t.saved_sym = &m_symbols[sym_index];
+      return true;
+
+    case 1: /* R_MN10300_32 */
+    case 2: /* R_MN10300_16 */
+      if (t.saved_sym != NULL)
+        {
+          reloc_size = reloc_type == 1 ? 4 : 2;
+
+          if (sym_index >= m_symbols.size())
+            t.log.error("%s reloc contains invalid symbol index "
+                     "%d\n", "MN10300", sym_index);
+          else
+            {
+              value = add + (m_symbols[sym_index].addr - t.saved_sym->addr);
+
+              if ( t.apply_to->in_section(offset, reloc_size))
+                byte_put (t.apply_to->s_ + offset, value, reloc_size);
+              else
+                t.log.error("MN10300 sym diff reloc contains invalid offset:"
+                         " %lX\n", offset);
+            }
+
+          t.saved_sym = NULL;
+          return true;
+        }
+      break;
+    default:
+      if (t.saved_sym != NULL)
+        t.log.error("Unhandled MN10300 reloc type %d found after SYM_DIFF reloc\n", reloc_type);
+      break;
+    }
+  return false;
+}
+
+bool ElfFile::rl78_relocs(reloc_task &t, Elf64_Addr offset, Elf_Word sym_index, unsigned reloc_type, Elf_Sxword add)
+{
+  switch (reloc_type)
+    {
+    case 0x80: /* R_RL78_SYM.  */
+      t.saved_sym1 = t.saved_sym2;
+      if (sym_index >= m_symbols.size())
+        t.log.error("%s reloc contains invalid symbol index %d\n", "RL78_SYM", sym_index);
+      else
+        {
+          t.saved_sym2 = m_symbols[sym_index].addr;
+          t.saved_sym2 += add;
+        }
+      return true;
+
+    case 0x83: /* R_RL78_OPsub.  */
+      t.value = t.saved_sym1 - t.saved_sym2;
+      t.saved_sym2 = t.saved_sym1 = 0;
+      return true;
+      break;
+
+    case 0x41: /* R_RL78_ABS32.  */
+      if ( t.apply_to->in_section(offset, 4))
+        byte_put (t.apply_to->s_ + offset, t.value, 4);
+      else
+        t.log.error("RL78 sym diff reloc contains invalid offset: %lX\n", offset);
+      t.value = 0;
+      return true;
 
+    case 0x43: /* R_RL78_ABS16.  */
+      if ( t.apply_to->in_section (offset, 2))
+        byte_put (t.apply_to->s_ + offset, t.value, 2);
+      else
+        t.log.error("RL78 sym diff reloc contains invalid offset: "
+                 "%lX\n", offset);
+      t.value = 0;
+      return true;
+
+    default:
+      break;
+    }
   return false;
 }
 
@@ -1149,144 +1169,225 @@ void ElfFile::byte_put(const unsigned char *c, uint64_t value, unsigned int size
   }
 }
 
-// apply all reloc sections for rmaps
-bool ElfFile::apply_debug_relocs(RelS &rmaps, std::list<Elf_Half> &rs) {
- bool res = false;
- for ( auto irs: rs )
- {
-   section *cr = reader->sections[irs];
-   auto inf = cr->get_info();
-   auto si = rmaps.find(inf);
-   if ( si == rmaps.end() ) continue;
+// run chain of is_XX_reloc predicates for reloc_type
+ElfFile::reloc_class ElfFile::classify_reloc(unsigned int reloc_type, Elf_Half &prev_warn, ErrLog *e_)
+{
+  reloc_class res{ 0, 0 };
+  if (is_none_reloc (machine, reloc_type))
+  {
+    res.flags = RF_NONE;
+    return res;
+  }
+  bool reloc_subtract = false;
+  if (is_32bit_abs_reloc (machine, reloc_type, prev_warn, e_)
+      || is_32bit_pcrel_reloc (machine, reloc_type))
+    res.size = 4;
+  else if (is_64bit_abs_reloc (machine, reloc_type)
+      || is_64bit_pcrel_reloc (machine, reloc_type))
+    res.size = 8;
+  else if (is_24bit_abs_reloc (machine, reloc_type))
+    res.size = 3;
+  else if (is_16bit_abs_reloc (machine, reloc_type, uses_msp430x_relocs))
+    res.size = 2;
+  else if (is_8bit_abs_reloc (machine, reloc_type)
+      || is_6bit_abs_reloc (machine, reloc_type))
+    res.size = 1;
+  else {
+    if ((reloc_subtract = is_32bit_inplace_sub_reloc (machine, reloc_type))
+        || is_32bit_inplace_add_reloc (machine, reloc_type))
+      res.size = 4;
+    else if ((reloc_subtract = is_64bit_inplace_sub_reloc (machine, reloc_type))
+        || is_64bit_inplace_add_reloc (machine, reloc_type))
+      res.size = 8;
+    else if ((reloc_subtract = is_16bit_inplace_sub_reloc (machine, reloc_type))
+        || is_16bit_inplace_add_reloc (machine, reloc_type))
+      res.size = 2;
+    else if ((reloc_subtract = is_8bit_inplace_sub_reloc (machine, reloc_type))
+        || is_8bit_inplace_add_reloc (machine, reloc_type))
+      res.size = 1;
+    else if ((reloc_subtract = is_6bit_inplace_sub_reloc (machine, reloc_type))
+        || is_6bit_inplace_add_reloc (machine, reloc_type))
+      res.size = 1;
+    else
+      return res;
+    res.flags |= RF_INPLACE;
+    if ( reloc_subtract )
+      res.flags |= RF_SUBTRACT;
+  }
+  if (is_32bit_pcrel_reloc (machine, reloc_type)
+      || is_64bit_pcrel_reloc (machine, reloc_type))
+    res.flags |= RF_PCREL;
+  if (is_6bit_abs_reloc (machine, reloc_type)
+      || is_6bit_inplace_sub_reloc (machine, reloc_type)
+      || is_6bit_inplace_add_reloc (machine, reloc_type))
+    res.flags |= RF_6BIT;
+  if (is_6bit_inplace_sub_reloc (machine, reloc_type))
+    res.flags |= RF_6BIT_SUB;
+  return res;
+}
+
+// precompute classification of all reloc types lesser reloc_table_size for current machine
+void ElfFile::fill_reloc_table()
+{
+  Elf_Half prev_warn = 0;
+  // warning about unknown machine is postponed until some reloc is really applied
+  BufLog lazy;
+  m_reloc_table.resize(reloc_table_size);
+  for ( unsigned int i = 0; i < reloc_table_size; i++ )
+    m_reloc_table[i] = classify_reloc(i, prev_warn, &lazy);
+  m_no_32bit_relocs = lazy.size() != 0;
+  m_target_relocs = target_reloc_handler();
+}
+
+// classify types of all applied relocs with m_reloc_table and with classify_reloc to compare them
+void ElfFile::time_reloc_classify(const std::list<reloc_task> &tasks)
+{
+  std::vector<unsigned int> types;
+  for ( auto &t: tasks )
+  {
+    relocation_section_accessor ac(*reader, t.rs);
+    for ( int i = t.from; i < t.to; ++i )
+    {
+      Elf64_Addr offset = 0;
+      Elf_Word sym_idx = 0;
+      unsigned rtype = 0;
+      Elf_Sxword add = 0;
+      ac.get_entry(i, offset, sym_idx, rtype, add);
+      types.push_back(get_reloc_type(rtype));
+    }
+  }
+  if ( types.empty() ) return;
+  // errors were already reported by apply_relocs
+  BufLog dummy;
+  Elf_Half prev_warn = 0;
+  // sum of both passes must be 0, also keeps loops from optimizing away
+  unsigned int sum = 0;
+  auto start = mono_ns();
+  for ( auto rt: types )
+  {
+    auto rc = rt < m_reloc_table.size() ? m_reloc_table[rt] : classify_reloc(rt, prev_warn, &dummy);
+    sum += rc.size + (rc.flags << 8);
+  }
+  auto mid = mono_ns();
+  for ( auto rt: types )
+  {
+    auto rc = classify_reloc(rt, prev_warn, &dummy);
+    sum -= rc.size + (rc.flags << 8);
+  }
+  auto end = mono_ns();
+  g_reloc_times.relocs += types.size();
+  g_reloc_times.table_ns += mid - start;
+  g_reloc_times.chain_ns += end - mid;
+  if ( sum )
+    tree_builder->e_->warning("reloc table differs from classify_reloc\n");
+}
+
+// chunks of single reloc section can be applied concurrently only when each reloc
+// writes its own location and don't depend on previous ones
+bool ElfFile::can_split_relocs(bool is_rela) const
+{
+  if ( !is_rela || m_target_relocs ) return false;
+  if ( machine == EM_XTENSA || machine == EM_PJ || machine == EM_PJ_OLD ||
+       machine == EM_D30V || machine == EM_CYGNUS_D30V )
+    return false;
+  for ( auto &rc: m_reloc_table )
+    if ( rc.flags & (RF_INPLACE | RF_6BIT) ) return false;
+  return true;
+}
+
+void ElfFile::apply_relocs(reloc_task &t)
+{
+   relocation_section_accessor ac(*reader, t.rs);
    unsigned int prev_reloc = 0;
-   apply_to = si->second;
-   bool is_rela = cr->get_type() == SHT_RELA;
-   if ( g_opt_m ) {
-     cr->set_type(SHT_RELA);
-     is_rela = true;
-   } else if ( machine == EM_SH ) is_rela = false;
-   relocation_section_accessor ac(*reader, cr);
-   int num = ac.get_entries_num();
-   if ( g_opt_d )
-     printf("reloc section %d %s has %d entries, dest %d (%s)\n", irs, cr->get_name().c_str(),
-       num, inf, reader->sections[inf]->get_name().c_str());
    Elf_Half prev_warn = 0;
-   res = true;
-   for ( int i = 0; i < num; ++i )
+   for ( int i = t.from; i < t.to; ++i )
    {
      Elf64_Addr offset = 0;
      Elf_Word sym_idx = 0;
      unsigned rtype = 0;
      Elf_Sxword add = 0;
      ac.get_entry(i, offset, sym_idx, rtype, add);
-     unsigned int reloc_size = 0;
-     bool reloc_inplace = false;
-     bool reloc_subtract = false;
      unsigned int reloc_type = get_reloc_type(rtype);
-     if (target_specific_reloc_handling (machine, offset, sym_idx, rtype, add))
+     if (m_target_relocs && (this->*m_target_relocs)(t, offset, sym_idx, rtype, add))
        continue;
-	   else if (is_none_reloc (machine, reloc_type))
-	    continue;
-	   else if (is_32bit_abs_reloc (machine, reloc_type, prev_warn, tree_builder->e_)
-		   || is_32bit_pcrel_reloc (machine, reloc_type))
-	    reloc_size = 4;
-	   else if (is_64bit_abs_reloc (machine, reloc_type)
-		   || is_64bit_pcrel_reloc (machine, reloc_type))
-	    reloc_size = 8;
-	   else if (is_24bit_abs_reloc (machine, reloc_type))
-	    reloc_size = 3;
-	   else if (is_16bit_abs_reloc (machine, reloc_type, uses_msp430x_relocs))
-	    reloc_size = 2;
-	   else if (is_8bit_abs_reloc (machine, reloc_type)
-		   || is_6bit_abs_reloc (machine, reloc_type))
-	    reloc_size = 1;
-	   else if ((reloc_subtract = is_32bit_inplace_sub_reloc (machine, reloc_type))
-		   || is_32bit_inplace_add_reloc (machine, reloc_type))
-	    {
-	      reloc_size = 4;
-	      reloc_inplace = true;
-	    }
-	  else if ((reloc_subtract = is_64bit_inplace_sub_reloc (machine, reloc_type))
-		   || is_64bit_inplace_add_reloc (machine, reloc_type))
-	    {
-	      reloc_size = 8;
-	      reloc_inplace = true;
-	    }
-	  else if ((reloc_subtract = is_16bit_inplace_sub_reloc (machine, reloc_type))
-		   || is_16bit_inplace_add_reloc (machine, reloc_type))
-	    {
-	      reloc_size = 2;
-	      reloc_inplace = true;
-	    }
-	  else if ((reloc_subtract = is_8bit_inplace_sub_reloc (machine, reloc_type))
-		   || is_8bit_inplace_add_reloc (machine, reloc_type))
-	    {
-	      reloc_size = 1;
-	      reloc_inplace = true;
-	    }
-	  else if ((reloc_subtract = is_6bit_inplace_sub_reloc (machine, reloc_type))
-		   || is_6bit_inplace_add_reloc (machine, reloc_type))
-	    {
-	      reloc_size = 1;
-	      reloc_inplace = true;
-	    }
-	  else
+     reloc_class rc;
+     auto old_warn = prev_warn;
+     size_t n = t.log.size();
+     if ( reloc_type < m_reloc_table.size() )
+     {
+       rc = m_reloc_table[reloc_type];
+       if ( m_no_32bit_relocs && !(rc.flags & RF_NONE) )
+         warn_no_32bit_reloc(machine, prev_warn, &t.log);
+     } else
+       rc = classify_reloc(reloc_type, prev_warn, &t.log);
+     if ( !old_warn && prev_warn && t.log.size() > n )
+       t.warn_msg = n;
+     if ( rc.flags & RF_NONE )
+       continue;
+     if ( !rc.size )
 	    {
 	      if (reloc_type != prev_reloc)
-	        tree_builder->e_->error("unable to apply unsupported reloc idx %d type %d to section %s\n",
-		      reloc_type, i, reader->sections[inf]->get_name().c_str());
-	      prev_reloc = reloc_type;
+	      {
+	        if ( t.reloc_msg == -1 )
+	        {
+	          t.reloc_msg = t.log.size();
+	          t.first_reloc = reloc_type;
+	        }
+	        t.log.error("unable to apply unsupported reloc idx %d type %d to section %s\n",
+		      reloc_type, i, reader->sections[t.inf]->get_name().c_str());
+	      }
+	      prev_reloc = t.last_reloc = reloc_type;
 	      continue;
 	    }
-    const unsigned char *rloc = apply_to->s_ + offset;
-	  if ( !apply_to->in_section(offset, reloc_size) )
+     unsigned int reloc_size = rc.size;
+     bool reloc_inplace = rc.flags & RF_INPLACE;
+     bool reloc_subtract = rc.flags & RF_SUBTRACT;
+    const unsigned char *rloc = t.apply_to->s_ + offset;
+	  if ( !t.apply_to->in_section(offset, reloc_size) )
 	    {
-	      tree_builder->e_->error("skipping invalid relocation offset %lX in section %s\n",
-		      offset, reader->sections[inf]->get_name().c_str());
+	      t.log.error("skipping invalid relocation offset %lX in section %s\n",
+		      offset, reader->sections[t.inf]->get_name().c_str());
 	      continue;
 	    }
 
 	  if (sym_idx >= sym_no)
 	    {
-	      tree_builder->e_->error("skipping invalid relocation symbol index %d in section %s\n",
-		      sym_idx, reader->sections[inf]->get_name().c_str());
+	      t.log.error("skipping invalid relocation symbol index %d in section %s\n",
+		      sym_idx, reader->sections[t.inf]->get_name().c_str());
 	      continue;
 	    }
     if ( m_symbols[sym_idx].type != STT_COMMON &&
          m_symbols[sym_idx].type > STT_SECTION
        )
       {
-        tree_builder->e_->error("skipping unexpected symbol type %d in section %s relocation %d\n",
-          m_symbols[sym_idx].type, reader->sections[inf]->get_name().c_str(), i);
+        t.log.error("skipping unexpected symbol type %d in section %s relocation %d\n",
+          m_symbols[sym_idx].type, reader->sections[t.inf]->get_name().c_str(), i);
         continue;
       }
     uint64_t addend = 0;
-	  if (is_rela)
+	  if (t.is_rela)
 	    addend += add;
 	  /* R_XTENSA_32, R_PJ_DATA_DIR32 and R_D30V_32_NORMAL are
 	     partial_inplace.  */
-	  if (!is_rela
+	  if (!t.is_rela
 	      || (machine == EM_XTENSA && reloc_type == 1)
 	      || ((machine == EM_PJ || machine == EM_PJ_OLD) && reloc_type == 1)
 	      || ((machine == EM_D30V || machine == EM_CYGNUS_D30V) && reloc_type == 12)
 	      || reloc_inplace)
 	    {
-	      if (is_6bit_inplace_sub_reloc (machine, reloc_type))
+	      if (rc.flags & RF_6BIT_SUB)
 	        addend += byte_get (rloc, reloc_size) & 0x3f;
 	      else
 	        addend += byte_get (rloc, reloc_size);
 	    }
-     if (is_32bit_pcrel_reloc (machine, reloc_type)
-	      || is_64bit_pcrel_reloc (machine, reloc_type))
+     if (rc.flags & RF_PCREL)
 	    {
 	      /* On HPPA, all pc-relative relocations are biased by 8.  */
 	      if (machine == EM_PARISC)
 	        addend -= 8;
 	      byte_put (rloc, (addend + m_symbols[sym_idx].addr) - offset, reloc_size);
 	    }
-	  else if (is_6bit_abs_reloc (machine, reloc_type)
-		   || is_6bit_inplace_sub_reloc (machine, reloc_type)
-		   || is_6bit_inplace_add_reloc (machine, reloc_type))
+	  else if (rc.flags & RF_6BIT)
 	    {
 	      if (reloc_subtract)
 	        addend -= m_symbols[sym_idx].addr;
@@ -1299,11 +1400,112 @@ bool ElfFile::apply_debug_relocs(RelS &rmaps, std::list<Elf_Half> &rs) {
 	    byte_put (rloc, addend - m_symbols[sym_idx].addr, reloc_size);
 	  else
 	    byte_put (rloc, addend + m_symbols[sym_idx].addr, reloc_size);
+     t.applied++;
+   }
+}
+
+// apply all reloc sections for rmaps
+// reloc sections for different targets (and chunks of single section when this is safe) are
+// independent so they applied in worker threads. errors are collected in each task and
+// dumped in order of tasks, with repeated errors of adjacent chunks removed - so output is the
+// same as from sequential run
+bool ElfFile::apply_debug_relocs(RelS &rmaps, std::list<Elf_Word> &rs) {
+ if ( m_reloc_table.empty() )
+   fill_reloc_table();
+ // count reloc sections for each target - several sections for the same target must be applied sequentially
+ std::map<Elf_Word, int> targets;
+ for ( auto irs: rs )
+   targets[reader->sections[irs]->get_info()]++;
+ std::list<reloc_task> tasks;
+ // each unit processed by single thread
+ std::vector<std::vector<reloc_task *> > units;
+ std::map<Elf_Word, size_t> target_unit;
+ for ( auto irs: rs )
+ {
+   section *cr = reader->sections[irs];
+   Elf_Word inf = cr->get_info();
+   auto si = rmaps.find(inf);
+   if ( si == rmaps.end() ) continue;
+   bool is_rela = cr->get_type() == SHT_RELA;
+   if ( g_opt_m ) {
+     cr->set_type(SHT_RELA);
+     is_rela = true;
+   } else if ( machine == EM_SH ) is_rela = false;
+   relocation_section_accessor ac(*reader, cr);
+   int num = ac.get_entries_num();
+   if ( g_opt_d )
+     printf("reloc section %d %s has %d entries, dest %d (%s)\n", irs, cr->get_name().c_str(),
+       num, inf, reader->sections[inf]->get_name().c_str());
+   bool split = targets[inf] == 1 && num > 2 * reloc_chunk_size && can_split_relocs(is_rela);
+   for ( int from = 0; from < num || !from; from += reloc_chunk_size )
+   {
+     tasks.emplace_back();
+     auto &t = tasks.back();
+     t.rs = cr;
+     t.apply_to = si->second;
+     t.inf = inf;
+     t.is_rela = is_rela;
+     t.from = from;
+     t.to = split ? std::min(num, from + reloc_chunk_size) : num;
+     auto ui = target_unit.find(inf);
+     if ( split || ui == target_unit.end() )
+     {
+       target_unit[inf] = units.size();
+       units.push_back( { &t } );
+     } else
+       units[ui->second].push_back(&t);
+     if ( !split ) break;
    }
-   apply_to = nullptr;
-   reset_target_specific_reloc();
  }
- return res;
+ if ( tasks.empty() ) return false;
+ std::atomic<size_t> next_unit(0);
+ auto worker = [&]() {
+   for ( size_t u; (u = next_unit++) < units.size(); )
+     for ( auto t: units[u] ) apply_relocs(*t);
+ };
+ size_t nt = std::min(units.size(), (size_t)std::thread::hardware_concurrency());
+ if ( nt > 1 )
+ {
+   std::vector<std::thread> threads;
+   for ( size_t i = 1; i < nt; i++ )
+     threads.emplace_back(worker);
+   worker();
+   for ( auto &th: threads )
+     th.join();
+ } else
+   worker();
+ if ( g_timings )
+   time_reloc_classify(tasks);
+ size_t applied = 0;
+ unsigned int prev_reloc = 0;
+ bool prev_warn = false;
+ for ( auto &t: tasks )
+ {
+   // first chunk of section starts with clean state like in apply_relocs
+   if ( !t.from )
+   {
+     prev_reloc = 0;
+     prev_warn = false;
+   }
+   bool skip_reloc = t.reloc_msg != -1 && t.first_reloc == prev_reloc,
+     skip_warn = t.warn_msg != -1 && prev_warn;
+   // erase bigger index first
+   if ( skip_reloc && t.reloc_msg > t.warn_msg )
+     t.log.erase(t.reloc_msg);
+   if ( skip_warn )
+     t.log.erase(t.warn_msg);
+   if ( skip_reloc && t.reloc_msg < t.warn_msg )
+     t.log.erase(t.reloc_msg);
+   if ( t.last_reloc )
+     prev_reloc = t.last_reloc;
+   if ( t.warn_msg != -1 )
+     prev_warn = true;
+   t.log.flush(tree_builder->e_);
+   applied += t.applied;
+ }
+ if ( g_opt_v )
+   printf("applied %ld relocs in %ld tasks, %ld threads\n", applied, tasks.size(), nt);
+ return true;
 }
 
 bool ElfFile::try_apply_debug_relocs()
@@ -1332,10 +1534,10 @@ bool ElfFile::try_apply_debug_relocs()
    rmaps[debug_line_str_.idx] = &debug_line_str_;
  if ( rmaps.empty() ) return true;
  // ok, enum reloc sections
- std::list<Elf_Half> rs;
- Elf_Half n = reader->sections.size();
+ std::list<Elf_Word> rs;
+ Elf_Word n = reader->sections.size();
  section *sym_sec = nullptr;
- for ( Elf_Half i = 0; i < n; i++) {
+ for ( Elf_Word i = 0; i < n; i++) {
    section *s = reader->sections[i];
    bool is_rel = false;
    if ( g_opt_m ) { // cuda mercury has custom attributes in section type
@@ -1,6 +1,9 @@
 #pragma once
 #include <stdio.h>
 #include <stdarg.h>
+#include <string>
+#include <vector>
+#include <mutex>
 
 class ErrLog
 {
@@ -35,4 +38,84 @@ class FLog: public ErrLog
    }
   protected:
    FILE *m_fp;
-};
\ No newline at end of file
+};
+
+// collects messages to replay them later in fixed order - for example from worker threads
+class BufLog: public ErrLog
+{
+  public:
+   virtual void error(const char *fmt, ...)
+   {
+     va_list argp;
+     va_start(argp, fmt);
+     add(true, fmt, argp);
+     va_end(argp);
+   }
+   virtual void warning(const char *fmt, ...)
+   {
+     va_list argp;
+     va_start(argp, fmt);
+     add(false, fmt, argp);
+     va_end(argp);
+   }
+   void flush(ErrLog *e)
+   {
+     for ( auto &m: m_msgs )
+       if ( m.first )
+         e->error("%s", m.second.c_str());
+       else
+         e->warning("%s", m.second.c_str());
+     m_msgs.clear();
+   }
+   inline size_t size() const
+   {
+     return m_msgs.size();
+   }
+   void erase(size_t idx)
+   {
+     if ( idx < m_msgs.size() )
+       m_msgs.erase(m_msgs.begin() + idx);
+   }
+  protected:
+   void add(bool is_err, const char *fmt, va_list argp)
+   {
+     va_list copy;
+     va_copy(copy, argp);
+     int len = vsnprintf(NULL, 0, fmt, copy);
+     va_end(copy);
+     if ( len < 0 ) return;
+     std::string str(len + 1, 0);
+     vsnprintf(&str[0], len + 1, fmt, argp);
+     str.resize(len);
+     m_msgs.push_back( { is_err, std::move(str) } );
+   }
+   std::vector<std::pair<bool, std::string> > m_msgs;
+};
+
+// passes messages from several threads to other log one by one
+class SyncLog: public BufLog
+{
+  public:
+   SyncLog(ErrLog *e): m_e(e) {};
+   virtual void error(const char *fmt, ...)
+   {
+     va_list argp;
+     va_start(argp, fmt);
+     std::lock_guard<std::mutex> l(m_lock);
+     add(true, fmt, argp);
+     va_end(argp);
+     flush(m_e);
+   }
+   virtual void warning(const char *fmt, ...)
+   {
+     va_list argp;
+     va_start(argp, fmt);
+     std::lock_guard<std::mutex> l(m_lock);
+     add(false, fmt, argp);
+     va_end(argp);
+     flush(m_e);
+   }
+  protected:
+   ErrLog *m_e;
+   std::mutex m_lock;
+};
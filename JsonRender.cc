@@ -1,121 +1,306 @@
+#include <type_traits>
 #include "JsonRender.h"
 
-// static
-std::string JsonRender::EscapeJsonString(const char* str) {
-  std::string result;
-  size_t str_len = std::char_traits<char>::length(str); 
+// short keys for compact mode
+static const std::pair<const char *, const char *> s_short_keys[] = {
+ { "type", "t" },
+ { "type_id", "ti" },
+ { "name", "n" },
+ { "level", "lv" },
+ { "access", "ac" },
+ { "bit_offset", "bo" },
+ { "bit_size", "bs" },
+ { "addr_class", "acl" },
+ { "offset", "o" },
+ { "dumped", "du" },
+ { "go_kind", "gk" },
+ { "go_key", "gy" },
+ { "go_elem", "ge" },
+ { "go_rt_type", "gr" },
+ { "go_index", "gi" },
+ { "ate", "at" },
+ { "file", "f" },
+ { "cont_type", "ct" },
+ { "owner", "ow" },
+ { "noreturn", "nr" },
+ { "alignment", "al" },
+ { "link_name", "ln" },
+ { "spec", "sp" },
+ { "abs", "ab" },
+ { "size", "sz" },
+ { "addr", "a" },
+ { "section", "sc" },
+ { "frame_size", "fs" },
+ { "addr_ranges", "ar" },
+ { "start", "s" },
+ { "end", "e" },
+ { "inline", "il" },
+ { "const_expr", "ce" },
+ { "enum_class", "ec" },
+ { "gnu_vector", "gv" },
+ { "tensor", "tn" },
+ { "tls_index", "tl" },
+ { "loc_list", "ll" },
+ { "loc", "lc" },
+ { "op", "op" },
+ { "reg", "r" },
+ { "reg_name", "rn" },
+ { "value", "v" },
+ { "idx", "ix" },
+ { "vtbl_index", "vi" },
+ { "virt", "vt" },
+ { "this_arg", "th" },
+ { "default", "df" },
+ { "explicit", "ex" },
+ { "ref_", "rf" },
+ { "rval_ref_", "rr" },
+ { "count", "c" },
+ { "parents", "P" },
+ { "id", "i" },
+ { "virtual", "vr" },
+ { "params", "p" },
+ { "variable", "va" },
+ { "pdir", "pd" },
+ { "optinal", "oi" },
+ { "ellipsis", "el" },
+ { "enums", "E" },
+ { "members", "M" },
+ { "lvars", "L" },
+ { "methods", "m" },
+};
 
-  for (size_t i = 0; i < str_len; i++) {
-    if (str[i] == '\\' || str[i] == '"') {
-      result += '\\';
-    }
+static const char *short_key(const char *name)
+{
+  static std::unordered_map<std::string_view, const char *> s_map;
+  if ( s_map.empty() )
+    for ( auto &k: s_short_keys )
+      s_map[k.first] = k.second;
+  auto ki = s_map.find(name);
+  if ( ki == s_map.end() )
+    return name;
+  return ki->second;
+}
+
+JsonWriter &JsonRender::key(const char *name)
+{
+  return m_w.key(m_mode == jm_compact ? short_key(name) : name);
+}
+
+uint32_t JsonRender::str_idx(const char *s)
+{
+  auto si = m_strs.find(s);
+  if ( si != m_strs.end() )
+    return si->second;
+  uint32_t res = m_str_list.size();
+  auto ins = m_strs.emplace(s, res);
+  m_str_list.push_back(&ins.first->first);
+  return res;
+}
+
+void JsonRender::begin_output()
+{
+  if ( m_mode == jm_ndjson )
+    return;
+  if ( m_mode == jm_compact )
+    g_sink->put("{\"v\":1,\"e\":{\n");
+  else
+    g_sink->put('{');
+}
 
-    result += str[i];
+// in compact mode string table and dictionary of keys are written after all elements
+void JsonRender::end_output()
+{
+  if ( m_mode == jm_ndjson )
+    return;
+  if ( m_mode != jm_compact )
+  {
+    g_sink->put("}\n");
+    return;
   }
+  JsonWriter w(g_sink);
+  g_sink->put("},\n\"s\":");
+  w.begin_arr();
+  for ( auto s: m_str_list )
+    w.str(s->c_str());
+  w.end_arr();
+  g_sink->put(",\n\"k\":");
+  w.reset();
+  w.begin_obj();
+  for ( auto &k: s_short_keys )
+    w.key(k.second).str(k.first);
+  w.end_obj();
+  g_sink->put("}\n");
+}
 
-  return result;
+bool JsonRender::need_render(const Element &e) const
+{
+  if ( e.type_ == ElementType::ns_end || e.type_ == ElementType::lexical_block )
+    return false;
+  if ( e.type_ == ElementType::var_type )
+  {
+    if ( e.dumped_ )
+      return false;
+    if ( !e.addr_ && m_tls.find(e.id_) == m_tls.end() )
+      return false;
+  }
+  return true;
 }
 
+// elements are streamed directly to g_sink, separator is written before each element
+// so there is no need to cut final comma of last unit
 void JsonRender::RenderUnit(int last)
 {
-  auto json = GenerateJson();
-  // if this was last unit - cut final comma
-  if ( last && !json.empty() )
+  m_w.set_sink(g_sink);
+  if ( m_mode == jm_ndjson )
+  {
+    render_ndjson();
+    return;
+  }
+  for ( auto &e: elements_ )
   {
-    json.pop_back();
-    json.pop_back();
+    if ( !need_render(e) )
+      continue;
+    // comments from -v are not allowed in compact output
+    if ( m_mode != jm_compact )
+      put_file_hdr();
+    if ( m_has_items )
+      g_sink->put(",\n", 2);
+    m_has_items = true;
+    m_w.reset();
+    GenerateJson(e);
   }
-  if ( !json.empty() )
+}
+
+void JsonRender::unit_context(std::string &res)
+{
+  OutSink ctx;
+  JsonWriter w(&ctx);
+  w.begin_obj();
+  if ( cu.cu_name )
+    w.key("name").str(cu.cu_name);
+  if ( cu.cu_comp_dir )
+    w.key("comp_dir").str(cu.cu_comp_dir);
+  if ( cu.cu_producer )
+    w.key("producer").str(cu.cu_producer);
+  if ( cu.cu_package )
+    w.key("package").str(cu.cu_package);
+  if ( cu.cu_lang )
   {
-    put_file_hdr();
-    fprintf(g_outf, "%s", json.c_str());
+    auto lang = get_cu_name(cu.cu_lang);
+    if ( lang )
+      w.key("lang").str(lang);
+    else
+      w.key("lang").num(cu.cu_lang);
   }
+  w.end_obj();
+  res = ctx.data();
 }
 
-std::string JsonRender::GenerateJson() {
-  std::string result;
-  if ( elements_.empty() )
-    return result;
-  for ( auto &e: elements_ ) {
-    if ( e.type_ == ElementType::var_type && !e.addr_ )
+void JsonRender::render_ndjson()
+{
+  std::string ctx, ns_name;
+  std::vector<const char *> ns;
+  bool ns_dirty = false;
+  for ( auto &e: elements_ )
+  {
+    // namespaces are not records, only context for nested elements
+    if ( e.type_ == ElementType::ns_start )
     {
-      auto ti = m_tls.find(e.id_);
-      if ( ti == m_tls.end() )
-        continue;
+      ns.push_back(e.name_ ? e.name_ : "(anonymous)");
+      ns_dirty = true;
+      continue;
+    }
+    if ( e.type_ == ElementType::ns_end )
+    {
+      if ( !ns.empty() ) ns.pop_back();
+      ns_dirty = true;
+      continue;
     }
-    if ( e.type_ == ElementType::var_type && e.dumped_ ) continue;
-    auto jres = GenerateJson(e);
-    if ( !jres.empty() )
+    if ( !need_render(e) )
+      continue;
+    if ( ctx.empty() )
+      unit_context(ctx);
+    if ( ns_dirty )
     {
-      result += jres;
-      result += ",\n";
+      ns_name.clear();
+      for ( auto n: ns )
+      {
+        if ( !ns_name.empty() ) ns_name += "::";
+        ns_name += n;
+      }
+      ns_dirty = false;
     }
+    const char *kind = "type";
+    if ( e.type_ == ElementType::subroutine || e.type_ == ElementType::method )
+      kind = "function";
+    else if ( e.type_ == ElementType::var_type )
+      kind = "var";
+    m_w.reset();
+    m_w.begin_obj();
+    key("unit").raw(ctx.c_str());
+    if ( !ns_name.empty() )
+      key("ns").str(ns_name.c_str());
+    key("kind").str(kind);
+    key("id").unum(e.id_);
+    key("element");
+    GenerateBody(e);
+    m_w.end_obj();
+    g_sink->put('\n');
   }
-  return result;
 }
 
+// numbers are quoted
 template <class T>
-std::string &JsonRender::put(std::string &res, const char *name, T v)
+void JsonRender::put(const char *name, T v)
 {
-  res += "\"";
-  res += name;
-  res += "\":\""+std::to_string(v);
-  res += "\",";
-  return res;
+  key(name);
+  if ( m_mode == jm_compact )
+  {
+    if constexpr ( std::is_signed<T>::value )
+      m_w.num(v);
+    else
+      m_w.unum(v);
+    return;
+  }
+  if constexpr ( std::is_signed<T>::value )
+    m_w.qnum(v);
+  else
+    m_w.qunum(v);
 }
 
 template <>
-std::string &JsonRender::put(std::string &res, const char *name, const char *v)
+void JsonRender::put(const char *name, const char *v)
 {
-  res += "\"";
-  res += name;
-  res += "\":\""+EscapeJsonString(v);
-  res += "\",";
-  return res;
+  if ( m_mode == jm_compact )
+    key(name).unum(str_idx(v ? v : "(null)"));
+  else
+    key(name).str(v);
 }
 
 template <>
-std::string &JsonRender::put(std::string &res, const char *name, bool v)
+void JsonRender::put(const char *name, bool v)
 {
-  res += "\"";
-  res += name;
-  res += "\":\"1\",";
-  return res;
+  key(name).raw(m_mode == jm_compact ? "1" : "\"1\"");
 }
 
 template <>
-std::string &JsonRender::put(std::string &res, const char *name, const void *v)
+void JsonRender::put(const char *name, const void *v)
 {
   char buf[32];
   snprintf(buf, sizeof(buf), "0x%p", v);
-  res += "\"";
-  res += name;
-  res += "\":\"";
-  res += buf;
-  res += "\",";
-  return res;
-}
-
-inline void cut_last_comma(std::string &result) {
-    if (result.back() == '\n')
-      result.pop_back();
-    if (result.back() == ',')
-      result.pop_back();
+  key(name).str(buf);
 }
 
-void JsonRender::render_location(std::string &s, param_loc &pl)
+void JsonRender::render_location(const param_loc &pl)
 {
-  int idx = 0;
-  s += "\"loc\":[";
+  key("loc").begin_arr();
   for ( auto &l: pl.locs )
   {
-    if ( idx ) s.push_back(',');
-    idx++;
-    s.push_back('{');
+    m_w.begin_obj();
     auto op_name = locs_no_ops(l.type);
     if ( op_name ) {
-      put(s, "op", op_name);
-      s.push_back('}');
+      put("op", op_name);
+      m_w.end_obj();
       continue;
     }
     const char *reg_name = nullptr;
@@ -123,397 +308,366 @@ void JsonRender::render_location(std::string &s, param_loc &pl)
     {
       case regval_type:
         // op
-        put(s, "op", "OP_breg");
+        put("op", "OP_breg");
         // reg idx
-        put(s, "reg", l.idx);
+        put("reg", l.idx);
         if ( m_rnames )
           reg_name = m_rnames->reg_name(l.idx);
         if ( reg_name )
-          put(s, "reg_name", reg_name);
+          put("reg_name", reg_name);
         // offset
         if ( l.offset )
-          put(s, "offset", l.offset);
+          put("offset", l.offset);
        break;
       case reg:
-        put(s, "op", "OP_reg");
+        put("op", "OP_reg");
         // reg idx
-        put(s, "reg", l.idx);
+        put("reg", l.idx);
         if ( m_rnames )
           reg_name = m_rnames->reg_name(l.idx);
         if ( reg_name )
-          put(s, "reg_name", reg_name);
+          put("reg_name", reg_name);
        break;
       case breg:
-        put(s, "op", "OP_breg");
+        put("op", "OP_breg");
         // reg idx
-        put(s, "reg", l.idx);
+        put("reg", l.idx);
         if ( m_rnames )
           reg_name = m_rnames->reg_name(l.idx);
         if ( reg_name )
-          put(s, "reg_name", reg_name);
+          put("reg_name", reg_name);
         // offset
         if ( l.offset )
-          put(s, "offset", l.offset);
+          put("offset", l.offset);
        break;
       case fpiece:
-        put(s, "op", "piece");
-        put(s, "value", l.idx);
+        put("op", "piece");
+        put("value", l.idx);
        break;
       case imp_value:
-        put(s, "op", "implicit_value");
-        put(s, "value", l.idx);
+        put("op", "implicit_value");
+        put("value", l.idx);
        break;
       case svalue:
-        put(s, "op", "svalue");
-        put(s, "value", l.sv);
+        put("op", "svalue");
+        put("value", l.sv);
        break;
       case fvalue:
-        put(s, "op", "fvalue");
-        put(s, "value", l.sv);
+        put("op", "fvalue");
+        put("value", l.sv);
        break;
       case uvalue:
-        put(s, "op", "uvalue");
-        put(s, "value", l.conv);
+        put("op", "uvalue");
+        put("value", l.conv);
        break;
       case deref_type:
-        put(s, "op", "deref_type");
-        put(s, "size", l.offset);
+        put("op", "deref_type");
+        put("size", l.offset);
         if ( l.conv )
-          put(s, "value", l.conv);
+          put("value", l.conv);
        break;
       case convert:
-        put(s, "op", "convert");
-        put(s, "idx", l.conv);
+        put("op", "convert");
+        put("idx", l.conv);
        break;
       case deref_size:
-        put(s, "op", "deref_size");
-        put(s, "size", l.idx);
+        put("op", "deref_size");
+        put("size", l.idx);
        break;
       case fbreg:
-        put(s, "op", "fbreg");
-        put(s, "value", l.offset);
+        put("op", "fbreg");
+        put("value", l.offset);
        break;
       case plus_uconst:
-        put(s, "op", "plus_uconst");
-        put(s, "value", l.offset);
+        put("op", "plus_uconst");
+        put("value", l.offset);
        break;
       case tls_index:
-        put(s, "op", "TlsIndex");
-        put(s, "value", l.offset);
+        put("op", "TlsIndex");
+        put("value", l.offset);
        break;
       default: e_->error("unknown location op %d\n", l.type);
     }
-    cut_last_comma(s);
-    s.push_back('}');
+    m_w.end_obj();
   }
-  s += ']';
+  m_w.end_arr();
 }
 
-void JsonRender::RenderGoAttrs(std::string &res, uint64_t id)
+void JsonRender::RenderGoAttrs(uint64_t id)
 {
   auto giter = m_go_attrs.find(id);
   if ( giter == m_go_attrs.end() )
     return;
   auto &g = giter->second;
   if ( g.kind )
-    put(res, "go_kind", g.kind);
+    put("go_kind", g.kind);
   if ( g.key )
-    put(res, "go_key", g.key);
+    put("go_key", g.key);
   if ( g.elem )
-    put(res, "go_elem", g.elem);
+    put("go_elem", g.elem);
   if ( g.rt_type )
-    put(res, "go_rt_type", g.rt_type);
+    put("go_rt_type", g.rt_type);
   if ( g.dict_index )
-    put(res, "go_index", g.dict_index);
+    put("go_index", g.dict_index);
 }
 
-std::string JsonRender::GenerateJson(Element &e) {
-  std::string result;
+void JsonRender::GenerateJson(Element &e) {
+  if ( e.type_ != ElementType::member )
+    m_w.ukey(e.id_);
+  GenerateBody(e);
+}
 
-  if (e.type_ == ElementType::ns_end)
-    return "";
-  if ( ElementType::lexical_block == e.type_ ) return "";
+void JsonRender::GenerateBody(Element &e) {
   // A member is a special case
   if (e.type_ == ElementType::member) {
-    result = "{";
-
+    m_w.begin_obj();
     if (e.type_id_)
-      put(result, "type_id", get_replaced_type(e.type_id_));
+      put("type_id", get_replaced_type(e.type_id_));
     if (e.name_)
-      put(result, "name", e.name_);
+      put("name", e.name_);
     if ( e.level_ && g_opt_l )
-      put(result, "level", e.level_);
+      put("level", e.level_);
     if ( e.access_ )
-      put(result, "access", e.access_);
+      put("access", e.access_);
     if ( e.bit_size_ )
     {
-      put(result, "bit_offset", e.bit_offset_);
-      put(result, "bit_size", e.bit_size_);
+      put("bit_offset", e.bit_offset_);
+      put("bit_size", e.bit_size_);
     }
     if ( e.addr_class_ )
-      put(result, "addr_class", e.addr_class_);
+      put("addr_class", e.addr_class_);
     if ( e.has_go )
-      RenderGoAttrs(result, e.type_id_);
-    result += "\"offset\":"+std::to_string(e.offset_);
-    result += "}";
-    return result;
+      RenderGoAttrs(e.type_id_);
+    key("offset").unum(e.offset_);
+    m_w.end_obj();
+    return;
   }
 
   // The others are generic
-  result += "\""+std::to_string(e.id_)+"\":{";
-  put(result, "type", e.TypeName());
+  m_w.begin_obj();
+  put("type", e.TypeName());
   if ( e.dumped_ )
-    put(result, "dumped", e.dumped_);
+    put("dumped", e.dumped_);
   if ( e.has_go )
-    RenderGoAttrs(result, e.type_id_);
+    RenderGoAttrs(e.type_id_);
   if ( e.ate_ )
-    put(result, "ate", e.ate_);
-  if ( !e.fullname_.empty() )
-    put(result, "file", e.fullname_.c_str());
-  if ( e.type_ == ElementType::ptr2member && e.cont_type_ )
-    put(result, "cont_type", e.cont_type_);
+    put("ate", e.ate_);
+  auto fname = e.get_fullname();
+  if ( fname )
+    put("file", fname->c_str());
+  if ( e.type_ == ElementType::ptr2member && e.get_cont_type() )
+    put("cont_type", e.get_cont_type());
   if ( e.owner_ != nullptr )
-    put(result, "owner", e.owner_->id_);
+    put("owner", e.owner_->id_);
   if ( e.noret_ )
-    put(result, "noreturn", e.noret_);
+    put("noreturn", e.noret_);
   if ( e.align_ )
-    put(result, "alignment", e.align_);
+    put("alignment", e.align_);
   if ( e.addr_class_ )
-    put(result, "addr_class", e.addr_class_);
+    put("addr_class", e.addr_class_);
   if (e.type_id_)
-    put(result, "type_id", e.type_id_);
+    put("type_id", e.type_id_);
   if (e.name_) {
-      if (e.type_ == ElementType::ns_start) {
-        result += "\"name\":\""+EscapeJsonString(e.name_)+"\"}";
-        return result;
-      }
-    put(result, "name", e.name_);
+    put("name", e.name_);
+    if (e.type_ == ElementType::ns_start) {
+      m_w.end_obj();
+      return;
+    }
   }
   if ( e.link_name_ && e.link_name_ != e.name_ )
-    put(result, "link_name", e.link_name_);
+    put("link_name", e.link_name_);
   if (e.spec_)
-    put(result, "spec", e.spec_);
-  if ( e.abs_ )
-    put(result, "abs", e.abs_);
+    put("spec", e.spec_);
+  if ( e.get_abs() )
+    put("abs", e.get_abs());
   if (e.size_)
-    put(result, "size", e.size_);
+    put("size", e.size_);
   if ( e.addr_ )
   {
-    put(result, "addr", e.addr_);
+    put("addr", e.addr_);
     if ( g_opt_s && m_snames != nullptr )
     {
       std::string sname;
       if ( m_snames->find_sname(e.addr_, sname) )
-        put(result, "section", sname.c_str());
+        put("section", sname.c_str());
     }
     // frame size
     if ( e.type_ == ElementType::subroutine && m_locX )
     {
       uint64_t fsize = 0;
       if ( m_locX->find_dfa(e.addr_, fsize) )
-        put(result, "frame_size", fsize);
+        put("frame_size", fsize);
     }
   } else if ( e.has_range_ )
   {
     std::list<std::pair<uint64_t, uint64_t> > ranges;
     if ( lookup_range(e.id_, ranges) )
     {
-      result += "\"addr_ranges\":[";
+      key("addr_ranges").begin_arr();
       for ( auto &r: ranges ) {
-        result += "{";
-        put(result, "start", r.first);
-        put(result, "end", r.second);
+        m_w.begin_obj();
+        put("start", r.first);
+        put("end", r.second);
         if ( g_opt_s && m_snames != nullptr )
         {
           std::string sname;
           if ( m_snames->find_sname(r.first, sname) )
-            put(result, "section", sname.c_str());
+            put("section", sname.c_str());
         }
-        result += "},";
+        m_w.end_obj();
       }
-      if (result.back() == ',')
-        result.pop_back();
-      result += "],";
+      m_w.end_arr();
       // try get frame size for any range
       if ( m_locX) for ( auto &r: ranges ) {
         uint64_t fsize = 0;
         if ( m_locX->find_dfa(r.first, fsize) ) {
-          put(result, "frame_size", fsize);
+          put("frame_size", fsize);
           break;
         }
       }
     }
   }
   if ( e.inlined_ )
-    put(result, "inline", e.inlined_);
+    put("inline", e.inlined_);
   if ( e.const_expr_ )
-    put(result, "const_expr", e.const_expr_);
+    put("const_expr", e.const_expr_);
   if ( e.enum_class_ )
-    put(result, "enum_class", e.enum_class_);
+    put("enum_class", e.enum_class_);
   if ( e.gnu_vector_ )
-    put(result, "gnu_vector", e.gnu_vector_);
+    put("gnu_vector", e.gnu_vector_);
   if ( e.tensor_ )
-    put(result, "tensor", e.tensor_);
+    put("tensor", e.tensor_);
   if ( e.addr_class_ )
-      put(result, "addr_class", e.addr_class_);
+      put("addr_class", e.addr_class_);
   if ( e.type_ == ElementType::var_type )
   {
     if ( g_opt_l )
-      put(result, "level", e.level_);
+      put("level", e.level_);
     auto ti = m_tls.find(e.id_);
     if ( ti != m_tls.end() )
-      put(result, "tls_index", ti->second);
+      put("tls_index", ti->second);
     if ( e.has_locx && m_locX )
     {
-      std::list<LocListXItem> locs;
-      if ( m_locX->get_loclistx(e.locx_, locs, cu.cu_base_addr) )
+      auto locs = m_locX->get_cached_loclistx(e.get_locx(), cu.cu_base_addr);
+      if ( locs )
       {
         // dump list of locations
-        result += "\"loc_list\":[";
-        for ( auto &l: locs )
+        key("loc_list").begin_arr();
+        for ( auto &l: *locs )
         {
-          std::string loc;
-          render_location(loc, l.loc);
-          if ( !loc.empty() )
-          {
-            result += "{";
-            put(result, "start", l.start);
-            put(result, "end", l.end);
-            result += loc;
-            cut_last_comma(result);
-            result += "},";
-          }
+          m_w.begin_obj();
+          put("start", l.start);
+          put("end", l.end);
+          render_location(l.loc);
+          m_w.end_obj();
         }
-        cut_last_comma(result);
-        result += "],";
+        m_w.end_arr();
       }
     } else if ( e.owner_ && e.owner_->m_comp ) {
-      auto liter = e.owner_->m_comp->lvar_locs_.find(&e);
-      if ( liter != e.owner_->m_comp->lvar_locs_.end() )
-      {
-        std::string loc;
-        render_location(loc, liter->second);
-        if ( !loc.empty() ) result += loc;
-      }
+      auto lloc = e.owner_->m_comp->find_lvar_loc(&e);
+      if ( lloc )
+        render_location(*lloc);
     }
   }
   if ( e.type_ == ElementType::method )
   {
     if ( g_opt_l )
-      put(result, "level", e.level_);
+      put("level", e.level_);
     Method &m = static_cast<Method &>(e);
     if ( m.vtbl_index_ )
-      put(result, "vtbl_index", m.vtbl_index_);
+      put("vtbl_index", m.vtbl_index_);
     if ( m.virt_ )
-      put(result, "virt", m.virt_);
+      put("virt", m.virt_);
     if ( m.this_arg_ )
-      put(result, "this_arg", m.this_arg_);
+      put("this_arg", m.this_arg_);
     if ( m.def_ )
-      put(result, "default", m.def_);
+      put("default", m.def_);
     if ( m.expl_ )
-      put(result, "explicit", m.expl_);
+      put("explicit", m.expl_);
     if ( m.ref_ )
-      put(result, "ref_", m.ref_ );
+      put("ref_", m.ref_ );
     if ( m.rval_ref_ )
-      put(result, "rval_ref_", m.rval_ref_);
+      put("rval_ref_", m.rval_ref_);
   }
   if (e.count_)
-    put(result, "count", e.count_);
+    put("count", e.count_);
   // parents
   if ( e.m_comp && !e.m_comp->parents_.empty() ) {
-    result += "\"parents\":[";
-    for (size_t i = 0; i < e.m_comp->parents_.size(); i++) {
-      result += "{\"id\":\""+std::to_string(get_replaced_type(e.m_comp->parents_[i].id))+"\",";
-      if ( e.m_comp->parents_[i].virtual_ )
-        put(result, "virtual", e.m_comp->parents_[i].virtual_);
-      if ( e.m_comp->parents_[i].access )
-        put(result, "access", e.m_comp->parents_[i].access);
-      result += "\"offset\":"+std::to_string(e.m_comp->parents_[i].offset)+"}";
-      if (i+1 < e.m_comp->parents_.size()) {
-        result += ",";
-      }
+    key("parents").begin_arr();
+    for ( auto &p: e.m_comp->parents_ ) {
+      m_w.begin_obj();
+      if ( m_mode == jm_compact )
+        key("id").unum(get_replaced_type(p.id));
+      else
+        key("id").qunum(get_replaced_type(p.id));
+      if ( p.virtual_ )
+        put("virtual", p.virtual_);
+      if ( p.access )
+        put("access", p.access);
+      key("offset").unum(p.offset);
+      m_w.end_obj();
     }
-    result += "],";
+    m_w.end_arr();
   }
   if ( e.m_comp && !e.m_comp->params_.empty() )
   {
-    result += "\"params\":[";
-    for (size_t i = 0; i < e.m_comp->params_.size(); i++) {
-      result += "{";
-      if ( e.m_comp->params_[i].name )
-        put(result, "name", e.m_comp->params_[i].name);
-      if ( e.m_comp->params_[i].param_id )
-        put(result, "id", e.m_comp->params_[i].param_id);
-      if ( e.m_comp->params_[i].var_ )
-        put(result, "variable", e.m_comp->params_[i].var_);
-      if ( e.m_comp->params_[i].pdir )
-        put(result, "pdir", e.m_comp->params_[i].pdir);
-      if ( e.m_comp->params_[i].optional_ )
-        put(result, "optinal", e.m_comp->params_[i].optional_);
-      if (e.m_comp->params_[i].ellipsis)
+    key("params").begin_arr();
+    for ( auto &p: e.m_comp->params_ ) {
+      m_w.begin_obj();
+      if ( p.name )
+        put("name", p.name);
+      if ( p.param_id )
+        put("id", p.param_id);
+      if ( p.var_ )
+        put("variable", p.var_);
+      if ( p.pdir )
+        put("pdir", p.pdir);
+      if ( p.optional_ )
+        put("optinal", p.optional_);
+      if ( p.ellipsis )
       {
-        put(result, "ellipsis", e.m_comp->params_[i].ellipsis);
+        put("ellipsis", p.ellipsis);
       } else {
-        if ( e.m_comp->params_[i].id )
-          put(result, "type_id", e.m_comp->params_[i].id);
-      }
-      if ( !e.m_comp->params_[i].loc.empty() )
-      {
-        std::string ploc;
-        render_location(ploc, e.m_comp->params_[i].loc);
-        if ( !ploc.empty() ) result += ploc;
-      }
-      if (result.back() == ',')
-        result.pop_back();
-      result += "}";
-      if (i+1 < e.m_comp->params_.size()) {
-        result += ",";
+        if ( p.id )
+          put("type_id", p.id);
       }
+      if ( !p.loc.empty() )
+        render_location(p.loc);
+      m_w.end_obj();
     }
-    result += "],";
+    m_w.end_arr();
   }
   if ( e.m_comp && !e.m_comp->enums_.empty() )
   {
-    result += "\"enums\":[";
-    for (size_t i = 0; i < e.m_comp->enums_.size(); i++) {
-      put(result, "name", e.m_comp->enums_[i].name);
-      result += "\"value\":"+std::to_string(e.m_comp->enums_[i].value)+"}";
-      if (i+1 < e.m_comp->enums_.size()) {
-        result += ",";
-      }
+    key("enums").begin_arr();
+    for ( auto &en: e.m_comp->enums_ ) {
+      m_w.begin_obj();
+      put("name", en.name);
+      key("value").unum(en.value);
+      m_w.end_obj();
     }
-    result += "],";
+    m_w.end_arr();
   }
   if ( e.m_comp && !e.m_comp->members_.empty() ) {
-    result += "\"members\":[";
-    for (size_t i = 0; i < e.m_comp->members_.size(); i++) {
-      result += GenerateJson(e.m_comp->members_[i]);
-      if (i+1 < e.m_comp->members_.size()) {
-        result += ",";
-      }
-    }
-    result += "],";
+    key("members").begin_arr();
+    for ( auto &m: e.m_comp->members_ )
+      GenerateJson(m);
+    m_w.end_arr();
   }
   if ( e.m_comp && !e.m_comp->lvars_.empty() ) {
-    result += "\"lvars\":[";
+    key("lvars").begin_arr(",\n");
     for ( auto m: e.m_comp->lvars_ )
     {
-      result += GenerateJson(*m) + ",\n";
+      GenerateJson(*m);
       m->dumped_ = 1;
     }
-    cut_last_comma(result);
-    result += "],";
+    m_w.end_arr();
   }
   if ( e.m_comp && !e.m_comp->methods_.empty() ) {
-    result += "\"methods\":[";
+    key("methods").begin_arr(",\n");
     for ( auto &m: e.m_comp->methods_ )
-      result += GenerateJson(m) + ",\n";
-    cut_last_comma(result);
-    result += "],";
+      GenerateJson(m);
+    m_w.end_arr();
   }
-  if (result.back() == ',') {
-    result.pop_back();
-  }
-  result += "}";
-  return result;
-}
\ No newline at end of file
+  m_w.end_obj();
+}
@@ -1,18 +1,40 @@
 #pragma once
 #include "TreeBuilder.h"
+#include "JsonWriter.h"
+
+enum json_mode {
+  jm_plain = 0,
+  jm_ndjson,
+  // numbers are json numbers, keys are short and strings are indexes in table at end of output
+  jm_compact,
+};
 
 class JsonRender: public TreeBuilder
 {
   public:
-    JsonRender(ErrLog *e): TreeBuilder(e)
+    JsonRender(ErrLog *e, json_mode m = jm_plain): TreeBuilder(e), m_w(nullptr), m_mode(m)
     { }
-    std::string GenerateJson();
+    // enclosing object of whole output
+    void begin_output();
+    void end_output();
   protected:
     virtual void RenderUnit(int last);
-    void RenderGoAttrs(std::string &, uint64_t id);
-    static std::string EscapeJsonString(const char* str);
-    std::string GenerateJson(Element &);
+    void RenderGoAttrs(uint64_t id);
+    bool need_render(const Element &) const;
+    void GenerateJson(Element &);
+    void GenerateBody(Element &);
+    // ndjson mode - one record per line for each type, function & var with unit context
+    void render_ndjson();
+    void unit_context(std::string &);
     template <class T>
-    std::string &put(std::string &, const char *, T);
-    void render_location(std::string &, param_loc &);
-};
\ No newline at end of file
+    void put(const char *, T);
+    JsonWriter &key(const char *);
+    uint32_t str_idx(const char *);
+    void render_location(const param_loc &);
+    JsonWriter m_w;
+    json_mode m_mode;
+    // string table for compact mode
+    std::unordered_map<std::string, uint32_t> m_strs;
+    std::vector<const std::string *> m_str_list;
+    bool m_has_items = false; // something was written in previous units, so next element needs separator
+};
@@ -0,0 +1,75 @@
+#include "JsonWriter.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// length of prefix without chars needing escaping
+static size_t clean_prefix(const char *s, size_t len)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i slash = _mm_set1_epi8('\\');
+  const __m128i ctrl = _mm_set1_epi8(0x1f);
+  for ( ; i + 16 <= len; i += 16 )
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    // unsigned v <= 0x1f
+    __m128i bad = _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl);
+    bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, quote));
+    bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, slash));
+    int mask = _mm_movemask_epi8(bad);
+    if ( mask )
+      return i + __builtin_ctz(mask);
+  }
+#endif
+  for ( ; i < len; i++ )
+  {
+    unsigned char c = s[i];
+    if ( c < 0x20 || c == '"' || c == '\\' )
+      break;
+  }
+  return i;
+}
+
+void JsonWriter::escape(OutSink &out, const char *s)
+{
+  static const char hex[] = "0123456789abcdef";
+  out.put('"');
+  size_t len = strlen(s);
+  while( len )
+  {
+    size_t n = clean_prefix(s, len);
+    if ( n )
+      out.put(s, n);
+    s += n;
+    len -= n;
+    if ( !len )
+      break;
+    unsigned char c = *s++;
+    len--;
+    switch(c)
+    {
+      case '"': out.put("\\\"", 2);
+       break;
+      case '\\': out.put("\\\\", 2);
+       break;
+      case '\n': out.put("\\n", 2);
+       break;
+      case '\r': out.put("\\r", 2);
+       break;
+      case '\t': out.put("\\t", 2);
+       break;
+      case '\b': out.put("\\b", 2);
+       break;
+      case '\f': out.put("\\f", 2);
+       break;
+      default:
+        {
+          char buf[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+          out.put(buf, 6);
+        }
+    }
+  }
+  out.put('"');
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <vector>
+#include "OutSink.h"
+
+// streaming json writer - emits directly into OutSink and tracks commas itself
+// structure is not validated, so keys can be written inside arrays too (old -j format has such)
+class JsonWriter
+{
+ public:
+  JsonWriter(OutSink *s)
+   : m_s(s)
+  {}
+  inline void set_sink(OutSink *s)
+  {
+    m_s = s;
+  }
+  inline OutSink *sink() const
+  {
+    return m_s;
+  }
+  // sep is separator of items inside this object/array
+  inline JsonWriter &begin_obj(const char *sep = ",")
+  {
+    next();
+    m_s->put('{');
+    m_levels.push_back({ sep, true });
+    return *this;
+  }
+  inline JsonWriter &end_obj()
+  {
+    m_levels.pop_back();
+    m_s->put('}');
+    return *this;
+  }
+  inline JsonWriter &begin_arr(const char *sep = ",")
+  {
+    next();
+    m_s->put('[');
+    m_levels.push_back({ sep, true });
+    return *this;
+  }
+  inline JsonWriter &end_arr()
+  {
+    m_levels.pop_back();
+    m_s->put(']');
+    return *this;
+  }
+  // key of next value, value after key don't need separator
+  inline JsonWriter &key(const char *name)
+  {
+    next();
+    m_s->put('"').put(name).put("\":");
+    m_after_key = true;
+    return *this;
+  }
+  // numeric key like "123":
+  inline JsonWriter &ukey(uint64_t id)
+  {
+    next();
+    m_s->put('"').put_udec(id).put("\":");
+    m_after_key = true;
+    return *this;
+  }
+  inline JsonWriter &str(const char *v)
+  {
+    next();
+    escape(*m_s, v);
+    return *this;
+  }
+  // numbers as json numbers
+  inline JsonWriter &num(int64_t v)
+  {
+    next();
+    m_s->put_dec(v);
+    return *this;
+  }
+  inline JsonWriter &unum(uint64_t v)
+  {
+    next();
+    m_s->put_udec(v);
+    return *this;
+  }
+  // numbers in quotes like old -j format
+  inline JsonWriter &qnum(int64_t v)
+  {
+    next();
+    m_s->put('"').put_dec(v).put('"');
+    return *this;
+  }
+  inline JsonWriter &qunum(uint64_t v)
+  {
+    next();
+    m_s->put('"').put_udec(v).put('"');
+    return *this;
+  }
+  // already formatted value
+  inline JsonWriter &raw(const char *v)
+  {
+    next();
+    m_s->put(v);
+    return *this;
+  }
+  // forget nesting, for example when new top-level value started
+  inline void reset()
+  {
+    m_levels.clear();
+    m_after_key = false;
+  }
+  // put quoted and escaped string
+  static void escape(OutSink &, const char *);
+ protected:
+  inline void next()
+  {
+    if ( m_after_key )
+    {
+      m_after_key = false;
+      return;
+    }
+    if ( m_levels.empty() )
+      return;
+    auto &l = m_levels.back();
+    if ( l.first )
+      l.first = false;
+    else
+      m_s->put(l.sep);
+  }
+  struct level {
+    const char *sep;
+    bool first;
+  };
+  OutSink *m_s;
+  std::vector<level> m_levels;
+  bool m_after_key = false;
+};
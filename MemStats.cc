@@ -0,0 +1,71 @@
+#include "MemStats.h"
+
+MemCounter g_mem[mk_max];
+size_t g_mem_total = 0, g_mem_peak = 0;
+int g_mem_stats = 0;
+
+static const char *const s_mem_names[mk_max] = {
+  "elements",
+  "compounds",
+  "dumped_db",
+  "loclists",
+  "go_types",
+  "sections",
+  "render",
+};
+
+void fput_json_str(FILE *fp, const char *s)
+{
+  fputc('"', fp);
+  for ( ; *s; s++ )
+  {
+    unsigned char c = *s;
+    if ( c == '"' || c == '\\' )
+      fprintf(fp, "\\%c", c);
+    else if ( c < 0x20 )
+      fprintf(fp, "\\u%4.4X", c);
+    else
+      fputc(c, fp);
+  }
+  fputc('"', fp);
+}
+
+void dump_mem_stats(FILE *fp, const char *unit_name)
+{
+  size_t total = g_mem_total, peak = g_mem_peak;
+  if ( g_mem_stats == 2 )
+  {
+    fprintf(fp, "{");
+    if ( unit_name )
+    {
+      fprintf(fp, "\"unit\":");
+      fput_json_str(fp, unit_name);
+    } else
+      fprintf(fp, "\"total\":true");
+    for ( int i = 0; i < mk_max; i++ )
+    {
+      fprintf(fp, ",\"%s\":{\"bytes\":%ld,\"objects\":%ld", s_mem_names[i], g_mem[i].bytes, g_mem[i].objects);
+      if ( !unit_name )
+        fprintf(fp, ",\"peak\":%ld", g_mem[i].peak);
+      fputc('}', fp);
+    }
+    fprintf(fp, ",\"bytes\":%ld", total);
+    if ( !unit_name )
+      fprintf(fp, ",\"peak\":%ld", peak);
+    fprintf(fp, "}\n");
+    return;
+  }
+  if ( unit_name )
+    fprintf(fp, "mem unit %s: %ld bytes\n", unit_name, total);
+  else
+    fprintf(fp, "mem total: %ld bytes, peak %ld\n", total, peak);
+  for ( int i = 0; i < mk_max; i++ )
+  {
+    if ( !g_mem[i].bytes && !g_mem[i].peak )
+      continue;
+    fprintf(fp, " %-10s %12ld bytes %10ld objects", s_mem_names[i], g_mem[i].bytes, g_mem[i].objects);
+    if ( !unit_name )
+      fprintf(fp, ", peak %ld", g_mem[i].peak);
+    fputc('\n', fp);
+  }
+}
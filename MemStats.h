@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <type_traits>
+
+// memory accounting for --mem-stats option
+// counters are updated by allocators of tracked containers, so cost is one add per allocation
+enum MemKind {
+  mk_elements,  // elements_ and children of compounds
+  mk_compounds,
+  mk_dumped_db, // m_dumped_db of namespaces
+  mk_loclists,  // cache of decoded loclists/rnglists
+  mk_go_types,
+  mk_sections,  // decompressed sections
+  mk_render,    // renderer maps
+  mk_max        // not tracked
+};
+
+// sum of bytes of all counters and max of it
+extern size_t g_mem_total, g_mem_peak;
+
+struct MemCounter {
+  size_t bytes = 0, objects = 0,
+   peak = 0; // max of bytes
+  inline void add(size_t b, size_t o = 1)
+  {
+    bytes += b;
+    objects += o;
+    if ( bytes > peak ) peak = bytes;
+    g_mem_total += b;
+    if ( g_mem_total > g_mem_peak ) g_mem_peak = g_mem_total;
+  }
+  inline void sub(size_t b, size_t o = 1)
+  {
+    bytes -= b;
+    objects -= o;
+    g_mem_total -= b;
+  }
+};
+
+extern MemCounter g_mem[mk_max];
+// 0 - no stats, 1 - text, 2 - json
+extern int g_mem_stats;
+
+// dump current counters for unit name or totals with peaks at exit when name is null
+// peaks of kinds can be reached at different time, so total peak is tracked separately
+void dump_mem_stats(FILE *, const char *unit_name);
+// put quoted and escaped json string
+void fput_json_str(FILE *, const char *);
+
+// allocator for std containers, each allocation counted as one object
+template <typename T, MemKind K>
+struct MemAlloc
+{
+  typedef T value_type;
+  MemAlloc() = default;
+  template <typename U>
+  MemAlloc(const MemAlloc<U, K> &)
+  {}
+  template <typename U>
+  struct rebind {
+    typedef MemAlloc<U, K> other;
+  };
+  T *allocate(size_t n)
+  {
+    g_mem[K].add(n * sizeof(T));
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T *p, size_t n)
+  {
+    g_mem[K].sub(n * sizeof(T));
+    std::allocator<T>().deallocate(p, n);
+  }
+  template <typename U>
+  bool operator==(const MemAlloc<U, K> &) const
+  {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const MemAlloc<U, K> &) const
+  {
+    return false;
+  }
+};
+
+// std::allocator for mk_max
+template <typename T, MemKind K>
+using mem_alloc_t = typename std::conditional<K == mk_max, std::allocator<T>, MemAlloc<T, K> >::type;
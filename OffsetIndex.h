@@ -0,0 +1,111 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include "MemStats.h"
+
+// index by DIE offset - sorted vector with binary search instead of hash map
+// DIEs are added mostly in ascending offsets order so usually add is just push_back,
+// otherwise vector is stable-sorted on next lookup
+// duplicated keys are allowed: find returns last added, equal_range returns all in order of adding
+// K is kind of memory counter for --mem-stats
+template <typename V, MemKind K = mk_max>
+class OffsetIndex
+{
+ public:
+  typedef std::pair<uint64_t, V> value_type;
+  typedef std::vector<value_type, mem_alloc_t<value_type, K> > items;
+  typedef typename items::iterator iterator;
+  typedef typename items::const_iterator const_iterator;
+  struct range {
+    iterator b, e;
+    iterator begin() const { return b; }
+    iterator end() const { return e; }
+    size_t size() const { return e - b; }
+    bool empty() const { return b == e; }
+  };
+
+  void add(uint64_t key, const V &v)
+  {
+    if ( !m_items.empty() && key < m_items.back().first )
+      m_sorted = false;
+    m_items.push_back( { key, v } );
+  }
+  iterator find(uint64_t key)
+  {
+    auto ui = upper(key);
+    if ( ui == m_items.begin() || (ui - 1)->first != key )
+      return m_items.end();
+    return ui - 1;
+  }
+  const_iterator find(uint64_t key) const
+  {
+    auto ui = upper(key);
+    if ( ui == m_items.begin() || (ui - 1)->first != key )
+      return m_items.cend();
+    return ui - 1;
+  }
+  range equal_range(uint64_t key)
+  {
+    auto ui = upper(key);
+    auto li = std::lower_bound(m_items.begin(), ui, key,
+      [](const value_type &v, uint64_t k) { return v.first < k; });
+    return { li, ui };
+  }
+  iterator end()
+  {
+    return m_items.end();
+  }
+  const_iterator end() const
+  {
+    return m_items.cend();
+  }
+  const_iterator cend() const
+  {
+    return m_items.cend();
+  }
+  size_t size() const
+  {
+    return m_items.size();
+  }
+  bool empty() const
+  {
+    return m_items.empty();
+  }
+  // remove all items with keys in [lo, hi]
+  void erase_range(uint64_t lo, uint64_t hi)
+  {
+    auto ui = upper(hi);
+    auto li = std::lower_bound(m_items.begin(), ui, lo,
+      [](const value_type &v, uint64_t k) { return v.first < k; });
+    m_items.erase(li, ui);
+  }
+  // sort now, so following lookups don't modify index and can run from several threads
+  void freeze() const
+  {
+    sort();
+  }
+  void clear()
+  {
+    m_items.clear();
+    m_sorted = true;
+  }
+ protected:
+  void sort() const
+  {
+    if ( m_sorted ) return;
+    std::stable_sort(m_items.begin(), m_items.end(),
+      [](const value_type &a, const value_type &b) { return a.first < b.first; });
+    m_sorted = true;
+  }
+  iterator upper(uint64_t key) const
+  {
+    sort();
+    return std::upper_bound(m_items.begin(), m_items.end(), key,
+      [](uint64_t k, const value_type &v) { return k < v.first; });
+  }
+  // lookup can sort, so they are mutable for const methods
+  mutable items m_items;
+  mutable bool m_sorted = true;
+};
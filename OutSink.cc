@@ -0,0 +1,104 @@
+#include <unistd.h>
+#include <errno.h>
+#include "OutSink.h"
+
+thread_local OutSink *g_sink = nullptr;
+
+bool OutSink::drain()
+{
+  if ( m_mem || m_buf.empty() )
+    return true;
+  const char *p = m_buf.data();
+  size_t size = m_buf.size();
+  if ( m_fp )
+  {
+    if ( fwrite_unlocked(p, 1, size, m_fp) != size )
+      m_failed = true;
+  } else if ( m_fd != -1 )
+  {
+    while( size )
+    {
+      auto w = write(m_fd, p, size);
+      if ( w < 0 )
+      {
+        if ( errno == EINTR )
+          continue;
+        m_failed = true;
+        break;
+      }
+      p += w;
+      size -= w;
+    }
+  }
+  m_buf.clear();
+  return !m_failed;
+}
+
+bool OutSink::flush()
+{
+  bool res = drain();
+  if ( m_fp )
+    fflush(m_fp);
+  return res;
+}
+
+OutSink &OutSink::put_udec(uint64_t v)
+{
+  char buf[24];
+  char *p = buf + sizeof(buf);
+  do {
+    *--p = '0' + v % 10;
+    v /= 10;
+  } while( v );
+  return put(p, buf + sizeof(buf) - p);
+}
+
+OutSink &OutSink::put_dec(int64_t v)
+{
+  if ( v >= 0 )
+    return put_udec(v);
+  m_buf.push_back('-');
+  return put_udec(0 - (uint64_t)v);
+}
+
+OutSink &OutSink::put_hex(uint64_t v)
+{
+  static const char digits[] = "0123456789ABCDEF";
+  char buf[16];
+  char *p = buf + sizeof(buf);
+  do {
+    *--p = digits[v & 0xf];
+    v >>= 4;
+  } while( v );
+  return put(p, buf + sizeof(buf) - p);
+}
+
+OutSink &OutSink::vprintf(const char *fmt, va_list ap)
+{
+  // try to format in place first
+  size_t old = m_buf.size();
+  size_t avail = 256;
+  va_list ap2;
+  va_copy(ap2, ap);
+  m_buf.resize(old + avail);
+  int n = vsnprintf(&m_buf[old], avail, fmt, ap);
+  if ( n < 0 )
+    n = 0;
+  else if ( (size_t)n >= avail )
+  {
+    m_buf.resize(old + n + 1);
+    vsnprintf(&m_buf[old], n + 1, fmt, ap2);
+  }
+  va_end(ap2);
+  m_buf.resize(old + n);
+  return check();
+}
+
+OutSink &OutSink::printf(const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+  return *this;
+}
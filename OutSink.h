@@ -0,0 +1,104 @@
+#pragma once
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+// buffered output of renderers
+// data collected in big user-space buffer and written by whole blocks with fwrite_unlocked or write
+// in memory mode all output stays in buffer, see data()
+class OutSink
+{
+ public:
+  static const size_t block_size = 1 << 20;
+  // to stdio file
+  OutSink(FILE *fp)
+   : m_fp(fp)
+  {
+    m_buf.reserve(block_size + 256);
+  }
+  // to file descriptor - file or pipe
+  OutSink(int fd)
+   : m_fd(fd)
+  {
+    m_buf.reserve(block_size + 256);
+  }
+  // in memory
+  OutSink()
+   : m_mem(true)
+  {}
+  ~OutSink()
+  {
+    flush();
+  }
+  OutSink(const OutSink &) = delete;
+  OutSink &operator=(const OutSink &) = delete;
+  // write buffer, for FILE also fflush so other writers to same file stay in order
+  bool flush();
+  inline OutSink &put(char c)
+  {
+    m_buf.push_back(c);
+    return check();
+  }
+  // null is printed like printf %s does
+  inline OutSink &put(const char *s)
+  {
+    if ( !s ) s = "(null)";
+    m_buf.append(s);
+    return check();
+  }
+  inline OutSink &put(const char *s, size_t len)
+  {
+    m_buf.append(s, len);
+    return check();
+  }
+  inline OutSink &put(const std::string &s)
+  {
+    m_buf.append(s);
+    return check();
+  }
+  // like %ld
+  OutSink &put_dec(int64_t);
+  // like %lu
+  OutSink &put_udec(uint64_t);
+  // like %lX
+  OutSink &put_hex(uint64_t);
+  OutSink &printf(const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
+  OutSink &vprintf(const char *fmt, va_list);
+  // for memory mode
+  inline const std::string &data() const
+  {
+    return m_buf;
+  }
+  inline void clear()
+  {
+    m_buf.clear();
+  }
+  // take collected data without copying
+  inline void swap(std::string &s)
+  {
+    m_buf.swap(s);
+  }
+  // was write error
+  inline bool failed() const
+  {
+    return m_failed;
+  }
+ protected:
+  inline OutSink &check()
+  {
+    if ( !m_mem && m_buf.size() >= block_size )
+      drain();
+    return *this;
+  }
+  bool drain();
+  std::string m_buf;
+  FILE *m_fp = nullptr;
+  int m_fd = -1;
+  bool m_mem = false,
+   m_failed = false;
+};
+
+// sink for renderers, set in main. threads of parallel rendering have own
+extern thread_local OutSink *g_sink;
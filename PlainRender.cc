@@ -3,6 +3,13 @@
 #include "debug.h"
 #include "nfilter.h"
 #include <string.h>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+extern int g_opt_M, g_opt_T;
 
 static const char *s_marg = "  ";
 
@@ -30,34 +37,50 @@ std::string &PlainRender::render_one_enum(std::string &s, EnumItem &en, bool has
   return s;
 }
 
-std::list<TreeBuilder::Element *> *PlainRender::get_specs(uint64_t id)
+OffsetIndex<uint64_t, mk_render>::range PlainRender::get_specs(uint64_t id)
+{
+  return m_specs.equal_range(id);
+}
+
+TreeBuilder::Element *PlainRender::find_el(uint64_t id)
 {
-  auto fi = m_specs.find(id);
-  if ( fi == m_specs.end() )
+  auto el = m_els.find(id);
+  if ( el != m_els.end() )
+    return el->second;
+  if ( m_by_id.empty() )
     return nullptr;
-  return &fi->second;
+  return fault_in(id);
+}
+
+void PlainRender::index_els(ElementList &els)
+{
+  for ( auto &e: els )
+  {
+    m_els.add(e.id_, &e);
+    // add methods too
+    if ( e.has_methods() )
+      for ( auto &m: e.m_comp->methods_ )
+        m_els.add(m.id_, &m);
+  }
 }
 
-void PlainRender::prepare(std::list<Element> &els)
+void PlainRender::collect_specs(ElementList &els)
 {
   int need_abs = 0;
   for ( auto &e: els )
   {
-    m_els[e.id_] = &e;
     if ( e.spec_ && e.addr_ )
     {
       // fprintf(g_outf, "spec %lX for %lX\n", e.id_, e.spec_);
-      m_specs[e.spec_].push_back(&e);
+      m_specs.add(e.spec_, e.id_);
     }
     if ( e.is_abs() )
       need_abs |= 1;
-    // add methods too
     if ( e.has_methods() )
       for ( auto &m: e.m_comp->methods_ )
       {
-        m_els[m.id_] = &m;
         if ( m.spec_ && m.addr_ )
-          m_specs[m.spec_].push_back(&m);
+          m_specs.add(m.spec_, m.id_);
         if ( m.is_abs() )
           need_abs |= 1;
       }
@@ -69,80 +92,314 @@ void PlainRender::prepare(std::list<Element> &els)
     {
       if ( !e.is_abs() )
         continue;
-      // fprintf(g_outf, "type %lX abs %lX\n", e.id_, e.abs_);
-      auto f = m_els.find(e.abs_);
-      if ( f == m_els.end() )
+      // fprintf(g_outf, "type %lX abs %lX\n", e.id_, e.get_abs());
+      auto f = find_el(e.get_abs());
+      if ( !f )
       {
         if ( g_opt_v )
-          e_->warning("cannot find origin with type %lX for %lX\n", e.abs_, e.id_);
+          e_->warning("cannot find origin with type %lX for %lX\n", e.get_abs(), e.id_);
         continue;
       }
-      if ( !f->second->spec_ )
+      if ( !f->spec_ )
       {
-        // fprintf(stderr, "invalid origin type %lX for %lX\n", e.abs_, e.id_);
-        m_specs[f->second->id_].push_back(&e);
+        // fprintf(stderr, "invalid origin type %lX for %lX\n", e.get_abs(), e.id_);
+        m_specs.add(f->id_, e.id_);
         continue;
       } else
-        m_specs[f->second->spec_].push_back(&e);
+        m_specs.add(f->spec_, e.id_);
     }
   }
 }
 
-void PlainRender::cmn_vars()
+void PlainRender::prepare(ElementList &els)
+{
+  index_els(els);
+  collect_specs(els);
+}
+
+void PlainRender::cmn_vars(render_ctx &ctx)
 {
-  if ( !m_vars.empty() )
+  if ( !ctx.vars.empty() )
   {
-    fprintf(g_outf, "/// vars\n");
-    dump_vars();
-    m_vars.clear();
+    g_sink->put("/// vars\n");
+    dump_vars(ctx);
+    ctx.vars.clear();
   }
 }
 
+void PlainRender::add_unit()
+{
+  m_all.emplace_back();
+  auto &u = m_all.back();
+  u.cu = cu;
+  u.els = std::move(elements_);
+  if ( !g_opt_M )
+    return;
+  UnitStore::measure(u.els, u.min_id, u.max_id, u.mem);
+  if ( m_all.size() > 1 && u.min_id <= m_max_id )
+  {
+    // ids are not ascending, for example from .debug_types - keep overlapped units in memory
+    for ( auto &o: m_all )
+    {
+      if ( o.pinned || o.max_id < u.min_id || o.min_id > u.max_id )
+        continue;
+      make_resident(o);
+      o.pinned = true;
+    }
+  }
+  if ( u.max_id > m_max_id )
+    m_max_id = u.max_id;
+  m_resident += u.mem;
+  shrink();
+}
+
+bool PlainRender::make_resident(unit_slot &u)
+{
+  if ( u.resident )
+    return true;
+  if ( !m_store->load(u.spill, u.els, m_lvalues) )
+    return false;
+  u.resident = true;
+  m_resident += u.mem;
+  if ( m_indexed )
+    index_els(u.els);
+  return true;
+}
+
+bool PlainRender::evict(unit_slot &u)
+{
+  if ( !m_store )
+    m_store = new UnitStore(e_);
+  if ( !u.spilled || u.dirty )
+  {
+    if ( !m_store->spill(u.els, m_lvalues, u.spill) )
+    {
+      m_no_spill = true;
+      return false;
+    }
+    u.spilled = true;
+    u.dirty = false;
+  } else
+    UnitStore::forget(u.els, m_lvalues);
+  if ( m_indexed )
+    m_els.erase_range(u.min_id, u.max_id);
+  u.els.clear();
+  u.resident = false;
+  m_resident -= u.mem;
+  return true;
+}
+
+// spill oldest units while memory budget from -M option exceeded
+void PlainRender::shrink()
+{
+  if ( !g_opt_M || m_no_spill )
+    return;
+  size_t limit = (size_t)g_opt_M << 20;
+  for ( auto &u: m_all )
+  {
+    if ( m_resident <= limit )
+      break;
+    if ( !u.resident || u.pinned )
+      continue;
+    if ( !evict(u) )
+      break;
+  }
+}
+
+TreeBuilder::Element *PlainRender::fault_in(uint64_t id)
+{
+  auto ui = std::upper_bound(m_by_id.begin(), m_by_id.end(), id,
+    [](uint64_t k, const unit_slot *u) { return k < u->min_id; });
+  if ( ui == m_by_id.begin() )
+    return nullptr;
+  auto u = *(ui - 1);
+  if ( u->resident || id > u->max_id )
+    return nullptr;
+  if ( !make_resident(*u) )
+    return nullptr;
+  auto el = m_els.find(id);
+  return el == m_els.end() ? nullptr : el->second;
+}
+
+// last pass of -g option. first all specifications are collected, then types dumped
+// with -M loaded units are evicted between units, so pointers to elements are valid inside each step
+void PlainRender::render_all()
+{
+  if ( m_store )
+  {
+    for ( auto &u: m_all )
+      if ( !u.pinned )
+        m_by_id.push_back(&u);
+    std::sort(m_by_id.begin(), m_by_id.end(), [](const unit_slot *a, const unit_slot *b) {
+      return a->min_id < b->min_id;
+    });
+  }
+  m_indexed = true;
+  for ( auto &u: m_all )
+    if ( u.resident )
+      index_els(u.els);
+  for ( auto &u: m_all )
+  {
+    if ( !make_resident(u) )
+      continue;
+    collect_specs(u.els);
+    shrink();
+  }
+  // units can be rendered in parallel only when all of them stay in memory
+  unsigned threads = g_opt_T ? g_opt_T : std::thread::hardware_concurrency();
+  if ( !m_store && threads > 1 && m_all.size() > 1 )
+    render_parallel(threads);
+  else for ( auto &u: m_all )
+  {
+    if ( !make_resident(u) )
+      continue;
+    // fprintf(g_outf, "new unit %p\n", &u.cu);
+    render_ctx ctx;
+    render_one(ctx, u);
+    mark_dumped(ctx.dumped);
+    if ( g_shards )
+      g_shards->cut(u.cu.cu_name);
+    shrink();
+  }
+  if ( m_store && g_opt_v )
+    g_sink->put("// units store size ").put_dec(m_store->size()).put('\n');
+}
+
+// ctx is fresh for each unit, so type cache is bounded by single unit and does not eat memory budget from -M
+void PlainRender::render_one(render_ctx &ctx, unit_slot &u)
+{
+  dump_types(ctx, u.els, &u.cu);
+  cmn_vars(ctx);
+  // dumped elements will be marked
+  u.dirty = true;
+}
+
+void PlainRender::mark_dumped(const std::unordered_set<Element *> &dumped)
+{
+  for ( auto e: dumped )
+    e->dumped_ = true;
+}
+
+// after collect_specs all indexes are read-only, so units are rendered by threads into own
+// in-memory sinks and written in original order. dumped elements are collected in render_ctx
+// of each unit and marked after all threads finished, so output is the same as from single thread
+// errors are serialized with SyncLog
+// amount of rendered but not written units is limited to not keep whole output in memory
+void PlainRender::render_parallel(unsigned threads)
+{
+  m_els.freeze();
+  m_specs.freeze();
+  m_replaced.freeze();
+  std::vector<unit_slot *> units;
+  for ( auto &u: m_all )
+    units.push_back(&u);
+  size_t n = units.size();
+  if ( threads > n )
+    threads = n;
+  std::vector<std::unique_ptr<OutSink> > bufs(n);
+  std::vector<std::unordered_set<Element *> > marks(n);
+  SyncLog slog(e_);
+  auto old_log = e_;
+  e_ = &slog;
+  std::mutex lock;
+  std::condition_variable cv;
+  size_t next = 0, written = 0, window = 4 * threads;
+  auto out = g_sink;
+  auto worker = [&]() {
+    for ( ;; )
+    {
+      size_t i;
+      {
+        std::unique_lock<std::mutex> l(lock);
+        cv.wait(l, [&] { return next >= n || next < written + window; });
+        if ( next >= n )
+          break;
+        i = next++;
+      }
+      auto buf = new OutSink();
+      g_sink = buf;
+      render_ctx ctx;
+      render_one(ctx, *units[i]);
+      marks[i] = std::move(ctx.dumped);
+      g_sink = nullptr;
+      {
+        std::lock_guard<std::mutex> l(lock);
+        bufs[i].reset(buf);
+      }
+      cv.notify_all();
+    }
+  };
+  std::vector<std::thread> pool;
+  for ( unsigned i = 0; i < threads; i++ )
+    pool.emplace_back(worker);
+  for ( size_t i = 0; i < n; i++ )
+  {
+    std::unique_ptr<OutSink> buf;
+    {
+      std::unique_lock<std::mutex> l(lock);
+      cv.wait(l, [&] { return bufs[i] != nullptr; });
+      buf = std::move(bufs[i]);
+      written = i + 1;
+    }
+    cv.notify_all();
+    out->put(buf->data());
+    if ( g_shards )
+      g_shards->cut(units[i]->cu.cu_name);
+  }
+  for ( auto &t: pool )
+    t.join();
+  e_ = old_log;
+  for ( auto &m: marks )
+    mark_dumped(m);
+}
+
 void PlainRender::RenderUnit(int last)
 {
   if ( !g_opt_g )
   {
     prepare(elements_);
-    dump_types(elements_, &cu);
-    cmn_vars();
+    render_ctx ctx;
+    dump_types(ctx, elements_, &cu);
+    cmn_vars(ctx);
+    mark_dumped(ctx.dumped);
     m_els.clear();
     m_specs.clear();
   } else {
     if ( !elements_.empty() )
-      m_all.push_back({ cu, std::move(elements_)});
+      add_unit();
     if ( !last )
       return;
-    for ( auto &p: m_all )
-      prepare(p.second);
-    for ( auto &p: m_all )
-    {
-      // fprintf(g_outf, "new unit %p\n", &p.first);
-      m_hdr_dumped = false;
-      dump_types(p.second, &p.first);
-      cmn_vars();
-    }
+    render_all();
   }
   if ( last && m_locsx )
-    fprintf(g_outf, "// locx count %ld, adjacent %ld\n", m_locsx, m_adj_locsx);
+    g_sink->put("// locx count ").put_dec(m_locsx).put(", adjacent ").put_dec(m_adj_locsx).put('\n');
   if ( last && m_locx_els )
-    fprintf(g_outf, "// locx elements %ld, redudant %ld\n", m_locx_els, m_locx_red_els);
+    g_sink->put("// locx elements ").put_dec(m_locx_els).put(", redudant ").put_dec(m_locx_red_els).put('\n');
+  if ( last && g_opt_v && m_locX )
+  {
+    auto cs = m_locX->get_cache_stat();
+    if ( cs->loc_hits || cs->loc_misses )
+      g_sink->put("// loclists cache hits ").put_dec(cs->loc_hits).put(", misses ").put_dec(cs->loc_misses).put('\n');
+    if ( cs->rng_hits || cs->rng_misses )
+      g_sink->put("// rnglists cache hits ").put_dec(cs->rng_hits).put(", misses ").put_dec(cs->rng_misses).put('\n');
+  }
 }
 
 bool PlainRender::conv2str(uint64_t key, std::string &ts)
 {
   if ( get_replaced_name(key, ts) )
     return true;
-  auto el = m_els.find(key);
-  if ( el == m_els.end() )
+  auto el = find_el(key);
+  if ( !el )
     return false;
-  if ( el->second->type_ == ElementType::typedef2 ||
-       el->second->type_ == ElementType::base_type ||
-       el->second->type_ == ElementType::class_type ||
-       el->second->type_ == ElementType::interface_type )
+  if ( el->type_ == ElementType::typedef2 ||
+       el->type_ == ElementType::base_type ||
+       el->type_ == ElementType::class_type ||
+       el->type_ == ElementType::interface_type )
   {
-    if ( el->second->name_ )
+    if ( el->name_ )
     {
-      ts = el->second->name_;
+      ts = el->name_;
       return true;
     } else
       return false;
@@ -150,7 +407,33 @@ bool PlainRender::conv2str(uint64_t key, std::string &ts)
   return false;
 }
 
-bool PlainRender::dump_type(uint64_t key, OUT std::string &res, named *n, int level, int off)
+// pointer, const, typedef & array chains are referenced by many members, params and vars
+// so rendered strings are memoized. results can be reused only when res was empty on entry
+bool PlainRender::dump_type(render_ctx &ctx, uint64_t key, OUT std::string &res, named *n, int level, int off)
+{
+  if ( !res.empty() || !key )
+    return dump_type_(ctx, key, res, n, level, off);
+  // only inlined body of unnamed struct/union/enum depends on margin & offset
+  type_key tk { key, level, off, n && n->used_ };
+  auto el = find_el(key);
+  if ( !el || !el->m_comp || (el->name_ && el->type_ != ElementType::variant_type) ||
+       (el->type_ != ElementType::structure_type && el->type_ != ElementType::union_type &&
+        el->type_ != ElementType::enumerator_type && el->type_ != ElementType::variant_type) )
+    tk.level = tk.off = 0;
+  auto ci = ctx.type_cache.find(tk);
+  if ( ci != ctx.type_cache.end() )
+  {
+    res = ci->second.first;
+    return ci->second.second;
+  }
+  auto deps = ctx.named_deps;
+  bool ok = dump_type_(ctx, key, res, n, level, off);
+  if ( deps == ctx.named_deps )
+    ctx.type_cache.emplace(tk, std::make_pair(res, ok));
+  return ok;
+}
+
+bool PlainRender::dump_type_(render_ctx &ctx, uint64_t key, OUT std::string &res, named *n, int level, int off)
 {
   if ( get_replaced_name(key, res) )
     return true;
@@ -159,8 +442,8 @@ bool PlainRender::dump_type(uint64_t key, OUT std::string &res, named *n, int le
     res = "void";
     return true;
   }
-  auto el = m_els.find(key);
-  if ( el == m_els.end() )
+  auto el = find_el(key);
+  if ( !el )
   {
     if ( is_go() )
     {
@@ -175,72 +458,72 @@ bool PlainRender::dump_type(uint64_t key, OUT std::string &res, named *n, int le
     res += std::to_string(key);
     return true;
   }
-  if ( el->second->type_ == ElementType::typedef2 ||
-       el->second->type_ == ElementType::base_type ||
-       el->second->type_ == ElementType::class_type ||
-       el->second->type_ == ElementType::interface_type ||
-       el->second->type_ == ElementType::unspec_type
+  if ( el->type_ == ElementType::typedef2 ||
+       el->type_ == ElementType::base_type ||
+       el->type_ == ElementType::class_type ||
+       el->type_ == ElementType::interface_type ||
+       el->type_ == ElementType::unspec_type
      )
   {
-    if ( el->second->name_ )
+    if ( el->name_ )
     {
-      res = el->second->name_;
+      res = el->name_;
       return true;
     } else
       return false;
   }
-  if ( el->second->type_ == ElementType::structure_type )
+  if ( el->type_ == ElementType::structure_type )
   {
     res = "struct ";
-    if ( el->second->name_ )
-      res += el->second->name_;
-    else if ( el->second->m_comp != nullptr )
+    if ( el->name_ )
+      res += el->name_;
+    else if ( el->m_comp != nullptr )
     {
       res += "{\n";
-      render_fields(el->second, res, level + 1, off);
+      render_fields(ctx, el, res, level + 1, off);
       add_margin(res, level);
       res += "}";
     }
     return true;
   }
-  if ( el->second->type_ == ElementType::variant_type )
+  if ( el->type_ == ElementType::variant_type )
   {
     res = "variant ";
-    if ( el->second->m_comp != nullptr )
+    if ( el->m_comp != nullptr )
     {
       res += "{\n";
-      render_fields(el->second, res, level + 1, off);
+      render_fields(ctx, el, res, level + 1, off);
       add_margin(res, level);
       res += "}";
     }
     return true;
   }
-  if ( el->second->type_ == ElementType::union_type )
+  if ( el->type_ == ElementType::union_type )
   {
     res = "union ";
-    if ( el->second->name_ )
-      res += el->second->name_;
-    else if ( el->second->m_comp != nullptr )
+    if ( el->name_ )
+      res += el->name_;
+    else if ( el->m_comp != nullptr )
     {
       res += "{\n";
-      render_fields(el->second, res, level + 1, off);
+      render_fields(ctx, el, res, level + 1, off);
       add_margin(res, level);
       res += "}";
     }
     return true;
   }
-  if ( el->second->type_ == ElementType::enumerator_type )
+  if ( el->type_ == ElementType::enumerator_type )
   {
     res = "enum ";
-    if ( el->second->enum_class_ ) res += "class ";
-    if ( el->second->name_ )
-      res += el->second->name_;
-    else if ( el->second->m_comp != nullptr )
+    if ( el->enum_class_ ) res += "class ";
+    if ( el->name_ )
+      res += el->name_;
+    else if ( el->m_comp != nullptr )
     {
       res += "{\n";
       int n = 0;
-      bool signed_enum = is_signed_ate(el->second->ate_);
-      for ( auto &en: el->second->m_comp->enums_ )
+      bool signed_enum = is_signed_ate(el->ate_);
+      for ( auto &en: el->m_comp->enums_ )
       {
         std::string one;
         if ( n )
@@ -253,10 +536,10 @@ bool PlainRender::dump_type(uint64_t key, OUT std::string &res, named *n, int le
     }
     return true;
   }
-  if ( el->second->type_ == ElementType::pointer_type )
+  if ( el->type_ == ElementType::pointer_type )
   {
     std::string tmp;
-    dump_type(el->second->type_id_, tmp, n);
+    dump_type(ctx, el->type_id_, tmp, n);
     res = tmp;
     // probably wrong assumption: if we had subroutine_type somewhere below (and this is the only place where used_ field become true)
     // then we don`t need to add yet one asterisk
@@ -264,94 +547,95 @@ bool PlainRender::dump_type(uint64_t key, OUT std::string &res, named *n, int le
       res += "*";
     return true;
   }
-  if ( el->second->type_ == ElementType::volatile_type )
+  if ( el->type_ == ElementType::volatile_type )
   {
     std::string tmp;
-    dump_type(el->second->type_id_, tmp, n);
+    dump_type(ctx, el->type_id_, tmp, n);
     res = "volatile ";
     res += tmp;
     return true;
   }
-  if ( el->second->type_ == ElementType::dynamic_type )
+  if ( el->type_ == ElementType::dynamic_type )
   {
     std::string tmp;
-    dump_type(el->second->type_id_, tmp, n);
+    dump_type(ctx, el->type_id_, tmp, n);
     res = "dynamic "; // ??
     res += tmp;
     return true;
   }
-  if ( el->second->type_ == ElementType::atomic_type )
+  if ( el->type_ == ElementType::atomic_type )
   {
     std::string tmp;
-    dump_type(el->second->type_id_, tmp, n);
+    dump_type(ctx, el->type_id_, tmp, n);
     res = "_Atomic ";
     res += tmp;
     return true;
   }
-  if ( el->second->type_ == ElementType::immutable_type )
+  if ( el->type_ == ElementType::immutable_type )
   {
     std::string tmp;
-    dump_type(el->second->type_id_, tmp, n);
+    dump_type(ctx, el->type_id_, tmp, n);
     res = "immutable "; // ??
     res += tmp;
     return true;
   }
-  if ( el->second->type_ == ElementType::restrict_type )
+  if ( el->type_ == ElementType::restrict_type )
   {
     std::string tmp;
-    dump_type(el->second->type_id_, tmp, n);
+    dump_type(ctx, el->type_id_, tmp, n);
     res = "restrict ";
     res += tmp;
     return true;
   }
-  if ( el->second->type_ == ElementType::reference_type )
+  if ( el->type_ == ElementType::reference_type )
   {
     std::string tmp;
-    dump_type(el->second->type_id_, tmp, n);
+    dump_type(ctx, el->type_id_, tmp, n);
     res = tmp;
     res += "&";
     return true;
   }
-  if ( el->second->type_ == ElementType::rvalue_ref_type )
+  if ( el->type_ == ElementType::rvalue_ref_type )
   {
     std::string tmp;
-    dump_type(el->second->type_id_, tmp, n);
+    dump_type(ctx, el->type_id_, tmp, n);
     res = tmp;
     res += "&&";
     return true;
   }
-  if ( el->second->type_ == ElementType::const_type )
+  if ( el->type_ == ElementType::const_type )
   {
     std::string tmp;
-    dump_type(el->second->type_id_, tmp, n);
+    dump_type(ctx, el->type_id_, tmp, n);
     res = "const ";
     res += tmp;
     return true;
   }
-  if ( el->second->type_ == ElementType::array_type )
+  if ( el->type_ == ElementType::array_type )
   {
-    if ( el->second->gnu_vector_ || el->second->tensor_ ) {
+    if ( el->gnu_vector_ || el->tensor_ ) {
       res += "/*";
-      if ( el->second->gnu_vector_ ) res += " GNU_vector";
-      if ( el->second->tensor_ )     res += " tensor";
+      if ( el->gnu_vector_ ) res += " GNU_vector";
+      if ( el->tensor_ )     res += " tensor";
       res += " */";
     }
-    dump_type(el->second->type_id_, res, n);
+    dump_type(ctx, el->type_id_, res, n);
     res += "[";
-    res += std::to_string(el->second->count_);
+    res += std::to_string(el->count_);
     res += "]";
     return true;
   }
-  if ( el->second->type_ == ElementType::ptr2member )
+  if ( el->type_ == ElementType::ptr2member )
   {
+    ctx.named_deps++;
     std::string cname, tname, tmp;
-    dump_type(el->second->cont_type_, cname, n);
+    dump_type(ctx, el->get_cont_type(), cname, n);
     if ( n->name() != nullptr )
     {
       tmp = cname + "::*" + n->name();
       named n2 { tmp.c_str() };
       n2.no_ptr_ = true;
-      dump_type(el->second->type_id_, tname, &n2);
+      dump_type(ctx, el->type_id_, tname, &n2);
       if ( n2.used_ )
       {
         n->used_ = true;
@@ -359,20 +643,21 @@ bool PlainRender::dump_type(uint64_t key, OUT std::string &res, named *n, int le
         return true;
       } 
     } else
-      dump_type(el->second->type_id_, tname, n);
+      dump_type(ctx, el->type_id_, tname, n);
     res = tname + " " + cname + "::*";
     return true;
   }
-  if ( el->second->type_ == ElementType::subroutine_type )
+  if ( el->type_ == ElementType::subroutine_type )
   {
+    ctx.named_deps++;
     auto sname = n->name();
     n->used_ = true;
-    if ( el->second->m_comp )
-      dump_params_locations(el->second->m_comp->params_, res, level);
-    if ( el->second->type_id_ )
+    if ( el->m_comp )
+      dump_params_locations(ctx, el->m_comp->params_, res, level);
+    if ( el->type_id_ )
     {
       std::string tmp;
-      dump_type(el->second->type_id_, tmp, n);
+      dump_type(ctx, el->type_id_, tmp, n);
       res += tmp;
     } else
       res += "void";
@@ -382,17 +667,17 @@ bool PlainRender::dump_type(uint64_t key, OUT std::string &res, named *n, int le
     if ( sname != nullptr )
       res += sname;
     res += ")(";
-    if ( !el->second->m_comp || el->second->m_comp->params_.empty() )
+    if ( !el->m_comp || el->m_comp->params_.empty() )
       ;
     else {
       std::string params;
-      res += render_params(el->second, 0, params);
+      res += render_params(ctx, el, 0, params);
     }
     res += ")";
     return true;
   }
   res = "dump_type";
-  res += std::to_string(el->second->type_);
+  res += std::to_string(el->type_);
   return false;
 }
 
@@ -412,13 +697,13 @@ void PlainRender::dump_enums(Element *e)
     n++;
     s += render_one_enum(one, en, signed_enum);
   }
-  fprintf(g_outf, "%s\n", s.c_str());
+  g_sink->put(s).put('\n');
 }
 
-std::string &PlainRender::render_field(Element *e, std::string &s, int level, int off)
+std::string &PlainRender::render_field(render_ctx &ctx, Element *e, std::string &s, int level, int off)
 {
   named n { e->name_ };
-  dump_type(e->type_id_, s, &n, level, off);
+  dump_type(ctx, e->type_id_, s, &n, level, off);
   auto name = n.name();
   if ( name != nullptr )
   {
@@ -436,7 +721,7 @@ std::string &PlainRender::render_field(Element *e, std::string &s, int level, in
   return s;
 }
 
-std::string &PlainRender::render_fields(Element *e, std::string &s, int level, int off)
+std::string &PlainRender::render_fields(render_ctx &ctx, Element *e, std::string &s, int level, int off)
 {
   if ( !e->m_comp )
     return s;
@@ -455,70 +740,73 @@ std::string &PlainRender::render_fields(Element *e, std::string &s, int level, i
     }
     s += "\n";
     add_margin(s, level);
-    render_field(&en, tmp, level + 1, off + en.offset_);
+    render_field(ctx, &en, tmp, level + 1, off + en.offset_);
     s += tmp + ";\n";
   }
   return s;
 }
 
-void PlainRender::dump_fields(Element *e, int level, std::string &marg)
+void PlainRender::dump_fields(render_ctx &ctx, Element *e, int level, std::string &marg)
 {
   if ( !e->m_comp )
     return;
   for ( auto &en: e->m_comp->members_ )
   {
     std::string tmp;
-    fprintf(g_outf, "%s// Offset 0x%lX\n", marg.c_str(), en.offset_);
-    render_field(&en, tmp, level + 1, en.offset_);
-    fprintf(g_outf, "%s%s;\n", marg.c_str(), tmp.c_str());
+    g_sink->put(marg).put("// Offset 0x").put_hex(en.offset_).put('\n');
+    render_field(ctx, &en, tmp, level + 1, en.offset_);
+    g_sink->put(marg).put(tmp).put(";\n");
   }
 }
 
-void PlainRender::dump_spec(Element *en, std::string &marg)
+void PlainRender::dump_spec(render_ctx &ctx, Element *en, std::string &marg)
 {
   auto slist = get_specs(en->id_);
-  if ( slist == nullptr )
+  if ( slist.empty() )
     return;
-  auto s = slist->size();
+  auto s = slist.size();
   if ( s > 1 )
-    fprintf(g_outf, "%s// specifications: %ld\n", marg.c_str(), s);
+    g_sink->put(marg).put("// specifications: ").put_dec(s).put('\n');
   else
-    fprintf(g_outf, "%s// specification\n", marg.c_str());
-  for ( auto e: *slist )
+    g_sink->put(marg).put("// specification\n");
+  for ( auto &si: slist )
   {
+    auto e = find_el(si.second);
+    if ( !e )
+      continue;
     std::string s_name;
     if ( g_opt_s && m_snames != nullptr )
       m_snames->find_sname(e->addr_, s_name);
     if ( s_name.empty() )
-      fprintf(g_outf, "%s//  Addr %lX type_id %lX", marg.c_str(), e->addr_, e->id_);
+      g_sink->put(marg).put("//  Addr ").put_hex(e->addr_).put(" type_id ").put_hex(e->id_);
     else
-      fprintf(g_outf, "%s//  Addr %lX %s type_id %lX", marg.c_str(), e->addr_, s_name.c_str(), e->id_);
+      g_sink->put(marg).put("//  Addr ").put_hex(e->addr_).put(' ').put(s_name).put(" type_id ").put_hex(e->id_);
     if ( e->link_name_ )
-      fprintf(g_outf, " %s", e->link_name_);
-    fprintf(g_outf, "\n");
-    dump_lvars(e, marg);
+      g_sink->put(' ').put(e->link_name_);
+    g_sink->put('\n');
+    dump_lvars(ctx, e, marg);
   }
 }
 
-void PlainRender::dump_methods(Element *e, int level, std::string &marg)
+void PlainRender::dump_methods(render_ctx &ctx, Element *e, int level, std::string &marg)
 {
   if ( !e->has_methods() )
     return;
-  fprintf(g_outf, "%s// --- methods\n", marg.c_str());
+  g_sink->put(marg).put("// --- methods\n");
   for ( auto &en: e->m_comp->methods_ )
   {
     std::string tmp, plocs;
-    dump_method(&en, e, tmp);
+    dump_method(ctx, &en, e, tmp);
     if ( g_opt_v )
-      fprintf(g_outf, "%s// TypeId %lX\n", marg.c_str(), en.id_);
+      g_sink->put(marg).put("// TypeId ").put_hex(en.id_).put('\n');
     if ( en.vtbl_index_ )
-      fprintf(g_outf, "%s// Vtbl index %lX\n", marg.c_str(), en.vtbl_index_);
-    dump_spec(&en, marg);
-    if ( en.m_comp && dump_params_locations(en.m_comp->params_, plocs) )
-      fprintf(g_outf, "%s%s", marg.c_str(), plocs.c_str());
+      g_sink->put(marg).put("// Vtbl index ").put_hex(en.vtbl_index_).put('\n');
+    dump_spec(ctx, &en, marg);
+    if ( en.m_comp && dump_params_locations(ctx, en.m_comp->params_, plocs) )
+      g_sink->put(marg).put(plocs);
     // dump local vars
-    dump_lvars(&en, marg);
-    fprintf(g_outf, "%s%s;\n", marg.c_str(), tmp.c_str());
+    dump_lvars(ctx, &en, marg);
+    g_sink->put(marg).put(tmp).put(";\n");
   }
 }
 
@@ -542,7 +830,7 @@ bool PlainRender::is_constructor(const Element *e, const Element *owner) const
   return !strcmp(e->name_, owner->name_);
 }
 
-void PlainRender::dump_method(Method *e, const Element *owner, std::string &res)
+void PlainRender::dump_method(render_ctx &ctx, Method *e, const Element *owner, std::string &res)
 {
   res = access_name(e->access_);
   if ( e->inlined_ )
@@ -561,7 +849,7 @@ void PlainRender::dump_method(Method *e, const Element *owner, std::string &res)
   if ( e->type_id_ )
   {
     named n { e->name_ };
-    dump_type(e->type_id_, tmp, &n);
+    dump_type(ctx, e->type_id_, tmp, &n);
   } else {
     if ( !e->art_ && ! is_constructor(e, owner) )
       tmp = "void";
@@ -574,7 +862,7 @@ void PlainRender::dump_method(Method *e, const Element *owner, std::string &res)
     ;
   else {
     std::string params;
-    res += render_params(e, e->this_arg_, params);
+    res += render_params(ctx, e, e->this_arg_, params);
   }
   res.push_back(')');
   if ( e->def_ )
@@ -583,7 +871,7 @@ void PlainRender::dump_method(Method *e, const Element *owner, std::string &res)
     res += " = 0";
 }
 
-std::string &PlainRender::render_params(Element *e, uint64_t this_arg, OUT std::string &s)
+std::string &PlainRender::render_params(render_ctx &ctx, Element *e, uint64_t this_arg, OUT std::string &s)
 {
   for ( size_t i = 0; i < e->m_comp->params_.size(); i++ )
   {
@@ -592,7 +880,7 @@ std::string &PlainRender::render_params(Element *e, uint64_t this_arg, OUT std::
     if ( e->m_comp->params_[i].ellipsis )
       tmp = "...";
     else { 
-      dump_type(e->m_comp->params_[i].id, tmp, &n);
+      dump_type(ctx, e->m_comp->params_[i].id, tmp, &n);
     }
     if ( e->m_comp->params_[i].pdir == 2 )
       s += "IN ";
@@ -611,7 +899,7 @@ std::string &PlainRender::render_params(Element *e, uint64_t this_arg, OUT std::
   return s;
 }
 
-bool PlainRender::dump_params_locations(std::vector<FormalParam> &params, std::string &s, int level)
+bool PlainRender::dump_params_locations(render_ctx &ctx, std::vector<FormalParam> &params, std::string &s, int level)
 {
   if ( params.empty() )
     return false;
@@ -643,7 +931,7 @@ bool PlainRender::dump_params_locations(std::vector<FormalParam> &params, std::s
   return res;
 }
 
-void PlainRender::dump_lvars(Element *e, std::string &marg)
+void PlainRender::dump_lvars(render_ctx &ctx, Element *e, std::string &marg)
 {
   if ( g_opt_x && e->has_lvars() )
   {
@@ -658,26 +946,26 @@ void PlainRender::dump_lvars(Element *e, std::string &marg)
       if ( !latch )
       {
         if ( !lvar )
-          fprintf(g_outf, "%s// StaticVars:\n", marg.c_str());
+          g_sink->put(marg).put("// StaticVars:\n");
         else
-          fprintf(g_outf, "%s// LocalVars:\n", marg.c_str());
+          g_sink->put(marg).put("// LocalVars:\n");
         latch |= 1;
       }
-      fprintf(g_outf, "%s//  LVar%d, tag %lX\n", marg.c_str(), idx, lv->id_);
+      g_sink->put(marg).put("//  LVar").put_dec(idx).put(", tag ").put_hex(lv->id_).put('\n');
       ++idx;
-      dump_one_var(lv, lvar);
+      dump_one_var(ctx, lv, lvar);
       if ( lv->has_locx )
       {
-        fprintf(g_outf, "%s//   locx %lx\n", marg.c_str(), lv->locx_);
+        g_sink->printf("%s//   locx %lx\n", marg.c_str(), lv->get_locx());
         if ( m_locX )
         {
-          std::list<LocListXItem> locs;
-          if ( !m_locX->get_loclistx(lv->locx_, locs, cu.cu_base_addr) )
-            fprintf(g_outf, "//   cannot read locx at %lx\n", lv->locx_);
+          auto locs = m_locX->get_cached_loclistx(lv->get_locx(), cu.cu_base_addr);
+          if ( !locs )
+            g_sink->printf("//   cannot read locx at %lx\n", lv->get_locx());
           else {
             uint64_t old_end = 0;
-            param_loc *old_loc = nullptr;
-            for ( auto &l: locs )
+            const param_loc *old_loc = nullptr;
+            for ( auto &l: *locs )
             {
               m_locsx++;
               bool adj = false;
@@ -698,55 +986,55 @@ void PlainRender::dump_lvars(Element *e, std::string &marg)
               }
               std::string ls;
               dump_location(ls, l.loc);
-              fprintf(g_outf, "%s//    %lX - %lX: %s", marg.c_str(), l.start, l.end, ls.c_str());
+              g_sink->put(marg).put("//    ").put_hex(l.start).put(" - ").put_hex(l.end).put(": ").put(ls);
               if ( adj )
-                fprintf(g_outf, " -- ADJ\n");
+                g_sink->put(" -- ADJ\n");
               else
-                fputc('\n', g_outf);
+                g_sink->put('\n');
             }
           }
         }
       } else {
-        auto liter = e->m_comp->lvar_locs_.find(lv);
-        if ( liter != e->m_comp->lvar_locs_.end() )
+        auto lloc = e->m_comp->find_lvar_loc(lv);
+        if ( lloc )
         {
           std::string ls;
-          dump_location(ls, liter->second);
-          fprintf(g_outf, "%s//   location %s\n", marg.c_str(), ls.c_str());
+          dump_location(ls, *lloc);
+          g_sink->put(marg).put("//   location ").put(ls).put('\n');
         }
       }
     }
   }
 }
 
-void PlainRender::dump_func(Element *e, int level, std::string &marg)
+void PlainRender::dump_func(render_ctx &ctx, Element *e, int level, std::string &marg)
 {
-  dump_lvars(e, marg);
-  dump_spec(e, marg);
+  dump_lvars(ctx, e, marg);
+  dump_spec(ctx, e, marg);
   std::string tmp;
-  if ( e->m_comp && dump_params_locations(e->m_comp->params_, tmp) )
+  if ( e->m_comp && dump_params_locations(ctx, e->m_comp->params_, tmp) )
   {
-    fprintf(g_outf, "%s", tmp.c_str());
+    g_sink->put(tmp);
     tmp.clear();
   }
-  if ( !marg.empty() ) fprintf(g_outf, "%s", marg.c_str());
+  if ( !marg.empty() ) g_sink->put(marg);
   if ( e->type_id_ )
   {
     named n { e->name_ };
-    dump_type(e->type_id_, tmp, &n);
+    dump_type(ctx, e->type_id_, tmp, &n);
   } else
     tmp = "void";
   if ( e->inlined_ )
-    fprintf(g_outf, "inline ");
-  fprintf(g_outf, "%s %s(", tmp.c_str(), e->name_);
+    g_sink->put("inline ");
+  g_sink->put(tmp).put(' ').put(e->name_).put('(');
   if ( !e->m_comp || e->m_comp->params_.empty() )
-    fprintf(g_outf, "void");
+    g_sink->put("void");
   else {
     std::string params;
-    render_params(e, 0, params);
-    fprintf(g_outf, "%s", params.c_str());
+    render_params(ctx, e, 0, params);
+    g_sink->put(params);
   }
-  fprintf(g_outf, ")");
+  g_sink->put(')');
 }
 
 const char *lmargin = "   ";
@@ -768,38 +1056,38 @@ int PlainRender::form_var_fullname(Element *e, std::string &res)
   return count;
 }
 
-void PlainRender::dump_var(Element *e, int local)
+void PlainRender::dump_var(render_ctx &ctx, Element *e, int local)
 {
   const char *margin = local ? lmargin : "";
   if ( e->link_name_ && e->link_name_ != e->name_ )
-    fprintf(g_outf, "// %sLinkageName: %s\n", margin, e->link_name_);
-  if ( !local && !e->fullname_.empty() )
-    fprintf(g_outf, "// %sFileName: %s\n", margin, e->fullname_.c_str());
+    g_sink->put("// ").put(margin).put("LinkageName: ").put(e->link_name_).put('\n');
+  if ( !local && e->get_fullname() )
+    g_sink->put("// ").put(margin).put("FileName: ").put(e->get_fullname()->c_str()).put('\n');
   std::string tname, var_full_name;
   int has_full = 0;
   if ( !local )
     has_full = form_var_fullname(e, var_full_name);
   named n { has_full ? var_full_name.c_str() : e->name_ };
-  dump_type(e->type_id_, tname, &n);
+  dump_type(ctx, e->type_id_, tname, &n);
   auto tn = n.name();
   if ( tn != nullptr )
   {
     if ( local )
-      fprintf(g_outf, "// %s%s %s\n", margin, tname.c_str(), e->name_);
+      g_sink->put("// ").put(margin).put(tname).put(' ').put(e->name_).put('\n');
     else
-      fprintf(g_outf, "%s %s;\n", tname.c_str(), has_full ? var_full_name.c_str() : e->name_);
+      g_sink->put(tname).put(' ').put(has_full ? var_full_name.c_str() : e->name_).put(";\n");
   } else {
     if ( local )
-      fprintf(g_outf, "// %s%s\n", margin, tname.c_str());
+      g_sink->put("// ").put(margin).put(tname).put('\n');
     else
-      fprintf(g_outf, "%s;\n", tname.c_str());
+      g_sink->put(tname).put(";\n");
   }
 }
 
 TreeBuilder::Element *PlainRender::try_find_in_frames(Element *e)
 {
   if ( !e || !e->owner_ ) return nullptr;
-  auto saved_abs = e->abs_;
+  auto saved_abs = e->get_abs();
   for( e = e->owner_; e; e = e->owner_ )
   {
     if ( e->type_ == ns_start ) break;
@@ -810,7 +1098,7 @@ TreeBuilder::Element *PlainRender::try_find_in_frames(Element *e)
   return nullptr;
 }
 
-void PlainRender::dump_one_var(Element *e, int local)
+void PlainRender::dump_one_var(render_ctx &ctx, Element *e, int local)
 {
   const char *margin = local ? lmargin : "";
   if ( e->addr_ )
@@ -819,102 +1107,105 @@ void PlainRender::dump_one_var(Element *e, int local)
     if ( g_opt_s && m_snames != nullptr )
       m_snames->find_sname(e->addr_, s_name);
     if ( s_name.empty() )
-      fprintf(g_outf, "// %sAddr 0x%lX\n", margin, e->addr_);
+      g_sink->put("// ").put(margin).put("Addr 0x").put_hex(e->addr_).put('\n');
     else
-      fprintf(g_outf, "// %sAddr 0x%lX %s\n", margin, e->addr_, s_name.c_str());
+      g_sink->put("// ").put(margin).put("Addr 0x").put_hex(e->addr_).put(' ').put(s_name).put('\n');
   }
   auto ti = m_tls.find(e->id_);
   if ( ti != m_tls.end() )
-    fprintf(g_outf, "// %sTlsIndex 0x%X\n", margin, ti->second);
+    g_sink->printf("// %sTlsIndex 0x%X\n", margin, ti->second);
   if ( e->addr_class_ ) {
     auto ac_name = get_addr_class(e->addr_class_);
     if ( ac_name )
-      fprintf(g_outf, "// %sAddrClass %d (%s)\n", margin, e->addr_class_, ac_name);
+      g_sink->put("// ").put(margin).put("AddrClass ").put_dec(e->addr_class_).put(" (").put(ac_name).put(")\n");
     else
-      fprintf(g_outf, "// %sAddrClass %d\n", margin, e->addr_class_);
+      g_sink->put("// ").put(margin).put("AddrClass ").put_dec(e->addr_class_).put('\n');
   }
   if ( g_opt_v )
-    fprintf(g_outf, "// %sTypeId %lX\n", margin, e->id_);
+    g_sink->put("// ").put(margin).put("TypeId ").put_hex(e->id_).put('\n');
   if ( e->name_ )
-    dump_var(e, local);
+    dump_var(ctx, e, local);
   else if ( e->spec_ )
   {
-    auto el = m_els.find(e->spec_);
-    if ( el == m_els.end() )
+    auto el = find_el(e->spec_);
+    if ( !el )
     {
       e_->warning("cannot find var id %lX with spec %lX\n", e->id_, e->spec_);
-      fprintf(g_outf, "// cannot find var with spec %lX\n", e->spec_);
+      g_sink->put("// cannot find var with spec ").put_hex(e->spec_).put('\n');
     } else
-      dump_var(el->second, local);
-  } else if ( e->abs_ )
+      dump_var(ctx, el, local);
+  } else if ( e->get_abs() )
   {
-    auto el = m_els.find(e->abs_);
-    if ( el == m_els.end() )
+    auto el = find_el(e->get_abs());
+    if ( !el )
     {
       auto above = try_find_in_frames(e);
       if ( !above )
       {
-        e_->warning("cannot find var id %lX with abs %lX\n", e->id_, e->abs_);
-        fprintf(g_outf, "// cannot find var with abs %lX\n", e->abs_);
+        e_->warning("cannot find var id %lX with abs %lX\n", e->id_, e->get_abs());
+        g_sink->put("// cannot find var with abs ").put_hex(e->get_abs()).put('\n');
       } else
-       dump_var(above, local);
+       dump_var(ctx, above, local);
     } else
-      dump_var(el->second, local);
+      dump_var(ctx, el, local);
   } else if ( !local) {
     e_->warning("unknown var id %lX\n", e->id_);
-    fprintf(g_outf, "// unknown var id %lX\n", e->id_);
+    g_sink->put("// unknown var id ").put_hex(e->id_).put('\n');
   }
 }
 
-void PlainRender::dump_vars()
+void PlainRender::dump_vars(render_ctx &ctx)
 {
-  for ( auto &e: m_vars )
-    dump_one_var(e, 0);
+  for ( auto &e: ctx.vars )
+    dump_one_var(ctx, e, 0);
 }
 
-int PlainRender::dump_parents(Element &e, std::string &marg)
+int PlainRender::dump_parents(render_ctx &ctx, Element &e, std::string &marg)
 {
   if ( e.m_comp && !e.m_comp->parents_.empty() )
   {
-    fprintf(g_outf, " :\n");
+    g_sink->put(" :\n");
     for ( size_t pi = 0; pi < e.m_comp->parents_.size(); pi++ )
     {
-      fprintf(g_outf, "%s// offset %lX\n", marg.c_str(), e.m_comp->parents_[pi].offset);
-      if ( !marg.empty() ) fprintf(g_outf, "%s", marg.c_str());
+      g_sink->put(marg).put("// offset ").put_hex(e.m_comp->parents_[pi].offset).put('\n');
+      if ( !marg.empty() ) g_sink->put(marg);
       std::string pname;
       named pn;
-      dump_type(e.m_comp->parents_[pi].id, pname, &pn);
+      dump_type(ctx, e.m_comp->parents_[pi].id, pname, &pn);
       if ( e.m_comp->parents_[pi].virtual_ )
-        fprintf(g_outf, "virtual ");
-      fprintf(g_outf, "%s%s", access_name(e.m_comp->parents_[pi].access), pname.c_str());
+        g_sink->put("virtual ");
+      g_sink->put(access_name(e.m_comp->parents_[pi].access)).put(pname);
       if ( pi != e.m_comp->parents_.size() - 1 )
-        fprintf(g_outf, ",\n");
+        g_sink->put(",\n");
       else
-        fprintf(g_outf, "\n");
+        g_sink->put('\n');
     }
     return 1;
   }
   return 0;
 }
 
-void PlainRender::dump_complex_type(Element &e, int level, std::string &marg)
+void PlainRender::dump_complex_type(render_ctx &ctx, Element &e, int level, std::string &marg)
 {
-  fprintf(g_outf, " {\n");
-  dump_fields(&e, level, marg);
-  dump_methods(&e, level, marg);
-  dump_lvars(&e, marg);
+  g_sink->put(" {\n");
+  dump_fields(ctx, &e, level, marg);
+  dump_methods(ctx, &e, level, marg);
+  dump_lvars(ctx, &e, marg);
   if ( e.m_comp != nullptr && !e.m_comp->nested.empty() ) {
     std::string next_marg = marg + s_marg;
     for ( auto n: e.m_comp->nested ) {
        if ( !n->m_comp ) continue;
-       if ( n->dumped_ ) continue;
+       if ( ctx.is_dumped(n) ) continue;
        if ( !n->name_ )  continue;
        dump_type_hdr(*n, next_marg);
-       n->dumped_ = dump_nested(*n, level + 1, next_marg);
-       if ( n->dumped_ ) fprintf(g_outf, ";\n");
+       if ( dump_nested(ctx, *n, level + 1, next_marg) )
+       {
+         ctx.dumped.insert(n);
+         g_sink->put(";\n");
+       }
     }
   }
-  fprintf(g_outf, "%s}", marg.c_str());
+  g_sink->put(marg).put('}');
 }
 
 bool PlainRender::need_add_var(const Element &e) const
@@ -932,13 +1223,13 @@ bool PlainRender::need_add_var(const Element &e) const
   return false;
 }
 
-bool PlainRender::add_var(Element &e)
+bool PlainRender::add_var(render_ctx &ctx, Element &e)
 {
   if ( ElementType::var_type != e.type_ )
     return false;
   if ( e.addr_ && need_dump(e.fname_) )
   {
-    m_vars.push_back(&e);
+    ctx.vars.push_back(&e);
     return true;
   }
   if ( need_dump(e.fname_) )
@@ -946,14 +1237,14 @@ bool PlainRender::add_var(Element &e)
     auto ti = m_tls.find(e.id_);
     if ( ti != m_tls.end() )
     {
-      m_vars.push_back(&e);
+      ctx.vars.push_back(&e);
       return true;
     }
   }
   return false;
 }
 
-void PlainRender::dump_const_expr(Element *e)
+void PlainRender::dump_const_expr(render_ctx &ctx, Element *e)
 {
   if ( !e->name_ )
     return;
@@ -966,7 +1257,7 @@ void PlainRender::dump_const_expr(Element *e)
   if ( !get_replaced_name(e->type_id_, name, &ate) )
   {
     auto et = e;
-    auto el = m_els.end();
+    Element *el = nullptr;
     while( name.empty() )
     {
 // fprintf(stderr, "dump_const_expr %lX type %s\n", et->type_id_, et->TypeName());
@@ -975,7 +1266,7 @@ void PlainRender::dump_const_expr(Element *e)
         ate = et->ate_;
         if ( et->name_ )
           name = et->name_;
-        el = m_els.end();
+        el = nullptr;
         break;
       }
       switch(et->type_)
@@ -983,13 +1274,13 @@ void PlainRender::dump_const_expr(Element *e)
         case ElementType::var_type:
         case ElementType::const_type:
         case ElementType::typedef2:
-          el = m_els.find(et->type_id_);
+          el = find_el(et->type_id_);
           break;
         default:
           e_->error("unknown type %s for const_expr id %lX\n", et->TypeName(), e->id_);
           return;
       }
-      if ( el == m_els.end() )
+      if ( !el )
       {
         if ( !get_replaced_name(et->type_id_, name, &ate) )
         {
@@ -998,7 +1289,7 @@ void PlainRender::dump_const_expr(Element *e)
         } else
          break;
       }
-      et = el->second;
+      et = el;
       ate = et->ate_;
       if ( et->name_ )
         name = et->name_;
@@ -1006,13 +1297,13 @@ void PlainRender::dump_const_expr(Element *e)
   // fprintf(stderr, "ate %d", ate);
     if ( !ate )
     {
-      while(el != m_els.end())
+      while(el)
       {
-        ate = el->second->ate_;
+        ate = el->ate_;
         if ( ate )
           break;
-        if ( el->second->type_ == ElementType::typedef2 || el->second->type_ == ElementType::const_type )
-          el = m_els.find(el->second->type_id_);
+        if ( el->type_ == ElementType::typedef2 || el->type_ == ElementType::const_type )
+          el = find_el(el->type_id_);
         else
           break;
       }
@@ -1021,65 +1312,65 @@ void PlainRender::dump_const_expr(Element *e)
   if ( name.empty() )
     return;
   if ( g_opt_v )
-    fprintf(g_outf, "// TypeId %lX\n", e->id_);
-  fprintf(g_outf, "const_expr %s %s = ", name.c_str(), e->name_);
+    g_sink->put("// TypeId ").put_hex(e->id_).put('\n');
+  g_sink->put("const_expr ").put(name).put(' ').put(e->name_).put(" = ");
   if ( ate == Dwarf32::dwarf_ate::DW_ATE_boolean )
-    fprintf(g_outf, "%s", vi->second ? "true" : "false");
+    g_sink->put(vi->second ? "true" : "false");
   else if ( is_signed_ate(ate) )
-    fprintf(g_outf,"%ld", (int64_t)vi->second);
+    g_sink->put_dec((int64_t)vi->second);
   else
-    fprintf(g_outf,"0x%lX", vi->second);
-  fprintf(g_outf, ";\n");
+    g_sink->put("0x").put_hex(vi->second);
+  g_sink->put(";\n");
 }
 
 void PlainRender::dump_type_hdr(const Element &e, std::string &marg) {
   if ( e.size_ )
-   fprintf(g_outf, "%s// Size 0x%lX\n", marg.c_str(), e.size_);
+   g_sink->put(marg).put("// Size 0x").put_hex(e.size_).put('\n');
   if ( g_opt_v )
-   fprintf(g_outf, "%s// TypeId %lX\n", marg.c_str(), e.id_);
+   g_sink->put(marg).put("// TypeId ").put_hex(e.id_).put('\n');
   if ( e.link_name_ && e.link_name_ != e.name_ )
-   fprintf(g_outf, "%s// LinkageName: %s\n", marg.c_str(), e.link_name_);
-  if ( !e.fullname_.empty() )
-   fprintf(g_outf, "%s// FileName: %s\n", marg.c_str(), e.fullname_.c_str());
+   g_sink->put(marg).put("// LinkageName: ").put(e.link_name_).put('\n');
+  if ( e.get_fullname() )
+   g_sink->put(marg).put("// FileName: ").put(e.get_fullname()->c_str()).put('\n');
 }
 
-bool PlainRender::dump_nested(Element &e, int level, std::string &marg) {
+bool PlainRender::dump_nested(render_ctx &ctx, Element &e, int level, std::string &marg) {
   switch(e.type_)
     {
       case ElementType::enumerator_type:
         if ( e.enum_class_ )
-          fprintf(g_outf, "%senum class %s", marg.c_str(), e.name_);
+          g_sink->put(marg).put("enum class ").put(e.name_);
         else
-          fprintf(g_outf, "%senum %s", marg.c_str(), e.name_);
+          g_sink->put(marg).put("enum ").put(e.name_);
         if ( e.is_pure_decl() )
           return true;
-        fprintf(g_outf, " {\n");
+        g_sink->put(" {\n");
         dump_enums(&e);
-        fprintf(g_outf, "%s}", marg.c_str());
+        g_sink->put(marg).put('}');
         return true;
        break;
       case ElementType::structure_type:
-        fprintf(g_outf, "%sstruct %s", marg.c_str(), e.name_);
+        g_sink->put(marg).put("struct ").put(e.name_);
         if ( e.is_pure_decl() )
           return true;
-        dump_parents(e, marg);
-        dump_complex_type(e, level, marg);
+        dump_parents(ctx, e, marg);
+        dump_complex_type(ctx, e, level, marg);
         return true;
        break;
       case ElementType::union_type:
-        fprintf(g_outf, "%sunion %s", marg.c_str(), e.name_);
+        g_sink->put(marg).put("union ").put(e.name_);
         if ( e.is_pure_decl() )
           return true;
-        dump_complex_type(e, level, marg);
+        dump_complex_type(ctx, e, level, marg);
         return true;
        break;
       case ElementType::interface_type:
       case ElementType::class_type:
-        fprintf(g_outf, "%s%s %s", marg.c_str(), (e.type_ == ElementType::class_type) ? "class" : "interface", e.name_);
+        g_sink->put(marg).put((e.type_ == ElementType::class_type) ? "class" : "interface").put(' ').put(e.name_);
         if ( e.is_pure_decl() )
           return true;
-        dump_parents(e, marg);
-        dump_complex_type(e, level, marg);
+        dump_parents(ctx, e, marg);
+        dump_complex_type(ctx, e, level, marg);
         return true;
        break;
      default: return false;
@@ -1087,20 +1378,20 @@ bool PlainRender::dump_nested(Element &e, int level, std::string &marg) {
   return false;
 }
 
-void PlainRender::dump_types(std::list<Element> &els, struct cu *rcu)
+void PlainRender::dump_types(render_ctx &ctx, ElementList &els, struct cu *rcu)
 {
   for ( auto &e: els )
   {
-    if ( g_opt_k && e.dumped_ && !should_keep(&e) )
+    if ( g_opt_k && ctx.is_dumped(&e) && !should_keep(&e) )
       continue;
     if ( ElementType::var_type == e.type_ )
     {
-      if ( !add_var(e) )
+      if ( !add_var(ctx, e) )
       {
         if ( e.const_expr_ )
-          dump_const_expr(&e);
+          dump_const_expr(ctx, &e);
         else if ( e.spec_ )
-          dump_one_var(&e, 0);
+          dump_one_var(ctx, &e, 0);
       }
       continue;
     }
@@ -1108,15 +1399,15 @@ void PlainRender::dump_types(std::list<Element> &els, struct cu *rcu)
     {
       // check if namespace is empty
       if ( e.ns_ && e.ns_->empty ) continue;
-      fprintf(g_outf, "}; // namespace %s\n", e.name_);
+      g_sink->put("}; // namespace ").put(e.name_).put('\n');
       continue;
     }
     if ( ElementType::ns_start == e.type_ )
     {
       // check if namespace is empty
       if ( e.ns_ && e.ns_->empty ) continue;
-      put_file_hdr(rcu);
-      fprintf(g_outf, "namespace %s {\n", e.name_);
+      put_file_hdr(rcu, ctx.hdr_dumped);
+      g_sink->put("namespace ").put(e.name_).put(" {\n");
       continue;
     }
     if ( ElementType::lexical_block == e.type_ )
@@ -1136,7 +1427,7 @@ void PlainRender::dump_types(std::list<Element> &els, struct cu *rcu)
     const auto ci = m_replaced.find(e.id_);
     if ( ci != m_replaced.end() )
       continue;
-    put_file_hdr(rcu);
+    put_file_hdr(rcu, ctx.hdr_dumped);
     if ( e.has_go ) {
       auto go_attrs = m_go_attrs.find(e.id_);
       if ( go_attrs != m_go_attrs.end() )
@@ -1145,9 +1436,9 @@ void PlainRender::dump_types(std::list<Element> &els, struct cu *rcu)
         {
           const char *kname = get_go_kind(go_attrs->second.kind);
           if ( kname )
-            fprintf(g_outf, "// GoKind %d %s\n", go_attrs->second.kind, kname);
+            g_sink->put("// GoKind ").put_dec(go_attrs->second.kind).put(' ').put(kname).put('\n');
           else
-            fprintf(g_outf, "// GoKind %d\n", go_attrs->second.kind);
+            g_sink->put("// GoKind ").put_dec(go_attrs->second.kind).put('\n');
         }
         if ( go_attrs->second.rt_type )
         {
@@ -1155,16 +1446,16 @@ void PlainRender::dump_types(std::list<Element> &els, struct cu *rcu)
           if ( g_opt_s && m_snames != nullptr )
             m_snames->find_sname((uint64_t)go_attrs->second.rt_type, s_name);
           if ( s_name.empty() )
-            fprintf(g_outf, "// GoRType %p\n", go_attrs->second.rt_type);
+            g_sink->printf("// GoRType %p\n", go_attrs->second.rt_type);
           else
-            fprintf(g_outf, "// GoRType %p %s\n", go_attrs->second.rt_type, s_name.c_str());
+            g_sink->printf("// GoRType %p %s\n", go_attrs->second.rt_type, s_name.c_str());
         }
         if ( go_attrs->second.key )
-          fprintf(g_outf, "// GoKey %lX\n", go_attrs->second.key);
+          g_sink->put("// GoKey ").put_hex(go_attrs->second.key).put('\n');
         if ( go_attrs->second.elem )
-          fprintf(g_outf, "// GoElem %lX\n", go_attrs->second.elem);
+          g_sink->put("// GoElem ").put_hex(go_attrs->second.elem).put('\n');
         if ( go_attrs->second.dict_index )
-          fprintf(g_outf, "// GoDictIndex %d\n", go_attrs->second.dict_index);
+          g_sink->put("// GoDictIndex ").put_dec(go_attrs->second.dict_index).put('\n');
       }
     }
     if ( e.addr_ )
@@ -1173,37 +1464,37 @@ void PlainRender::dump_types(std::list<Element> &els, struct cu *rcu)
       if ( g_opt_s && m_snames != nullptr )
         m_snames->find_sname(e.addr_, s_name);
       if ( s_name.empty() )
-        fprintf(g_outf, "// Addr 0x%lX\n", e.addr_);
+        g_sink->put("// Addr 0x").put_hex(e.addr_).put('\n');
       else
-        fprintf(g_outf, "// Addr 0x%lX %s\n", e.addr_, s_name.c_str());
+        g_sink->put("// Addr 0x").put_hex(e.addr_).put(' ').put(s_name).put('\n');
       if ( e.type_ == ElementType::subroutine && m_locX )
       {
         uint64_t fsize = 0;
         if ( m_locX->find_dfa(e.addr_, fsize) )
-          printf("// Frame Size %lX\n", fsize);
+          g_sink->printf("// Frame Size %lX\n", fsize);
       }
     } else if ( e.type_ == ElementType::subroutine && e.has_range_ )
     {
       std::list<std::pair<uint64_t, uint64_t> > ranges;
       if ( lookup_range(e.id_, ranges) )
       {
-        fprintf(g_outf, "// Ranges: %ld\n", ranges.size());
+        g_sink->put("// Ranges: ").put_dec(ranges.size()).put('\n');
         for ( auto &r: ranges )
         {
           std::string s_name;
           if ( g_opt_s && m_snames != nullptr )
             m_snames->find_sname(e.addr_, s_name);
           if ( !s_name.empty() )
-            fprintf(g_outf, "//  %lX - %lX %s\n", r.first, r.second, s_name.c_str());
+            g_sink->put("//  ").put_hex(r.first).put(" - ").put_hex(r.second).put(' ').put(s_name).put('\n');
           else
-            fprintf(g_outf, "//  %lX - %lX\n", r.first, r.second);
+            g_sink->put("//  ").put_hex(r.first).put(" - ").put_hex(r.second).put('\n');
         }
         // try get frame size for any range
         for ( auto &r: ranges )
         {
           uint64_t fsize = 0;
           if ( m_locX->find_dfa(r.first, fsize) ) {
-            printf("// Frame Size %lX\n", fsize);
+            g_sink->printf("// Frame Size %lX\n", fsize);
             break;
           }
         }
@@ -1211,22 +1502,22 @@ void PlainRender::dump_types(std::list<Element> &els, struct cu *rcu)
     }
     std::string marg;
     dump_type_hdr(e, marg);
-    if ( dump_nested(e, 0, marg) ) e.dumped_ = true;
+    if ( dump_nested(ctx, e, 0, marg) ) ctx.dumped.insert(&e);
     else switch(e.type_)
     {
       case ElementType::subroutine:
-        dump_func(&e, 0, marg);
+        dump_func(ctx, &e, 0, marg);
         break;
       case ElementType::typedef2:
         {
           std::string tname;
           named n { e.name_ };
-          dump_type(e.type_id_, tname, &n);
+          dump_type(ctx, e.type_id_, tname, &n);
           auto tn = n.name();
           if ( tn != nullptr )
-            fprintf(g_outf, "typedef %s %s", tname.c_str(), e.name_);
+            g_sink->put("typedef ").put(tname).put(' ').put(e.name_);
           else
-            fprintf(g_outf, "typedef %s", tname.c_str());
+            g_sink->put("typedef ").put(tname);
           break;
         }
       // skip hi-level types
@@ -1236,18 +1527,18 @@ void PlainRender::dump_types(std::list<Element> &els, struct cu *rcu)
       default:
         if ( e.type_ != ElementType::pointer_type )
           e_->error("unknown type %d tag %lX\n", e.type_, e.id_);
-        fprintf(g_outf, "// unknown type %d tag %lX name %s\n", e.type_, e.id_, e.name_);
+        g_sink->put("// unknown type ").put_dec(e.type_).put(" tag ").put_hex(e.id_).put(" name ").put(e.name_).put('\n');
         {
           std::string tname;
           named n { e.name_ };
-          dump_type(e.type_id_, tname, &n);
+          dump_type(ctx, e.type_id_, tname, &n);
           auto tn = n.name();
           if ( tn != nullptr )
-            fprintf(g_outf, "%s %s", tname.c_str(), e.name_);
+            g_sink->put(tname).put(' ').put(e.name_);
           else
-            fprintf(g_outf, "%s", tname.c_str());
+            g_sink->put(tname);
         }
     }
-    fprintf(g_outf, ";\n\n");
+    g_sink->put(";\n\n");
   }
 }
@@ -1,5 +1,7 @@
 #pragma once
+#include <atomic>
 #include "TreeBuilder.h"
+#include "UnitStore.h"
 #include "debug.h"
 
 struct named
@@ -30,48 +32,116 @@ class PlainRender: public TreeBuilder
     PlainRender(ErrLog *e): TreeBuilder(e)
     {}
     virtual ~PlainRender()
-    {}
+    {
+      if ( m_store )
+        delete m_store;
+    }
   protected:
-   std::unordered_map<uint64_t, Element *> m_els;
-   std::unordered_map<uint64_t, std::list<Element *> > m_specs;
-   std::vector<Element *> m_vars;
-   std::list<std::pair<struct cu, std::list<Element> > > m_all;
+   // compilation unit collected with -g option
+   // with -M option units can be spilled to disk and loaded back on demand
+   struct unit_slot {
+     struct cu cu;
+     ElementList els;
+     uint64_t min_id = 0, max_id = 0;
+     size_t mem = 0;
+     UnitStore::pos spill;
+     bool resident = true,
+      spilled = false,
+      dirty = false,  // was changed after spilling
+      pinned = false; // range of ids overlaps with other unit, never spilled
+   };
+   OffsetIndex<Element *, mk_render> m_els;
+   OffsetIndex<uint64_t, mk_render> m_specs; // values are ids of elements, see find_el
+   // cache of rendered types for dump_type, key is type id + declarator context
+   // types which use name of declarator (function pointers & pointers to members) are not cached
+   struct type_key {
+     uint64_t id;
+     int level, off;
+     bool used;
+     bool operator==(const type_key &k) const
+     {
+       return id == k.id && level == k.level && off == k.off && used == k.used;
+     }
+   };
+   struct type_key_hash {
+     size_t operator()(const type_key &k) const
+     {
+       return std::hash<uint64_t>()(k.id ^ ((uint64_t)k.level << 48) ^ ((uint64_t)k.off << 32) ^ k.used);
+     }
+   };
+   // state of rendering of single unit, passed to all render methods
+   // with -g units are rendered in parallel and each has own
+   struct render_ctx {
+     bool hdr_dumped = false;
+     std::vector<Element *> vars; // vars of currently rendered unit
+     std::unordered_map<type_key, std::pair<std::string, bool>, type_key_hash> type_cache;
+     uint64_t named_deps = 0; // incremented when rendering depends on declarator name
+     // elements dumped in this unit - Element::dumped_ shares memory with other bits read by
+     // concurrent renders, so it is set by mark_dumped when no render is running
+     std::unordered_set<Element *> dumped;
+     inline bool is_dumped(Element *e) const
+     {
+       return e->dumped_ || dumped.count(e);
+     }
+   };
+   void mark_dumped(const std::unordered_set<Element *> &);
+   std::list<unit_slot> m_all;
+   // -M option state
+   UnitStore *m_store = nullptr;
+   size_t m_resident = 0;
+   uint64_t m_max_id = 0;
+   bool m_indexed = false, // all resident units are in m_els
+    m_no_spill = false;
+   std::vector<unit_slot *> m_by_id; // not pinned units sorted by min_id
 
    virtual void RenderUnit(int last);
    virtual bool conv2str(uint64_t key, std::string &);
-   void prepare(std::list<Element> &els);
-   std::list<Element *> *get_specs(uint64_t);
-   void dump_types(std::list<Element> &els, struct cu *);
-   void dump_vars();
-   void dump_one_var(Element *, int local);
-   void cmn_vars();
+   Element *find_el(uint64_t);
+   void prepare(ElementList &els);
+   void index_els(ElementList &els);
+   void collect_specs(ElementList &els);
+   OffsetIndex<uint64_t, mk_render>::range get_specs(uint64_t);
+   // -M option support
+   void add_unit();
+   bool make_resident(unit_slot &);
+   bool evict(unit_slot &);
+   void shrink();
+   Element *fault_in(uint64_t);
+   void render_all();
+   void render_parallel(unsigned threads);
+   void render_one(render_ctx &, unit_slot &);
+   void dump_types(render_ctx &, ElementList &els, struct cu *);
+   void dump_vars(render_ctx &);
+   void dump_one_var(render_ctx &, Element *, int local);
+   void cmn_vars(render_ctx &);
    void dump_type_hdr(const Element &, std::string &marg);
-   bool dump_nested(Element &, int, std::string &marg);
-   void dump_const_expr(Element *);
-   void dump_var(Element *, int local);
+   bool dump_nested(render_ctx &, Element &, int, std::string &marg);
+   void dump_const_expr(render_ctx &, Element *);
+   void dump_var(render_ctx &, Element *, int local);
    void dump_enums(Element *);
-   void dump_fields(Element *, int level, std::string &marg);
-   void dump_func(Element *, int level, std::string &marg);
-   void dump_lvars(Element *e, std::string &marg);
-   void dump_methods(Element *e, int level, std::string &marg);
-   void dump_method(Method *e, const Element *owner, std::string &res);
-   void dump_spec(Element *e, std::string &marg);
-   void dump_complex_type(Element &e, int, std::string &);
-   int dump_parents(Element &e, std::string &);
+   void dump_fields(render_ctx &, Element *, int level, std::string &marg);
+   void dump_func(render_ctx &, Element *, int level, std::string &marg);
+   void dump_lvars(render_ctx &, Element *e, std::string &marg);
+   void dump_methods(render_ctx &, Element *e, int level, std::string &marg);
+   void dump_method(render_ctx &, Method *e, const Element *owner, std::string &res);
+   void dump_spec(render_ctx &, Element *e, std::string &marg);
+   void dump_complex_type(render_ctx &, Element &e, int, std::string &);
+   int dump_parents(render_ctx &, Element &e, std::string &);
    int form_var_fullname(Element *e, std::string &res);
    // rustc often puts abstract_origin for vars inside inlined subs for vars in frames somewhere above
    Element *try_find_in_frames(Element *e);
    std::string &render_one_enum(std::string &s, EnumItem &en, bool);
-   std::string &render_field(Element *e, std::string &s, int level, int off = 0);
-   std::string &render_fields(Element *e, std::string &s, int level, int off = 0);
-   std::string &render_params(Element *e, uint64_t this_arg, OUT std::string &s);
-   bool dump_params_locations(std::vector<FormalParam> &, std::string &, int level = 0);
-   bool dump_type(uint64_t, std::string &, named *, int level = 0, int off = 0);
+   std::string &render_field(render_ctx &, Element *e, std::string &s, int level, int off = 0);
+   std::string &render_fields(render_ctx &, Element *e, std::string &s, int level, int off = 0);
+   std::string &render_params(render_ctx &, Element *e, uint64_t this_arg, OUT std::string &s);
+   bool dump_params_locations(render_ctx &, std::vector<FormalParam> &, std::string &, int level = 0);
+   bool dump_type(render_ctx &, uint64_t, std::string &, named *, int level = 0, int off = 0);
+   bool dump_type_(render_ctx &, uint64_t, std::string &, named *, int level, int off);
    bool is_constructor(const Element *e, const Element *owner) const;
    bool need_add_var(const Element &e) const;
-   bool add_var(Element &e);
-   uint64_t m_locsx = 0;
-   uint64_t m_adj_locsx = 0;
-   uint64_t m_locx_els = 0;
-   uint64_t m_locx_red_els = 0;
+   bool add_var(render_ctx &, Element &e);
+   std::atomic<uint64_t> m_locsx = 0;
+   std::atomic<uint64_t> m_adj_locsx = 0;
+   std::atomic<uint64_t> m_locx_els = 0;
+   std::atomic<uint64_t> m_locx_red_els = 0;
 };
@@ -0,0 +1,174 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "ShardWriter.h"
+#include "JsonWriter.h"
+
+ShardWriter *g_shards = nullptr;
+
+// writers are blocked when too much data waits to be written
+static const size_t s_max_queued = 256 << 20;
+
+ShardWriter::ShardWriter(OutSink *s, const char *dir, const char *ext, size_t size_mb, unsigned threads)
+ : m_sink(s),
+   m_dir(dir),
+   m_ext(ext),
+   m_limit(size_mb << 20),
+   m_threads(threads ? threads : 1)
+{}
+
+ShardWriter::~ShardWriter()
+{
+  if ( !m_pool.empty() )
+    finish();
+}
+
+bool ShardWriter::open()
+{
+  if ( mkdir(m_dir.c_str(), 0755) && errno != EEXIST )
+  {
+    fprintf(stderr, "cannot create directory %s, errno %d\n", m_dir.c_str(), errno);
+    return false;
+  }
+  for ( unsigned i = 0; i < m_threads; i++ )
+    m_pool.emplace_back(&ShardWriter::writer, this);
+  return true;
+}
+
+void ShardWriter::cut(const char *unit_name)
+{
+  if ( m_sink->data().empty() )
+    return;
+  m_units.push_back(unit_name ? unit_name : "");
+  if ( m_sink->data().size() >= m_limit )
+    submit();
+}
+
+void ShardWriter::submit()
+{
+  char name[32];
+  snprintf(name, sizeof(name), "%06zu.", m_shards.size());
+  job j;
+  j.file = name + m_ext;
+  m_sink->swap(j.data);
+  m_shards.push_back({ j.file, j.data.size(), std::move(m_units) });
+  m_units.clear();
+  size_t size = j.data.size();
+  {
+    std::unique_lock<std::mutex> l(m_lock);
+    m_cv.wait(l, [&] { return !m_queued || m_queued + size <= s_max_queued; });
+    m_queued += size;
+    m_jobs.push_back(std::move(j));
+  }
+  m_cv.notify_all();
+}
+
+void ShardWriter::writer()
+{
+  for ( ;; )
+  {
+    job j;
+    {
+      std::unique_lock<std::mutex> l(m_lock);
+      m_cv.wait(l, [&] { return m_done || !m_jobs.empty(); });
+      if ( m_jobs.empty() )
+        return;
+      j = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+    bool res = write_file(j);
+    {
+      std::lock_guard<std::mutex> l(m_lock);
+      m_queued -= j.data.size();
+      if ( !res )
+        m_failed = true;
+    }
+    m_cv.notify_all();
+  }
+}
+
+bool ShardWriter::write_file(const job &j)
+{
+  std::string path = m_dir + "/" + j.file;
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if ( fd == -1 )
+  {
+    fprintf(stderr, "cannot create %s, errno %d\n", path.c_str(), errno);
+    return false;
+  }
+  bool res = true;
+  // data is already in memory so write it directly without copy to sink buffer
+  const char *p = j.data.data();
+  size_t size = j.data.size();
+  while( size )
+  {
+    auto w = write(fd, p, size);
+    if ( w < 0 )
+    {
+      if ( errno == EINTR )
+        continue;
+      res = false;
+      break;
+    }
+    p += w;
+    size -= w;
+  }
+  if ( close(fd) )
+    res = false;
+  if ( !res )
+    fprintf(stderr, "cannot write %s\n", path.c_str());
+  return res;
+}
+
+bool ShardWriter::write_manifest()
+{
+  std::string path = m_dir + "/manifest.json";
+  FILE *fp = fopen(path.c_str(), "w");
+  if ( !fp )
+  {
+    fprintf(stderr, "cannot create %s\n", path.c_str());
+    return false;
+  }
+  bool res;
+  {
+    OutSink out(fp);
+    JsonWriter w(&out);
+    w.begin_obj();
+    w.key("shards").begin_arr(",\n");
+    for ( auto &s: m_shards )
+    {
+      w.begin_obj();
+      w.key("file").str(s.file.c_str());
+      w.key("size").unum(s.size);
+      w.key("units").begin_arr();
+      for ( auto &u: s.units )
+        w.str(u.c_str());
+      w.end_arr();
+      w.end_obj();
+    }
+    w.end_arr();
+    w.end_obj();
+    out.put('\n');
+    res = out.flush();
+  }
+  if ( fclose(fp) )
+    res = false;
+  return res;
+}
+
+bool ShardWriter::finish()
+{
+  if ( !m_sink->data().empty() )
+    submit();
+  {
+    std::lock_guard<std::mutex> l(m_lock);
+    m_done = true;
+  }
+  m_cv.notify_all();
+  for ( auto &t: m_pool )
+    t.join();
+  m_pool.clear();
+  bool res = write_manifest();
+  return res && !m_failed;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "OutSink.h"
+
+// -O option: output is collected in memory sink and cut into shard files on unit boundaries
+// each shard has one unit or several units until size_mb is reached
+// files are written by pool of threads, in the end manifest.json with list of shards is written
+class ShardWriter
+{
+ public:
+  ShardWriter(OutSink *s, const char *dir, const char *ext, size_t size_mb, unsigned threads);
+  ~ShardWriter();
+  // create directory & start writers
+  bool open();
+  // unit with name was rendered into sink
+  void cut(const char *unit_name);
+  // write rest of sink, wait writers & write manifest
+  bool finish();
+ protected:
+  struct job {
+    std::string file;
+    std::string data;
+  };
+  struct shard {
+    std::string file;
+    size_t size;
+    std::vector<std::string> units;
+  };
+  void submit();
+  void writer();
+  bool write_file(const job &);
+  bool write_manifest();
+  OutSink *m_sink;
+  std::string m_dir, m_ext;
+  size_t m_limit;
+  unsigned m_threads;
+  std::vector<std::thread> m_pool;
+  std::deque<job> m_jobs;
+  std::mutex m_lock;
+  std::condition_variable m_cv;
+  size_t m_queued = 0; // bytes in m_jobs
+  bool m_done = false,
+   m_failed = false;
+  std::vector<shard> m_shards;
+  std::vector<std::string> m_units; // units in current shard
+};
+
+// set in main with -O option
+extern ShardWriter *g_shards;
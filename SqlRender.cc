@@ -0,0 +1,344 @@
+#include "SqlRender.h"
+
+static const char *cr_units = "CREATE TABLE IF NOT EXISTS units ("
+ "id INTEGER PRIMARY KEY,"
+ "name TEXT,"
+ "comp_dir TEXT,"
+ "producer TEXT,"
+ "package TEXT,"
+ "lang INTEGER"
+ ");"
+;
+
+// id is offset of DIE
+static const char *cr_elements = "CREATE TABLE IF NOT EXISTS elements ("
+ "id INTEGER PRIMARY KEY,"
+ "unit INTEGER,"
+ "kind TEXT,"
+ "name TEXT,"
+ "link_name TEXT,"
+ "file TEXT,"
+ "type_id INTEGER,"
+ "owner INTEGER,"
+ "size INTEGER,"
+ "count INTEGER,"
+ "addr INTEGER,"
+ "align INTEGER,"
+ "inlined INTEGER,"
+ "access INTEGER,"
+ "dumped INTEGER,"
+ "vtbl_index INTEGER"
+ ");"
+;
+
+static const char *cr_members = "CREATE TABLE IF NOT EXISTS members ("
+ "owner INTEGER,"
+ "id INTEGER,"
+ "name TEXT,"
+ "type_id INTEGER,"
+ "offset INTEGER,"
+ "bit_offset INTEGER,"
+ "bit_size INTEGER,"
+ "access INTEGER"
+ ");"
+;
+
+static const char *cr_params = "CREATE TABLE IF NOT EXISTS params ("
+ "owner INTEGER,"
+ "idx INTEGER,"
+ "name TEXT,"
+ "type_id INTEGER,"
+ "param_id INTEGER,"
+ "ellipsis INTEGER,"
+ "artificial INTEGER"
+ ");"
+;
+
+static const char *cr_enums = "CREATE TABLE IF NOT EXISTS enums ("
+ "owner INTEGER,"
+ "name TEXT,"
+ "value INTEGER"
+ ");"
+;
+
+static const char *cr_parents = "CREATE TABLE IF NOT EXISTS parents ("
+ "owner INTEGER,"
+ "id INTEGER,"
+ "offset INTEGER,"
+ "access INTEGER,"
+ "virtual INTEGER"
+ ");"
+;
+
+// address of element or ranges of functions. end is 0 when unknown
+static const char *cr_addrs = "CREATE TABLE IF NOT EXISTS addrs ("
+ "id INTEGER,"
+ "start INTEGER,"
+ "end INTEGER"
+ ");"
+;
+
+struct sql_tab {
+ const char *stmt;
+ const char *name;
+};
+
+static const sql_tab s_tabs[] = {
+  { cr_units, "units" },
+  { cr_elements, "elements" },
+  { cr_members, "members" },
+  { cr_params, "params" },
+  { cr_enums, "enums" },
+  { cr_parents, "parents" },
+  { cr_addrs, "addrs" },
+};
+
+// created after loading, much faster than updating them on each insert
+static const sql_tab s_idx[] = {
+  { "CREATE INDEX IF NOT EXISTS idx_el_name ON elements(name);", "idx_el_name" },
+  { "CREATE INDEX IF NOT EXISTS idx_el_owner ON elements(owner);", "idx_el_owner" },
+  { "CREATE INDEX IF NOT EXISTS idx_el_unit ON elements(unit);", "idx_el_unit" },
+  { "CREATE INDEX IF NOT EXISTS idx_members ON members(owner);", "idx_members" },
+  { "CREATE INDEX IF NOT EXISTS idx_params ON params(owner);", "idx_params" },
+  { "CREATE INDEX IF NOT EXISTS idx_enums ON enums(owner);", "idx_enums" },
+  { "CREATE INDEX IF NOT EXISTS idx_parents ON parents(owner);", "idx_parents" },
+  { "CREATE INDEX IF NOT EXISTS idx_addrs ON addrs(start);", "idx_addrs" },
+};
+
+// various statements to prepare, params binded by index
+static const char *pr_ins_unit = "INSERT INTO units (name, comp_dir, producer, package, lang) VALUES (?, ?, ?, ?, ?);";
+static const char *pr_ins_el = "INSERT INTO elements (id, unit, kind, name, link_name, file, type_id, owner, size, count, addr, align, inlined, access, dumped, vtbl_index)"
+  " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
+static const char *pr_ins_member = "INSERT INTO members (owner, id, name, type_id, offset, bit_offset, bit_size, access) VALUES (?, ?, ?, ?, ?, ?, ?, ?);";
+static const char *pr_ins_param = "INSERT INTO params (owner, idx, name, type_id, param_id, ellipsis, artificial) VALUES (?, ?, ?, ?, ?, ?, ?);";
+static const char *pr_ins_enum = "INSERT INTO enums (owner, name, value) VALUES (?, ?, ?);";
+static const char *pr_ins_parent = "INSERT INTO parents (owner, id, offset, access, virtual) VALUES (?, ?, ?, ?, ?);";
+static const char *pr_ins_addr = "INSERT INTO addrs (id, start, end) VALUES (?, ?, ?);";
+
+// null pointers are stored as NULL
+static inline void bind_str(sqlite3_stmt *stmt, int idx, const char *s)
+{
+  if ( s )
+    sqlite3_bind_text(stmt, idx, s, -1, SQLITE_STATIC);
+  else
+    sqlite3_bind_null(stmt, idx);
+}
+
+static inline void bind_int(sqlite3_stmt *stmt, int idx, uint64_t v)
+{
+  sqlite3_bind_int64(stmt, idx, (sqlite3_int64)v);
+}
+
+int SqlRender::exec(const char *sql, const char *what)
+{
+  char *errmsg = nullptr;
+  int res = sqlite3_exec(m_db, sql, nullptr, nullptr, &errmsg);
+  if ( res != SQLITE_OK )
+  {
+    e_->error("sqlite error %d while %s: %s\n", res, what, errmsg ? errmsg : "");
+    if ( errmsg )
+      sqlite3_free(errmsg);
+  }
+  return res;
+}
+
+void SqlRender::step(sqlite3_stmt *stmt, const char *what)
+{
+  int res = sqlite3_step(stmt);
+  if ( res != SQLITE_DONE && !m_errors++ )
+    e_->error("sqlite error %d while insert %s: %s\n", res, what, sqlite3_errmsg(m_db));
+  sqlite3_reset(stmt);
+}
+
+void SqlRender::close()
+{
+#define FIN_STMT(f) if ( f ) { sqlite3_finalize(f); f = nullptr; }
+  FIN_STMT( m_ins_unit )
+  FIN_STMT( m_ins_el )
+  FIN_STMT( m_ins_member )
+  FIN_STMT( m_ins_param )
+  FIN_STMT( m_ins_enum )
+  FIN_STMT( m_ins_parent )
+  FIN_STMT( m_ins_addr )
+#undef FIN_STMT
+  if ( m_db )
+  {
+    sqlite3_close(m_db);
+    m_db = nullptr;
+  }
+}
+
+int SqlRender::open(const char *dbname)
+{
+  int res = sqlite3_open_v2(dbname, &m_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
+  if ( res != SQLITE_OK )
+  {
+    e_->error("cannot open sqlite db %s, error %d\n", dbname, res);
+    return res;
+  }
+  // ids of elements are offsets of DIEs so data from previous run must be dropped
+  for ( auto &t: s_tabs )
+  {
+    std::string drop = "DROP TABLE IF EXISTS ";
+    drop += t.name;
+    res = exec(drop.c_str(), "drop table");
+    if ( res != SQLITE_OK )
+      return res;
+    res = exec(t.stmt, t.name);
+    if ( res != SQLITE_OK )
+      return res;
+  }
+  // no fsync during loading
+  exec("PRAGMA synchronous=OFF", "pragma synchronous");
+  struct {
+    const char *sql;
+    sqlite3_stmt **stmt;
+  } stmts[] = {
+    { pr_ins_unit, &m_ins_unit },
+    { pr_ins_el, &m_ins_el },
+    { pr_ins_member, &m_ins_member },
+    { pr_ins_param, &m_ins_param },
+    { pr_ins_enum, &m_ins_enum },
+    { pr_ins_parent, &m_ins_parent },
+    { pr_ins_addr, &m_ins_addr },
+  };
+  for ( auto &s: stmts )
+  {
+    res = sqlite3_prepare_v2(m_db, s.sql, -1, s.stmt, nullptr);
+    if ( res != SQLITE_OK )
+    {
+      e_->error("error %d while prepare %s: %s\n", res, s.sql, sqlite3_errmsg(m_db));
+      return res;
+    }
+  }
+  return SQLITE_OK;
+}
+
+int SqlRender::finish()
+{
+  if ( !m_db )
+    return SQLITE_MISUSE;
+  int res = SQLITE_OK;
+  exec("BEGIN", "begin");
+  for ( auto &i: s_idx )
+  {
+    res = exec(i.stmt, i.name);
+    if ( res != SQLITE_OK )
+      break;
+  }
+  exec("COMMIT", "commit");
+  exec("PRAGMA synchronous=FULL", "pragma synchronous");
+  return res;
+}
+
+void SqlRender::RenderUnit(int last)
+{
+  if ( !m_db )
+    return;
+  exec("BEGIN", "begin");
+  bind_str(m_ins_unit, 1, cu.cu_name);
+  bind_str(m_ins_unit, 2, cu.cu_comp_dir);
+  bind_str(m_ins_unit, 3, cu.cu_producer);
+  bind_str(m_ins_unit, 4, cu.cu_package);
+  bind_int(m_ins_unit, 5, cu.cu_lang);
+  step(m_ins_unit, "unit");
+  m_unit_id = sqlite3_last_insert_rowid(m_db);
+  for ( auto &e: elements_ )
+  {
+    if ( e.type_ == ElementType::ns_start || e.type_ == ElementType::ns_end || e.type_ == ElementType::lexical_block )
+      continue;
+    if ( e.type_ == ElementType::var_type && e.dumped_ )
+      continue;
+    add_element(e, m_unit_id);
+    if ( e.m_comp )
+      for ( auto &m: e.m_comp->methods_ )
+        add_element(m, m_unit_id);
+  }
+  exec("COMMIT", "commit");
+}
+
+void SqlRender::add_element(Element &e, sqlite3_int64 unit)
+{
+  bind_int(m_ins_el, 1, e.id_);
+  sqlite3_bind_int64(m_ins_el, 2, unit);
+  bind_str(m_ins_el, 3, e.TypeName());
+  bind_str(m_ins_el, 4, e.name_);
+  bind_str(m_ins_el, 5, e.link_name_ != e.name_ ? e.link_name_ : nullptr);
+  auto fname = e.get_fullname();
+  bind_str(m_ins_el, 6, fname ? fname->c_str() : e.fname_);
+  bind_int(m_ins_el, 7, e.type_id_);
+  bind_int(m_ins_el, 8, e.owner_ ? e.owner_->id_ : 0);
+  bind_int(m_ins_el, 9, e.size_);
+  bind_int(m_ins_el, 10, e.count_);
+  bind_int(m_ins_el, 11, e.addr_);
+  bind_int(m_ins_el, 12, e.align_);
+  bind_int(m_ins_el, 13, e.inlined_);
+  bind_int(m_ins_el, 14, e.access_);
+  bind_int(m_ins_el, 15, e.dumped_);
+  if ( e.type_ == ElementType::method )
+    bind_int(m_ins_el, 16, static_cast<Method &>(e).vtbl_index_);
+  else
+    sqlite3_bind_null(m_ins_el, 16);
+  step(m_ins_el, "element");
+  // addresses
+  if ( e.addr_ )
+  {
+    bind_int(m_ins_addr, 1, e.id_);
+    bind_int(m_ins_addr, 2, e.addr_);
+    bind_int(m_ins_addr, 3, 0);
+    step(m_ins_addr, "addr");
+  } else if ( e.has_range_ )
+  {
+    std::list<std::pair<uint64_t, uint64_t> > ranges;
+    if ( lookup_range(e.id_, ranges) )
+      for ( auto &r: ranges )
+      {
+        bind_int(m_ins_addr, 1, e.id_);
+        bind_int(m_ins_addr, 2, r.first);
+        bind_int(m_ins_addr, 3, r.second);
+        step(m_ins_addr, "addr");
+      }
+  }
+  if ( !e.m_comp )
+    return;
+  for ( auto &m: e.m_comp->members_ )
+  {
+    bind_int(m_ins_member, 1, e.id_);
+    bind_int(m_ins_member, 2, m.id_);
+    bind_str(m_ins_member, 3, m.name_);
+    bind_int(m_ins_member, 4, m.type_id_ ? get_replaced_type(m.type_id_) : 0);
+    bind_int(m_ins_member, 5, m.offset_);
+    sqlite3_bind_int(m_ins_member, 6, m.bit_offset_);
+    sqlite3_bind_int(m_ins_member, 7, m.bit_size_);
+    sqlite3_bind_int(m_ins_member, 8, m.access_);
+    step(m_ins_member, "member");
+  }
+  int idx = 0;
+  for ( auto &p: e.m_comp->params_ )
+  {
+    bind_int(m_ins_param, 1, e.id_);
+    sqlite3_bind_int(m_ins_param, 2, idx++);
+    bind_str(m_ins_param, 3, p.name);
+    bind_int(m_ins_param, 4, p.id);
+    bind_int(m_ins_param, 5, p.param_id);
+    sqlite3_bind_int(m_ins_param, 6, p.ellipsis);
+    sqlite3_bind_int(m_ins_param, 7, p.art_);
+    step(m_ins_param, "param");
+  }
+  for ( auto &en: e.m_comp->enums_ )
+  {
+    bind_int(m_ins_enum, 1, e.id_);
+    bind_str(m_ins_enum, 2, en.name);
+    bind_int(m_ins_enum, 3, en.value);
+    step(m_ins_enum, "enum");
+  }
+  for ( auto &p: e.m_comp->parents_ )
+  {
+    bind_int(m_ins_parent, 1, e.id_);
+    bind_int(m_ins_parent, 2, get_replaced_type(p.id));
+    bind_int(m_ins_parent, 3, p.offset);
+    sqlite3_bind_int(m_ins_parent, 4, p.access);
+    sqlite3_bind_int(m_ins_parent, 5, p.virtual_);
+    step(m_ins_parent, "parent");
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <sqlite3.h>
+#include "TreeBuilder.h"
+
+// bulk load of types, functions & vars into sqlite db
+// each unit is loaded in own transaction, indexes are created in finish()
+class SqlRender: public TreeBuilder
+{
+  public:
+    SqlRender(ErrLog *e): TreeBuilder(e)
+    {}
+    virtual ~SqlRender()
+    {
+      close();
+    }
+    // returns SQLITE_OK on success, tables with old content are recreated
+    int open(const char *dbname);
+    // must be called after all units were processed
+    int finish();
+  protected:
+    virtual void RenderUnit(int last);
+    void add_element(Element &, sqlite3_int64 unit);
+    int exec(const char *sql, const char *what);
+    void step(sqlite3_stmt *, const char *what);
+    void close();
+    sqlite3 *m_db = nullptr;
+    // prepared statements
+    sqlite3_stmt *m_ins_unit = nullptr;
+    sqlite3_stmt *m_ins_el = nullptr;
+    sqlite3_stmt *m_ins_member = nullptr;
+    sqlite3_stmt *m_ins_param = nullptr;
+    sqlite3_stmt *m_ins_enum = nullptr;
+    sqlite3_stmt *m_ins_parent = nullptr;
+    sqlite3_stmt *m_ins_addr = nullptr;
+    sqlite3_int64 m_unit_id = 0;
+    int m_errors = 0;
+};
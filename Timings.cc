@@ -0,0 +1,94 @@
+#include <vector>
+#include <algorithm>
+#include "Timings.h"
+#include "MemStats.h"
+
+int g_timings = 0;
+PhaseTime g_phase_times[tp_max];
+RelocTimes g_reloc_times;
+
+static uint64_t s_start_ns = 0;
+static std::vector<UnitTime> s_units;
+
+static const char *const s_phase_names[tp_max] = {
+  "load",
+  "decompress",
+  "relocs",
+  "rnglists",
+  "frames",
+  "abbrevs",
+  "parse",
+  "render",
+};
+
+void start_timings(int top)
+{
+  g_timings = top;
+  s_start_ns = mono_ns();
+}
+
+UnitTime *add_unit_time(uint64_t off, uint64_t bytes)
+{
+  s_units.emplace_back();
+  auto &res = s_units.back();
+  res.off = off;
+  res.bytes = bytes;
+  return &res;
+}
+
+UnitTime *cur_unit_time()
+{
+  if ( s_units.empty() ) return nullptr;
+  return &s_units.back();
+}
+
+// per second rate
+static inline uint64_t per_sec(uint64_t v, uint64_t ns)
+{
+  if ( !ns ) return 0;
+  return (uint64_t)((double)v * 1e9 / ns);
+}
+
+static void dump_unit(FILE *fp, const UnitTime &u)
+{
+  fprintf(fp, "{\"name\":");
+  fput_json_str(fp, u.name.c_str());
+  fprintf(fp, ",\"off\":%ld,\"bytes\":%ld,\"dies\":%ld,\"parse_ns\":%ld,\"render_ns\":%ld,\"dies_per_sec\":%ld,\"bytes_per_sec\":%ld}",
+    u.off, u.bytes, u.dies, u.parse_ns, u.render_ns, per_sec(u.dies, u.parse_ns), per_sec(u.bytes, u.parse_ns));
+}
+
+void dump_timings(FILE *fp)
+{
+  fprintf(fp, "{\"total_ns\":%ld,\"phases\":{", mono_ns() - s_start_ns);
+  for ( int i = 0; i < tp_max; i++ )
+    fprintf(fp, "%s\"%s\":{\"ns\":%ld,\"calls\":%ld}", i ? "," : "", s_phase_names[i], g_phase_times[i].ns, g_phase_times[i].calls);
+  uint64_t dies = 0, bytes = 0, parse_ns = 0, render_ns = 0;
+  for ( auto &u: s_units )
+  {
+    dies += u.dies;
+    bytes += u.bytes;
+    parse_ns += u.parse_ns;
+    render_ns += u.render_ns;
+  }
+  fprintf(fp, "},\"units\":{\"count\":%ld,\"dies\":%ld,\"bytes\":%ld,\"parse_ns\":%ld,\"render_ns\":%ld,\"dies_per_sec\":%ld,\"bytes_per_sec\":%ld}",
+    s_units.size(), dies, bytes, parse_ns, render_ns, per_sec(dies, parse_ns), per_sec(bytes, parse_ns));
+  if ( g_reloc_times.relocs )
+    fprintf(fp, ",\"reloc_classify\":{\"relocs\":%ld,\"table_ns\":%ld,\"chain_ns\":%ld}",
+      g_reloc_times.relocs, g_reloc_times.table_ns, g_reloc_times.chain_ns);
+  // top N by parse + render time
+  std::vector<const UnitTime *> top;
+  top.reserve(s_units.size());
+  for ( auto &u: s_units )
+    top.push_back(&u);
+  size_t n = std::min(top.size(), (size_t)g_timings);
+  std::partial_sort(top.begin(), top.begin() + n, top.end(), [](const UnitTime *a, const UnitTime *b) {
+    return a->parse_ns + a->render_ns > b->parse_ns + b->render_ns;
+  });
+  fprintf(fp, ",\"slowest\":[");
+  for ( size_t i = 0; i < n; i++ )
+  {
+    if ( i ) fputc(',', fp);
+    dump_unit(fp, *top[i]);
+  }
+  fprintf(fp, "]}\n");
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <time.h>
+
+// per-phase timing for --timings option
+enum TimePhase {
+  tp_load,       // ELFIO load
+  tp_decompress, // compressed sections
+  tp_relocs,     // try_apply_debug_relocs
+  tp_rnglists,
+  tp_frames,
+  tp_abbrevs,
+  tp_parse,      // DIEs parsing without abbrevs loading
+  tp_render,     // RenderUnit
+  tp_max
+};
+
+struct PhaseTime {
+  uint64_t ns = 0, calls = 0;
+};
+
+// 0 - disabled, else how many slowest units to report
+extern int g_timings;
+extern PhaseTime g_phase_times[tp_max];
+
+inline uint64_t mono_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// adds time spent in scope to phase and optionally to some unit counter
+class PhaseTimer
+{
+ public:
+  PhaseTimer(TimePhase p, uint64_t *add_to = nullptr)
+   : m_p(p), m_add(add_to)
+  {
+    if ( g_timings ) m_start = mono_ns();
+  }
+  ~PhaseTimer()
+  {
+    if ( !g_timings ) return;
+    auto delta = mono_ns() - m_start;
+    g_phase_times[m_p].ns += delta;
+    g_phase_times[m_p].calls++;
+    if ( m_add ) *m_add += delta;
+  }
+ protected:
+  TimePhase m_p;
+  uint64_t *m_add;
+  uint64_t m_start = 0;
+};
+
+// reloc types of applied sections classified both by lookup table and by chain of is_XX_reloc predicates
+struct RelocTimes {
+  uint64_t relocs = 0, table_ns = 0, chain_ns = 0;
+};
+extern RelocTimes g_reloc_times;
+
+struct UnitTime {
+  uint64_t off, bytes,
+   dies = 0,
+   parse_ns = 0,
+   render_ns = 0;
+  std::string name;
+};
+
+void start_timings(int top);
+// called when parsing of new unit started
+UnitTime *add_unit_time(uint64_t off, uint64_t bytes);
+// last added unit or null
+UnitTime *cur_unit_time();
+// dump json report
+void dump_timings(FILE *);
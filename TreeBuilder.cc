@@ -1,5 +1,6 @@
 #include "TreeBuilder.h"
 #include "dwarf32.h"
+#include "Timings.h"
 
 // with name as std::string (args -kfxF)
 // codeql/extractor:       total heap usage: 2,471,773 allocs, 2,471,773 frees, 383,592,855 bytes allocated
@@ -42,6 +43,181 @@ int TreeBuilder::exclude_types(ElementType et, Element &e)
   return 1;
 }
 
+uint64_t TreeBuilder::name_key(ElementType et, const char *name)
+{
+  if ( in_string_pool(name) )
+    return ((name - (const char *)debug_str_) << name_key_shift) | et;
+  auto res = m_name_ids.emplace(name, m_name_ids.size());
+  return (res.first->second << name_key_shift) | name_key_interned | et;
+}
+
+// like name_key but don't intern new names - they cannot be in db anyway
+bool TreeBuilder::find_name_key(ElementType et, const char *name, uint64_t &key) const
+{
+  if ( !name )
+    return false;
+  if ( in_string_pool(name) )
+  {
+    key = ((name - (const char *)debug_str_) << name_key_shift) | et;
+    return true;
+  }
+  auto ni = m_name_ids.find(name);
+  if ( ni == m_name_ids.end() )
+    return false;
+  key = (ni->second << name_key_shift) | name_key_interned | et;
+  return true;
+}
+
+static inline void hash_mix(uint64_t &h, uint64_t v)
+{
+  h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+}
+
+static inline void hash_mix(uint64_t &h, const char *s)
+{
+  hash_mix(h, s ? std::hash<std::string_view>()(s) : 0);
+}
+
+static inline bool is_aggregate(TreeBuilder::ElementType et)
+{
+  return et == TreeBuilder::structure_type || et == TreeBuilder::class_type ||
+         et == TreeBuilder::union_type || et == TreeBuilder::enumerator_type ||
+         et == TreeBuilder::interface_type;
+}
+
+// key of layout in NSpace::m_variants
+static inline uint64_t variant_key(uint64_t key, uint64_t hash)
+{
+  hash_mix(key, hash);
+  return key;
+}
+
+// bottom-up structural hash of type with id
+uint64_t TreeBuilder::type_hash(uint64_t id, int depth)
+{
+  if ( !id ) return 0;
+  auto ei = m_hash_els.find(id);
+  if ( ei == m_hash_els.end() ) return 1; // type from another unit
+  Element *e = ei->second;
+  uint64_t h = e->type_;
+  hash_mix(h, e->name_);
+  // named aggregates are identified by name - they get own hash at top level
+  // forward declarations too, so reference to type is the same in units where it is complete or not
+  if ( depth && e->name_ && is_aggregate(e->type_) ) return h;
+  if ( depth > 16 )
+  {
+    m_hash_truncs++;
+    return h;
+  }
+  // hashes from truncated subtrees depend on depth, so they are reused only at top level
+  auto hi = m_type_hash.find(id);
+  if ( hi != m_type_hash.end() && (!depth || !m_trunc_hash.count(id)) ) return hi->second;
+  auto truncs = m_hash_truncs;
+  hash_mix(h, e->size_);
+  hash_mix(h, e->count_);
+  hash_mix(h, e->ate_);
+  hash_mix(h, type_hash(e->type_id_, depth + 1));
+  if ( e->m_comp )
+  {
+    for ( auto &m: e->m_comp->members_ )
+    {
+      hash_mix(h, m.name_);
+      hash_mix(h, m.offset_);
+      hash_mix(h, ((uint64_t)m.bit_size_ << 32) | (uint32_t)m.bit_offset_);
+      hash_mix(h, type_hash(m.type_id_, depth + 1));
+    }
+    for ( auto &p: e->m_comp->parents_ )
+    {
+      hash_mix(h, p.offset);
+      hash_mix(h, type_hash(p.id, depth + 1));
+    }
+    for ( auto &en: e->m_comp->enums_ )
+    {
+      hash_mix(h, en.name);
+      hash_mix(h, en.value);
+    }
+    for ( auto &p: e->m_comp->params_ )
+      hash_mix(h, type_hash(p.id, depth + 1));
+  }
+  if ( truncs != m_hash_truncs )
+  {
+    if ( depth )
+      return h;
+    m_trunc_hash.insert(id);
+  }
+  m_type_hash[id] = h;
+  return h;
+}
+
+void TreeBuilder::calc_type_hashes()
+{
+  for ( auto &e: elements_ )
+    if ( !is_ns(e) ) m_hash_els.add(e.id_, &e);
+  for ( auto &e: elements_ )
+  {
+    if ( !e.name_ || is_ns(e) || e.level_ > 1 ) continue;
+    if ( !exclude_types(e.type_, e) ) continue;
+    type_hash(e.id_, 0);
+  }
+}
+
+void TreeBuilder::get_shape(const Element &e, type_shape &res)
+{
+  res.size = e.size_;
+  res.items.clear();
+  if ( !e.m_comp ) return;
+  for ( auto &m: e.m_comp->members_ )
+    res.items.push_back( { m.name_, m.offset_ } );
+  for ( auto &p: e.m_comp->parents_ )
+    res.items.push_back( { nullptr, p.offset } );
+  for ( auto &en: e.m_comp->enums_ )
+    res.items.push_back( { en.name, en.value } );
+}
+
+static inline bool same_name(const char *a, const char *b)
+{
+  if ( a == b ) return true;
+  return a && b && !strcmp(a, b);
+}
+
+bool TreeBuilder::same_shape(const Element &e, const type_shape &sh)
+{
+  size_t count = e.m_comp ? e.m_comp->members_.size() + e.m_comp->parents_.size() + e.m_comp->enums_.size() : 0;
+  if ( e.size_ != sh.size || count != sh.items.size() ) return false;
+  if ( !count ) return true;
+  auto si = sh.items.cbegin();
+  for ( auto &m: e.m_comp->members_ )
+  {
+    if ( m.offset_ != si->second || !same_name(m.name_, si->first) ) return false;
+    ++si;
+  }
+  for ( auto &p: e.m_comp->parents_ )
+  {
+    if ( p.offset != si->second || si->first ) return false;
+    ++si;
+  }
+  for ( auto &en: e.m_comp->enums_ )
+  {
+    if ( en.value != si->second || !same_name(en.name, si->first) ) return false;
+    ++si;
+  }
+  return true;
+}
+
+// 64bit hashes can collide, so layout is compared too
+bool TreeBuilder::is_variant(NSpace *ns, uint64_t key, uint64_t hash, const Element &e) const
+{
+  auto vi = ns->m_variants.find(variant_key(key, hash));
+  return vi != ns->m_variants.end() && same_shape(e, vi->second);
+}
+
+void TreeBuilder::add_variant(NSpace *ns, uint64_t key, uint64_t hash, const Element &e)
+{
+  auto vk = variant_key(key, hash);
+  if ( ns->m_variants.count(vk) ) return;
+  get_shape(e, ns->m_variants[vk]);
+}
+
 // add dumped types to m_dumped_db
 int TreeBuilder::merge_dumped()
 {
@@ -65,27 +241,23 @@ int TreeBuilder::merge_dumped()
       continue; // we heed only high-level types definitions
     size_t rank = e.get_rank();
     auto ns = e.ns_;
-    auto ename = e.mangled();
-    if ( in_string_pool(ename) )
+    auto key = name_key(e.type_, e.mangled());
+    auto hash = get_type_hash(e.id_);
+    // remember each dumped layout so ODR variants are dumped once
+    if ( hash && (!e.dumped_ || should_keep(&e)) )
+      add_variant(ns, key, hash, e);
+    auto added = ns->m_dumped_db.find(key);
+    if ( added != ns->m_dumped_db.end() )
     {
-      UniqName key { e.type_, ename };
-      auto added = ns->m_dumped_db.find(key);
-      if ( added != ns->m_dumped_db.end() )
-      {
-        if ( e.dumped_ && rank <= added->second.second )
-          continue; // this type already in m_dumped_db
-      }
-      ns->m_dumped_db[key] = { e.id_, rank };
-    } else {
-      UniqName2 key { e.type_, ename };
-      auto added = ns->m_dumped_db2.find(key);
-      if ( added != ns->m_dumped_db2.end() )
-      {
-        if ( e.dumped_ && rank <= added->second.second )
-          continue; // this type already in m_dumped_db2
-      }
-      ns->m_dumped_db2[key] = { e.id_, rank };
+      if ( hash && hash == added->second.hash && is_variant(ns, key, hash, e) )
+        continue; // exactly the same type already in m_dumped_db
+      if ( e.dumped_ && rank <= added->second.rank )
+        continue; // this type already in m_dumped_db
     }
+    ns->m_dumped_db[key] = { e.id_, rank, hash };
+    // layout from m_dumped_db is known variant too
+    if ( hash )
+      add_variant(ns, key, hash, e);
     res++; 
   }
   return res;
@@ -141,7 +313,7 @@ uint64_t TreeBuilder::calc_redudant_locs(const param_loc &pl)
   return res;
 }
 
-void TreeBuilder::dump_location(std::string &s, param_loc &pl)
+void TreeBuilder::dump_location(std::string &s, const param_loc &pl)
 {
   int idx = 0;
   char buf[40];
@@ -390,22 +562,21 @@ int TreeBuilder::should_keep(Element *e)
     return 1;
   size_t old_rank = 0;
   auto ns = e->ns_;
-  auto ename = e->mangled();
-  if ( in_string_pool(ename) )
+  uint64_t key;
+  if ( !find_name_key(e->type_, e->mangled(), key) )
+    return 0;
+  const auto ci = ns->m_dumped_db.find(key);
+  if ( ci == ns->m_dumped_db.cend() )
+    return 0;
+  old_rank = ci->second.rank;
+  auto hash = get_type_hash(e->id_);
+  if ( hash && ci->second.hash )
   {
-    UniqName key { e->type_, ename };
-    const auto ci = ns->m_dumped_db.find(key);
-    if ( ci == ns->m_dumped_db.cend() )
-      return 0;
-    old_rank = ci->second.second;
-  } else {
-    if ( !ename )
-      return 0;
-    UniqName2 key { e->type_, ename };
-    const auto ci = ns->m_dumped_db2.find(key);
-    if ( ci == ns->m_dumped_db2.cend() )
-      return 0;
-    old_rank = ci->second.second;
+    if ( is_variant(ns, key, hash, *e) )
+      return 0; // exact duplicate of already dumped layout
+    // both complete but have different layout - ODR violation, so dump this one too
+    if ( old_rank && !e->is_pure_decl() && e->get_rank() )
+      return 1;
   }
   return e->get_rank() > old_rank;
 }
@@ -450,21 +621,13 @@ int TreeBuilder::check_dumped_type(Element &e)
   auto ns = e.ns_;
   if ( !ns ) return 0;
   auto name = e.mangled();
-  if ( in_string_pool(name) )
-  {
-    UniqName key { current_element_type_, name };
-    const auto ci = ns->m_dumped_db.find(key);
-    if ( ci == ns->m_dumped_db.cend() )
-      return 0;
-    rep_id = ci->second.first;
-  } else {
- // fprintf(stderr, "check_dumped_type %p\n", name);
-    UniqName2 key { current_element_type_, name };
-    const auto ci = ns->m_dumped_db2.find(key);
-    if ( ci == ns->m_dumped_db2.cend() )
-      return 0;
-    rep_id = ci->second.first;
-  }
+  uint64_t key;
+  if ( !find_name_key(current_element_type_, name, key) )
+    return 0;
+  const auto ci = ns->m_dumped_db.find(key);
+  if ( ci == ns->m_dumped_db.cend() )
+    return 0;
+  rep_id = ci->second.id;
   if ( g_opt_k )
   {
     // we can`t use get_rank here bcs we know only type and name
@@ -483,7 +646,7 @@ int TreeBuilder::check_dumped_type(Element &e)
   if ( current_element_type_ != subroutine )
   {
     dumped_type dt { current_element_type_, name, elements_.back().ate_, rep_id };
-    m_replaced[elements_.back().id_] = dt;
+    m_replaced.add(elements_.back().id_, dt);
   } else {
    // mark current function as dumped
    elements_.back().dumped_ = true;
@@ -591,29 +754,29 @@ const char *get_cu_name(int c)
   return nullptr;
 }
 
-void TreeBuilder::put_file_hdr(struct cu *c)
+void TreeBuilder::put_file_hdr(struct cu *c, bool &hdr_dumped)
 {
-  if ( m_hdr_dumped )
+  if ( hdr_dumped )
     return;
   if ( c->cu_name )
-    fprintf(g_outf, "\n// Name: %s\n", c->cu_name);
+    g_sink->put("\n// Name: ").put(c->cu_name).put('\n');
   if ( c->cu_comp_dir )
-    fprintf(g_outf, "// CompDir: %s\n", c->cu_comp_dir);
+    g_sink->put("// CompDir: ").put(c->cu_comp_dir).put('\n');
   if ( c->cu_lang )
   {
     auto lang = get_cu_name(c->cu_lang);
     if ( lang )
-      fprintf(g_outf, "// Language: %s\n", lang);
+      g_sink->put("// Language: ").put(lang).put('\n');
     else
-      fprintf(g_outf, "// Language: 0x%X\n", c->cu_lang);
+      g_sink->printf("// Language: 0x%X\n", c->cu_lang);
   }
   if ( c->cu_package )
-    fprintf(g_outf, "// Package: %s\n", c->cu_package);
+    g_sink->put("// Package: ").put(c->cu_package).put('\n');
   if ( c->cu_producer )
-    fprintf(g_outf, "// Producer: %s\n", c->cu_producer);
+    g_sink->put("// Producer: ").put(c->cu_producer).put('\n');
   if ( c->cu_base_addr )
-    fprintf(g_outf, "// base_addr: %lX\n", c->cu_base_addr);
-  m_hdr_dumped = true;
+    g_sink->put("// base_addr: ").put_hex(c->cu_base_addr).put('\n');
+  hdr_dumped = true;
 }
 
 void TreeBuilder::put_file_hdr()
@@ -622,10 +785,40 @@ void TreeBuilder::put_file_hdr()
     return;
   if ( elements_.empty() )
     return;
-  put_file_hdr(&cu);
+  put_file_hdr(&cu, m_hdr_dumped);
 }
 
 // called on each processed compilation unit
+// heap memory owned by element besides chunks of ElementList
+size_t TreeBuilder::ElementList::el_heap(Element &e)
+{
+  size_t res = 0;
+  if ( e.cold_ )
+    res += sizeof(*e.cold_) + e.cold_->fullname_.capacity();
+  auto c = e.m_comp;
+  if ( !c ) return res;
+  res += c->parents_.capacity() * sizeof(c->parents_[0]) +
+    c->enums_.capacity() * sizeof(c->enums_[0]) + c->params_.capacity() * sizeof(c->params_[0]) +
+    (c->lvars_.capacity() + c->nested.capacity()) * sizeof(void *) +
+    c->lvar_locs_.capacity() * sizeof(c->lvar_locs_[0]);
+  for ( auto &m: c->members_ )
+    res += el_heap(m);
+  for ( auto &m: c->methods_ )
+    res += el_heap(m);
+  return res;
+}
+
+void TreeBuilder::ElementList::account()
+{
+  size_t heap = 0;
+  for ( auto &e: *this )
+    heap += el_heap(e);
+  if ( heap_ )
+    g_mem[mk_compounds].sub(heap_, 0);
+  g_mem[mk_compounds].add(heap, 0);
+  heap_ = heap;
+}
+
 void TreeBuilder::ProcessUnit(int last)
 {
   if ( !m_stack.empty() )
@@ -634,10 +827,31 @@ void TreeBuilder::ProcessUnit(int last)
     m_stack = {};
   }
   m_hdr_dumped = false;
-  RenderUnit(last);
+  if ( g_mem_stats )
+    elements_.account();
+  // with -g m_dumped_db is not used, so types are deduplicated by name only
+  if ( g_opt_k && !g_opt_g )
+    calc_type_hashes();
+  {
+    // with -g all units are rendered with last one
+    auto ut = g_timings ? cur_unit_time() : nullptr;
+    PhaseTimer pt(tp_render, ut ? &ut->render_ns : nullptr);
+    if ( ut && cu.cu_name ) ut->name = cu.cu_name;
+    RenderUnit(last);
+  }
+  if ( g_shards )
+    g_shards->cut(cu.cu_name);
+  // with -d parser writes to g_outf directly, so keep order of output
+  if ( g_opt_d && g_sink )
+    g_sink->flush();
+  if ( g_mem_stats )
+    dump_mem_stats(stderr, cu.cu_name ? cu.cu_name : "");
   if ( !g_opt_g )
   {
     merge_dumped();
+    m_hash_els.clear();
+    m_type_hash.clear();
+    m_trunc_hash.clear();
     m_go_attrs.clear();
     m_lvalues.clear();
     m_rng.clear(); m_rng2.clear();
@@ -703,8 +917,8 @@ int TreeBuilder::add2stack(int regged)
   if ( last.type_ == ns_start && !recent_ )
   {
     ns_count++;
-    if ( g_opt_v )
-      fprintf(g_outf, "// ns_start %d at %lX\n", ns_count, last.id_);
+    if ( g_opt_v && g_sink )
+      g_sink->printf("// ns_start %d at %lX\n", ns_count, last.id_);
   } else if ( last.type_ == lexical_block && !recent_ ) {
     // fprintf(g_outf, "// lexical_block %d at %lX\n", ns_count, last.id_);
     ns_count++;
@@ -737,14 +951,14 @@ void TreeBuilder::pop_stack(uint64_t off)
   if ( last->type_ == ns_start )
   {
     ns_count--;
-    elements_.push_back(Element(ns_end, last->type_id_, last->level_, get_owner(), top_ns()));
+    elements_.emplace_back(ns_end, last->type_id_, last->level_, get_owner(), top_ns());
     elements_.back().name_ = last->name_;
     if ( ns_stack.empty() )
       e_->warning("ns stack is empty, off %lX, ns_count %d\n", off, ns_count);
     else
       ns_stack.pop();
-    if ( g_opt_v )
-      fprintf(g_outf, "// ns_end %s %d off %lX\n", last->name_, ns_count, off);
+    if ( g_opt_v && g_sink )
+      g_sink->printf("// ns_end %s %d off %lX\n", last->name_, ns_count, off);
   } else if ( last->type_ == lexical_block )
   {
     // fprintf(g_outf, "// pop lexical_block %lX, ns_count %d\n", last->id_, ns_count);
@@ -790,7 +1004,7 @@ bool TreeBuilder::AddFormalParam(uint64_t tag_id, int level, bool ell)
   if ( top->level_ != level - 1 )
     return false;
   if ( !top->m_comp )
-    top->m_comp = new Compound();
+    top->m_comp = elements_.new_compound();
 
   top->m_comp->params_.push_back({NULL, tag_id, 0, ell});
   return true;
@@ -877,7 +1091,7 @@ bool TreeBuilder::AddNested(Element &n) {
    return false;
  if ( !need_nested() ) return false;
  // check comp
- if ( !n.owner_->m_comp ) n.owner_->m_comp = new Compound();
+ if ( !n.owner_->m_comp ) n.owner_->m_comp = elements_.new_compound();
  n.owner_->m_comp->nested.push_back(&n);
  return true;
 }
@@ -904,14 +1118,14 @@ void TreeBuilder::AddElement(ElementType element_type, uint64_t tag_id, int leve
       } else {
         auto &top = m_stack.top();
         if ( !top->m_comp )
-          top->m_comp = new Compound();
-        top->m_comp->members_.push_back(Element(element_type, tag_id, level, owner, nullptr));
+          top->m_comp = elements_.new_compound();
+        top->m_comp->members_.emplace_back(element_type, tag_id, level, owner, nullptr);
       }
       if ( element_type == ElementType::variant_type )
       {
         auto &top = m_stack.top();
         top->m_comp->members_.back().type_id_ = tag_id;
-        elements_.push_back(Element(element_type, tag_id, level, owner, ns));
+        elements_.emplace_back(element_type, tag_id, level, owner, ns);
         ns->empty = false;
         recent_ = nullptr;
       }
@@ -930,7 +1144,7 @@ void TreeBuilder::AddElement(ElementType element_type, uint64_t tag_id, int leve
       } else {
         auto &top = m_stack.top();
         if ( !top->m_comp )
-          top->m_comp = new Compound();
+          top->m_comp = elements_.new_compound();
         top->m_comp->parents_.push_back({tag_id, 0});
       }
       break;
@@ -953,7 +1167,7 @@ void TreeBuilder::AddElement(ElementType element_type, uint64_t tag_id, int leve
       } else {
         auto &top = m_stack.top();
         if ( !top->m_comp )
-          top->m_comp = new Compound();
+          top->m_comp = elements_.new_compound();
         top->m_comp->enums_.push_back({NULL, 0});
       }
       break;
@@ -981,11 +1195,11 @@ void TreeBuilder::AddElement(ElementType element_type, uint64_t tag_id, int leve
             return;
           }
         }
-        elements_.push_back(Element(element_type, tag_id, level, owner, ns));
+        elements_.emplace_back(element_type, tag_id, level, owner, ns);
         ns->empty = false;
         last_var_ = &elements_.back();
         if ( !owner->m_comp )
-          owner->m_comp = new Compound(); // valgring points here as leak 
+          owner->m_comp = elements_.new_compound();
         if ( owner->type_ == ElementType::method && g_opt_v )
           e_->warning("add var %lX to method %lX\n", tag_id, owner->id_);
         owner->m_comp->lvars_.push_back(last_var_); // valgring points here as leak
@@ -997,7 +1211,7 @@ void TreeBuilder::AddElement(ElementType element_type, uint64_t tag_id, int leve
           current_element_type_ = ElementType::none;
           return;
         }
-        elements_.push_back(Element(element_type, tag_id, level, owner, ns));
+        elements_.emplace_back(element_type, tag_id, level, owner, ns);
         ns->empty = false;
         last_var_ = &elements_.back();
       }
@@ -1009,8 +1223,8 @@ void TreeBuilder::AddElement(ElementType element_type, uint64_t tag_id, int leve
       {
         auto &top = m_stack.top();
         if ( !top->m_comp )
-          top->m_comp = new Compound();
-        top->m_comp->methods_.push_back(Method(tag_id, level, owner, nullptr));
+          top->m_comp = elements_.new_compound();
+        top->m_comp->methods_.emplace_back(tag_id, level, owner, nullptr);
         // fprintf(g_outf, "add method to %s parent tid %lX type %d tid %lX\n", top->name_, top->id_, top->type_, tag_id);
         current_element_type_ = ElementType::method;
         recent_ = &top->m_comp->methods_.back();
@@ -1018,7 +1232,7 @@ void TreeBuilder::AddElement(ElementType element_type, uint64_t tag_id, int leve
       }
       // fall to default
     default:
-      elements_.push_back(Element(element_type, tag_id, level, owner, ns));
+      elements_.emplace_back(element_type, tag_id, level, owner, ns);
       if ( level ) AddNested(elements_.back());
       ns->empty = false;
       if ( element_type == ElementType::subroutine ||
@@ -1048,16 +1262,16 @@ void TreeBuilder::SetFilename(std::string &fn, const char *fname)
       return;
     }
     last_var_->fname_ = fname;
-    last_var_->fullname_ = std::move(fn);
+    last_var_->cold().fullname_ = std::move(fn);
     return;
   }
   if ( recent_ )
   {
     recent_->fname_ = fname;
-    recent_->fullname_ = std::move(fn);
+    recent_->cold().fullname_ = std::move(fn);
   } else {
     elements_.back().fname_ = fname;
-    elements_.back().fullname_ = std::move(fn);
+    elements_.back().cold().fullname_ = std::move(fn);
   }
 }
 
@@ -1625,7 +1839,7 @@ void TreeBuilder::SetContainingType(uint64_t ct)
     e_->warning("Can't set ContainingType when element list is empty\n");
     return;
   }
-  elements_.back().cont_type_ = ct;
+  elements_.back().cold().cont_type_ = ct;
 }
 
 void TreeBuilder::SetLocX(uint64_t ct)
@@ -1647,7 +1861,7 @@ void TreeBuilder::SetLocX(uint64_t ct)
       e_->warning("Can't set loclistx when there is no last_var\n");
       return;
     }
-    last_var_->locx_ = ct;
+    last_var_->cold().locx_ = ct;
     last_var_->has_locx = true;
     return;
   }
@@ -1668,7 +1882,7 @@ void TreeBuilder::SetAbs(uint64_t ct)
       e_->warning("Can't set abstract_origin when there is no last_var\n");
       return;
     }
-    last_var_->abs_ = ct;
+    last_var_->cold().abs_ = ct;
     return;
   }
   if (elements_.empty()) {
@@ -1677,9 +1891,9 @@ void TreeBuilder::SetAbs(uint64_t ct)
   }
   // fprintf(g_outf, "SetAbs %lX to %lX\n", ct, elements_.back().id_);
   if ( recent_ )
-    recent_->abs_ = ct;
+    recent_->cold().abs_ = ct;
   else
-    elements_.back().abs_ = ct;
+    elements_.back().cold().abs_ = ct;
 }
 
 void TreeBuilder::SetInlined(int ct)
@@ -1812,7 +2026,11 @@ void TreeBuilder::SetLocVarLocation(param_loc *pl)
     e_->warning("Can't set local var location when there is no comp in top_func\n");
     return;
   }
-  t->m_comp->lvar_locs_[last_var_] = *pl;
+  auto &locs = t->m_comp->lvar_locs_;
+  if ( !locs.empty() && locs.back().first == last_var_ )
+    locs.back().second = *pl;
+  else
+    locs.push_back( { last_var_, *pl } );
 }
 
 TreeBuilder::Element *TreeBuilder::get_owner()
@@ -2,10 +2,17 @@
 #include <string>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <string_view>
 #include <list>
 #include <vector>
 #include <stack>
 #include "Err.h"
+#include "OutSink.h"
+#include "ShardWriter.h"
+#include "ChunkList.h"
+#include "OffsetIndex.h"
 #include "regnames.h"
 #include "GoTypes.h"
 
@@ -214,6 +221,7 @@ struct cu
 };
 
 const char *get_addr_class(unsigned char);
+const char *get_cu_name(int);
 
 class TreeBuilder {
 public:
@@ -348,7 +356,7 @@ public:
   // error logger
   ErrLog *e_;
   // compilation unit data
-  struct cu cu;
+  struct cu cu = {};
   bool is_go() const;
   RegNames *m_rnames = nullptr;
   ISectionNames *m_snames = nullptr;
@@ -359,44 +367,35 @@ public:
   const unsigned char *debug_str_ = nullptr;
   size_t debug_str_size_ = 0;
   bool has_rngx = false; // ranges in .debug_rnglists (so use m_rng2 for lookup) or in old .debug_ranges - then m_rng
-  inline bool in_string_pool(const char *s)
+  inline bool in_string_pool(const char *s) const
   {
     return (s >= (const char *)debug_str_) && (s < (const char *)debug_str_ + debug_str_size_);
   }
   static int is_signed_ate(unsigned char ate);
 protected:
+  friend class UnitStore;
   virtual bool conv2str(uint64_t key, std::string &)
   { return false; }
   virtual void RenderUnit(int last)
   {}
   void put_file_hdr();
-  void put_file_hdr(struct cu *);
+  void put_file_hdr(struct cu *, bool &hdr_dumped);
   int merge_dumped();
   const char *locs_no_ops(param_op_type);
   int can_have_methods(int level);
-  void dump_location(std::string &s, param_loc &pl);
+  void dump_location(std::string &s, const param_loc &pl);
   uint64_t calc_redudant_locs(const param_loc &pl);
 
   ElementType current_element_type_;
   int ns_count = 0;
 
-  typedef std::pair<ElementType, const char*> UniqName;
-  // string_view is not very effective - it holds 8 bytes for ptr + 8 bytes for length
-  typedef std::pair<ElementType, const char *> UniqName2;
-
-  struct Uniq2Comparator {
-    bool operator()(const UniqName2 &a, const UniqName2 &b) const {
-      if ( a.first < b.first ) return true;
-      if ( a.first == b.first ) {
-        return 0 < strcmp(a.second, b.second);
-      }
-      return false;
-    }
-  };
-  struct CSComparator {
-   bool operator()(const char *a, const char *b) const
-    { return 0 < strcmp(a, b); }
-  };
+  // keys of dumped types db: ElementType in low bits and name id above
+  // for names from .debug_str id is just offset in section, other names are interned
+  static constexpr int name_key_shift = 7;
+  static constexpr uint64_t name_key_interned = 0x40;
+  std::unordered_map<std::string_view, uint64_t> m_name_ids;
+  uint64_t name_key(ElementType, const char *);
+  bool find_name_key(ElementType, const char *, uint64_t &) const;
 
   struct dumped_type {
     ElementType type_;
@@ -466,7 +465,7 @@ protected:
       id_ = e.id_;
       level_ = e.level_;
       fname_ = e.fname_;
-      fullname_ = std::move(e.fullname_);
+      cold_ = e.cold_; e.cold_ = nullptr;
       name_ = e.name_;
       link_name_ = e.link_name_;
       size_ = e.size_;
@@ -475,10 +474,7 @@ protected:
       count_ = e.count_;
       addr_ = e.addr_;
       align_ = e.align_;
-      cont_type_ = e.cont_type_;
       spec_ = e.spec_;
-      abs_ = e.abs_;
-      locx_ = e.locx_;
       inlined_ = e.inlined_;
       access_ = e.access_;
       bit_size_ = e.bit_size_;
@@ -503,16 +499,20 @@ protected:
     }
     Element& operator=(Element &&e)
     {
+      if ( this == &e )
+        return *this;
+      delete cold_;
       move(e);
       return *this;
     }
     Element& operator=(const Element &) = delete;
+    // m_comp is owned by compounds pool in ElementList
     virtual ~Element()
     {
-      if ( m_comp != nullptr )
+      if ( cold_ != nullptr )
       {
-        delete m_comp;
-        m_comp = nullptr;
+        delete cold_;
+        cold_ = nullptr;
       }
     }
     Element(ElementType type, uint64_t id, int level, Element *o, NSpace *n) :
@@ -533,17 +533,46 @@ protected:
     const char *fname_ = nullptr,
      *name_ = nullptr,
      *link_name_ = nullptr; // set in SetLinkageName
-    std::string fullname_; // when -F option was used
     size_t size_ = 0;
     uint64_t type_id_ = 0,
       offset_ = 0,
       count_ = 0,
       addr_ = 0,
       align_ = 0,
-      cont_type_ = 0, // for ptr2member
-      spec_ = 0,
-      abs_ = 0, // for DW_AT_abstract_origin
-      locx_ = 0; // offset to debug_loclists section
+      spec_ = 0;
+    // rarely used fields, allocated on first write to keep Element small
+    struct Cold {
+      std::string fullname_; // when -F option was used
+      uint64_t cont_type_ = 0, // for ptr2member
+        abs_ = 0, // for DW_AT_abstract_origin
+        locx_ = 0; // offset to debug_loclists section
+    };
+    Cold *cold_ = nullptr;
+    inline Cold &cold()
+    {
+      if ( cold_ == nullptr )
+        cold_ = new Cold;
+      return *cold_;
+    }
+    inline uint64_t get_abs() const
+    {
+      return cold_ ? cold_->abs_ : 0;
+    }
+    inline uint64_t get_cont_type() const
+    {
+      return cold_ ? cold_->cont_type_ : 0;
+    }
+    inline uint64_t get_locx() const
+    {
+      return cold_ ? cold_->locx_ : 0;
+    }
+    // returns null if there is no file name
+    inline const std::string *get_fullname() const
+    {
+      if ( !cold_ || cold_->fullname_.empty() )
+        return nullptr;
+      return &cold_->fullname_;
+    }
     int inlined_ = 0,
      access_ = 0,
      bit_size_ = 0,
@@ -564,7 +593,7 @@ protected:
 
     inline bool is_abs() const
     {
-      return (abs_) && (addr_);
+      return (addr_) && get_abs();
     }
     inline const char *mangled() const
     {
@@ -657,20 +686,75 @@ protected:
      rval_ref_ :1; // DW_AT_rvalue_reference
   };
 
+  // children never moved when container grows
+  typedef ChunkList<Element, 4, 64, mk_elements> MemberList;
+  typedef ChunkList<Method, 4, 64, mk_elements> MethodList;
+
   struct Compound {
     Compound() = default;
     ~Compound() = default;
     Compound& operator=(Compound &&) = default;
     Compound(Compound &&) = default;
 
-    std::vector<Element> members_;
+    MemberList members_;
     std::vector<Parent> parents_;
     std::vector<EnumItem> enums_;
     std::vector<FormalParam> params_;
-    std::list<Method> methods_;
+    MethodList methods_;
     std::vector<Element *> lvars_; // local vars with -x option
     std::vector<Element *> nested;
-    std::unordered_map<Element *, param_loc> lvar_locs_; // from DecodeAddrLocation when -x option was used
+    // from DecodeAddrLocation when -x option was used, in order of lvars - so sorted by id
+    std::vector<std::pair<Element *, param_loc> > lvar_locs_;
+    const param_loc *find_lvar_loc(const Element *e) const
+    {
+      auto li = std::lower_bound(lvar_locs_.begin(), lvar_locs_.end(), e->id_,
+        [](const std::pair<Element *, param_loc> &l, uint64_t id) { return l.first->id_ < id; });
+      if ( li != lvar_locs_.end() && li->first == e ) return &li->second;
+      return nullptr;
+    }
+  };
+
+  // elements of compilation unit and pool of their compounds, freed in bulk
+  struct ElementList: public ChunkList<Element, 32, 4096, mk_elements>
+  {
+    ChunkList<Compound, 16, 1024, mk_compounds> comps;
+    // heap storage of compounds vectors & cold data, counted in mk_compounds by account
+    size_t heap_ = 0;
+    ElementList() = default;
+    ElementList(ElementList &&o) noexcept
+     : ChunkList<Element, 32, 4096, mk_elements>(std::move(o)), comps(std::move(o.comps)), heap_(o.heap_)
+    {
+      o.heap_ = 0;
+    }
+    ElementList &operator=(ElementList &&o) noexcept
+    {
+      if ( this != &o )
+      {
+        clear();
+        ChunkList<Element, 32, 4096, mk_elements>::operator=(std::move(o));
+        comps = std::move(o.comps);
+        heap_ = o.heap_;
+        o.heap_ = 0;
+      }
+      return *this;
+    }
+    inline Compound *new_compound()
+    {
+      return &comps.emplace_back();
+    }
+    // called when unit is closed or loaded from store with --mem-stats
+    void account();
+    static size_t el_heap(Element &);
+    void clear()
+    {
+      ChunkList<Element, 32, 4096, mk_elements>::clear();
+      comps.clear();
+      if ( heap_ )
+      {
+        g_mem[mk_compounds].sub(heap_, 0);
+        heap_ = 0;
+      }
+    }
   };
 
   int check_dumped_type(Element&);
@@ -686,8 +770,8 @@ protected:
   Element *recent_ = nullptr;
   std::stack<Element *> m_stack;
   std::stack<NSpace *> ns_stack;
-  std::list<Element> elements_;
-  std::unordered_map<uint64_t, dumped_type> m_replaced;
+  ElementList elements_;
+  OffsetIndex<dumped_type> m_replaced;
   // values for const_expr - cleared for each compilation unit if option -g not used
   std::unordered_map<Element *, uint64_t> m_lvalues;
 
@@ -704,17 +788,52 @@ protected:
   std::map<uint64_t, buggy_rng> m_rng;
   bool lookup_range(uint64_t, std::list<std::pair<uint64_t, uint64_t> > &);
 
+  struct dumped_item {
+    uint64_t id;
+    size_t rank;
+    uint64_t hash; // structural hash from type_hash, 0 if was not calculated
+  };
+  // structural hashes of types in current compilation unit - calculated with -k option
+  // named aggregates referenced from other types are hashed by name only, so this is bottom-up
+  // and has no cycles. methods are not included bcs compilers can emit only used ones
+  OffsetIndex<Element *> m_hash_els;
+  std::unordered_map<uint64_t, uint64_t> m_type_hash;
+  std::unordered_set<uint64_t> m_trunc_hash; // top-level hashes with subtrees truncated by depth
+  uint64_t m_hash_truncs = 0;
+  uint64_t type_hash(uint64_t id, int depth);
+  void calc_type_hashes();
+  inline uint64_t get_type_hash(uint64_t id) const
+  {
+    auto hi = m_type_hash.find(id);
+    return hi == m_type_hash.end() ? 0 : hi->second;
+  }
+  // what is compared for types with equal hashes before one of them is dropped
+  // names are from string sections so they stay valid after unit is processed
+  struct type_shape {
+    uint64_t size = 0;
+    // name & offset of members and parents (name is null), name & value of enumerators
+    std::vector<std::pair<const char *, uint64_t>, MemAlloc<std::pair<const char *, uint64_t>, mk_dumped_db> > items;
+  };
+  static void get_shape(const Element &, type_shape &);
+  static bool same_shape(const Element &, const type_shape &);
+  struct NSpace;
+  // true if layout of e with hash already was dumped
+  bool is_variant(NSpace *, uint64_t key, uint64_t hash, const Element &) const;
+  void add_variant(NSpace *, uint64_t key, uint64_t hash, const Element &);
   struct NSpace {
    Element *ns_el_ = nullptr; // to get name - in ns_el->name_, for root - null
    NSpace *parent_ = nullptr; // chains of namespaces, for root - null
-   std::map<const char *, NSpace *, CSComparator> nested;
-   // already dumped types
-   std::map<UniqName, std::pair<uint64_t, size_t> > m_dumped_db;
-   std::map<UniqName2, std::pair<uint64_t, size_t>, Uniq2Comparator> m_dumped_db2;
+   std::unordered_map<std::string_view, NSpace *> nested;
+   // already dumped types, key from name_key
+   std::unordered_map<uint64_t, dumped_item, std::hash<uint64_t>, std::equal_to<uint64_t>,
+     MemAlloc<std::pair<const uint64_t, dumped_item>, mk_dumped_db> > m_dumped_db;
+   // all dumped layouts of types - variant_key of name key & structural hash
+   std::unordered_map<uint64_t, type_shape, std::hash<uint64_t>, std::equal_to<uint64_t>,
+     MemAlloc<std::pair<const uint64_t, type_shape>, mk_dumped_db> > m_variants;
    bool empty = true;
   };
   NSpace ns_root;
-  void clear_namespaces(std::map<const char *, NSpace *, CSComparator> &m)
+  void clear_namespaces(std::unordered_map<std::string_view, NSpace *> &m)
   {
     for ( auto mi: m )
     {
@@ -731,8 +850,10 @@ protected:
   virtual void store_addr(Element *, uint64_t) {}
   // go names - actually this is only for backward refs, for forward use -g option
   int mark_has_go(uint64_t);
-  std::unordered_map<uint64_t, const char *> m_go_types;
-  std::unordered_map<uint64_t, go_ext_attr>  m_go_attrs;
+  std::unordered_map<uint64_t, const char *, std::hash<uint64_t>, std::equal_to<uint64_t>,
+    MemAlloc<std::pair<const uint64_t, const char *>, mk_go_types> > m_go_types;
+  std::unordered_map<uint64_t, go_ext_attr, std::hash<uint64_t>, std::equal_to<uint64_t>,
+    MemAlloc<std::pair<const uint64_t, go_ext_attr>, mk_go_types> > m_go_attrs;
   // tls indexes
   std::unordered_map<uint64_t, int> m_tls;
 };
\ No newline at end of file
@@ -0,0 +1,480 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "UnitStore.h"
+
+static void put_uleb(std::string &b, uint64_t v)
+{
+  do {
+    unsigned char c = v & 0x7f;
+    v >>= 7;
+    if ( v ) c |= 0x80;
+    b += (char)c;
+  } while( v );
+}
+
+static inline void put_sleb(std::string &b, int64_t v)
+{
+  // zigzag
+  put_uleb(b, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static inline void put_ptr(std::string &b, const void *p)
+{
+  b.append((const char *)&p, sizeof(p));
+}
+
+static void put_loc(std::string &b, const param_loc &pl)
+{
+  put_uleb(b, pl.locs.size());
+  for ( auto &l: pl.locs )
+  {
+    put_uleb(b, l.type);
+    put_uleb(b, l.conv);
+    put_sleb(b, l.offset);
+  }
+}
+
+struct UnitStore::reader
+{
+  const unsigned char *p, *end;
+  bool err = false;
+  uint64_t uleb()
+  {
+    uint64_t res = 0;
+    for ( int shift = 0; p < end && shift < 64; shift += 7 )
+    {
+      unsigned char c = *p++;
+      res |= (uint64_t)(c & 0x7f) << shift;
+      if ( !(c & 0x80) ) return res;
+    }
+    err = true;
+    return 0;
+  }
+  int64_t sleb()
+  {
+    uint64_t v = uleb();
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+  }
+  template <typename T>
+  T ptr()
+  {
+    T res = nullptr;
+    if ( p + sizeof(res) > end )
+    {
+      err = true;
+      return res;
+    }
+    memcpy(&res, p, sizeof(res));
+    p += sizeof(res);
+    return res;
+  }
+  void loc(param_loc &pl)
+  {
+    auto n = uleb();
+    for ( uint64_t i = 0; i < n && !err; i++ )
+    {
+      one_param_loc l;
+      l.type = (param_op_type)uleb();
+      l.conv = uleb();
+      l.offset = (int)sleb();
+      pl.locs.push_back(l);
+    }
+  }
+};
+
+UnitStore::~UnitStore()
+{
+  if ( m_fd != -1 )
+    close(m_fd);
+}
+
+bool UnitStore::open_file()
+{
+  const char *dir = getenv("TMPDIR");
+  std::string name = dir ? dir : "/tmp";
+  name += "/dwarfdumpXXXXXX";
+  m_fd = mkstemp(&name[0]);
+  if ( m_fd == -1 )
+  {
+    e_->error("cannot create temp file %s\n", name.c_str());
+    return false;
+  }
+  unlink(name.c_str());
+  return true;
+}
+
+void UnitStore::measure_el(Element &e, uint64_t &min_id, uint64_t &max_id, size_t &mem, size_t el_size)
+{
+  if ( e.id_ < min_id ) min_id = e.id_;
+  if ( e.id_ > max_id ) max_id = e.id_;
+  mem += el_size;
+  if ( e.cold_ )
+    mem += sizeof(*e.cold_) + e.cold_->fullname_.capacity();
+  auto c = e.m_comp;
+  if ( !c ) return;
+  mem += sizeof(*c) + c->parents_.capacity() * sizeof(c->parents_[0]) +
+    c->enums_.capacity() * sizeof(c->enums_[0]) + c->params_.capacity() * sizeof(c->params_[0]) +
+    (c->lvars_.capacity() + c->nested.capacity()) * sizeof(void *) +
+    c->lvar_locs_.capacity() * sizeof(c->lvar_locs_[0]);
+  for ( auto &m: c->members_ )
+    measure_el(m, min_id, max_id, mem, sizeof(m));
+  for ( auto &m: c->methods_ )
+    measure_el(m, min_id, max_id, mem, sizeof(m));
+}
+
+void UnitStore::measure(ElementList &els, uint64_t &min_id, uint64_t &max_id, size_t &mem)
+{
+  min_id = (uint64_t)-1;
+  max_id = mem = 0;
+  for ( auto &e: els )
+    measure_el(e, min_id, max_id, mem, sizeof(e));
+}
+
+void UnitStore::forget_el(Element &e, LValues &lv)
+{
+  lv.erase(&e);
+  if ( !e.m_comp ) return;
+  for ( auto &m: e.m_comp->members_ )
+    forget_el(m, lv);
+  for ( auto &m: e.m_comp->methods_ )
+    forget_el(m, lv);
+}
+
+void UnitStore::forget(ElementList &els, LValues &lv)
+{
+  if ( lv.empty() ) return;
+  for ( auto &e: els )
+    forget_el(e, lv);
+}
+
+void UnitStore::number(Element &e)
+{
+  auto n = m_ord.size() + 1;
+  m_ord[&e] = n;
+  if ( !e.m_comp ) return;
+  for ( auto &m: e.m_comp->members_ )
+    number(m);
+  for ( auto &m: e.m_comp->methods_ )
+    number(m);
+}
+
+void UnitStore::write_element(std::string &b, Element &e, bool is_method, LValues &lv)
+{
+  put_uleb(b, e.type_);
+  put_uleb(b, e.id_);
+  put_sleb(b, e.level_);
+  put_ptr(b, e.ns_);
+  put_uleb(b, ord(e.owner_));
+  put_ptr(b, e.fname_);
+  put_ptr(b, e.name_);
+  put_ptr(b, e.link_name_);
+  put_uleb(b, e.size_);
+  put_uleb(b, e.type_id_);
+  put_uleb(b, e.offset_);
+  put_uleb(b, e.count_);
+  put_uleb(b, e.addr_);
+  put_uleb(b, e.align_);
+  put_uleb(b, e.spec_);
+  put_sleb(b, e.inlined_);
+  put_sleb(b, e.access_);
+  put_sleb(b, e.bit_size_);
+  put_sleb(b, e.bit_offset_);
+  put_uleb(b, e.ate_);
+  put_uleb(b, e.addr_class_);
+  auto lvi = lv.find(&e);
+  unsigned flags = e.noret_ | (e.decl_ << 1) | (e.const_expr_ << 2) | (e.has_range_ << 3) |
+    (e.enum_class_ << 4) | (e.gnu_vector_ << 5) | (e.tensor_ << 6) | (e.has_go << 7) |
+    (e.dumped_ << 8) | (e.has_locx << 9);
+  if ( e.cold_ ) flags |= 1 << 10;
+  if ( e.m_comp ) flags |= 1 << 11;
+  if ( lvi != lv.end() ) flags |= 1 << 12;
+  put_uleb(b, flags);
+  if ( e.cold_ )
+  {
+    put_uleb(b, e.cold_->fullname_.size());
+    b += e.cold_->fullname_;
+    put_uleb(b, e.cold_->cont_type_);
+    put_uleb(b, e.cold_->abs_);
+    put_uleb(b, e.cold_->locx_);
+  }
+  if ( lvi != lv.end() )
+  {
+    put_uleb(b, lvi->second);
+  }
+  if ( is_method )
+  {
+    auto &m = static_cast<Method &>(e);
+    put_sleb(b, m.virt_);
+    put_uleb(b, m.vtbl_index_);
+    put_uleb(b, m.this_arg_);
+    put_uleb(b, m.art_ | (m.def_ << 1) | (m.expl_ << 2) | (m.ref_ << 3) | (m.rval_ref_ << 4));
+  }
+  if ( e.m_comp )
+    write_comp(b, *e.m_comp, lv);
+}
+
+void UnitStore::write_comp(std::string &b, Compound &c, LValues &lv)
+{
+  put_uleb(b, c.members_.size());
+  for ( auto &m: c.members_ )
+    write_element(b, m, false, lv);
+  put_uleb(b, c.parents_.size());
+  for ( auto &p: c.parents_ )
+  {
+    put_uleb(b, p.id);
+    put_uleb(b, p.offset);
+    put_sleb(b, p.access);
+    put_uleb(b, p.virtual_);
+  }
+  put_uleb(b, c.enums_.size());
+  for ( auto &en: c.enums_ )
+  {
+    put_ptr(b, en.name);
+    put_uleb(b, en.value);
+  }
+  put_uleb(b, c.params_.size());
+  for ( auto &p: c.params_ )
+  {
+    put_ptr(b, p.name);
+    put_uleb(b, p.param_id);
+    put_uleb(b, p.id);
+    put_uleb(b, p.locx_);
+    put_loc(b, p.loc);
+    put_uleb(b, p.pdir);
+    put_uleb(b, p.ellipsis | (p.var_ << 1) | (p.art_ << 2) | (p.optional_ << 3) | (p.has_locx << 4));
+  }
+  put_uleb(b, c.methods_.size());
+  for ( auto &m: c.methods_ )
+    write_element(b, m, true, lv);
+  put_uleb(b, c.lvars_.size());
+  for ( auto v: c.lvars_ )
+    put_uleb(b, ord(v));
+  put_uleb(b, c.nested.size());
+  for ( auto n: c.nested )
+    put_uleb(b, ord(n));
+  put_uleb(b, c.lvar_locs_.size());
+  for ( auto &l: c.lvar_locs_ )
+  {
+    put_uleb(b, ord(l.first));
+    put_loc(b, l.second);
+  }
+}
+
+bool UnitStore::spill(ElementList &els, LValues &lv, pos &res)
+{
+  if ( m_fd == -1 && !open_file() )
+    return false;
+  m_ord.clear();
+  for ( auto &e: els )
+    number(e);
+  std::string b;
+  put_uleb(b, els.size());
+  for ( auto &e: els )
+    write_element(b, e, false, lv);
+  m_ord.clear();
+  res.off = m_size;
+  res.size = b.size();
+  for ( size_t done = 0; done < b.size(); )
+  {
+    auto w = pwrite(m_fd, b.data() + done, b.size() - done, m_size + done);
+    if ( w <= 0 )
+    {
+      e_->error("cannot write %ld bytes to units store\n", b.size());
+      return false;
+    }
+    done += w;
+  }
+  m_size += b.size();
+  forget(els, lv);
+  return true;
+}
+
+template <typename F>
+bool UnitStore::read_element(reader &r, F make, bool is_method, ElementList &els, LValues &lv)
+{
+  auto type = (TreeBuilder::ElementType)r.uleb();
+  auto id = r.uleb();
+  int level = (int)r.sleb();
+  auto ns = r.ptr<TreeBuilder::NSpace *>();
+  if ( r.err ) return false;
+  Element &e = make(type, id, level, ns);
+  m_elems.push_back(&e);
+  auto owner = r.uleb();
+  if ( owner )
+    m_fixups.push_back( { &e.owner_, owner } );
+  e.fname_ = r.ptr<const char *>();
+  e.name_ = r.ptr<const char *>();
+  e.link_name_ = r.ptr<const char *>();
+  e.size_ = r.uleb();
+  e.type_id_ = r.uleb();
+  e.offset_ = r.uleb();
+  e.count_ = r.uleb();
+  e.addr_ = r.uleb();
+  e.align_ = r.uleb();
+  e.spec_ = r.uleb();
+  e.inlined_ = (int)r.sleb();
+  e.access_ = (int)r.sleb();
+  e.bit_size_ = (int)r.sleb();
+  e.bit_offset_ = (int)r.sleb();
+  e.ate_ = (unsigned char)r.uleb();
+  e.addr_class_ = (unsigned char)r.uleb();
+  auto flags = r.uleb();
+  e.noret_ = flags & 1;
+  e.decl_ = (flags >> 1) & 1;
+  e.const_expr_ = (flags >> 2) & 1;
+  e.has_range_ = (flags >> 3) & 1;
+  e.enum_class_ = (flags >> 4) & 1;
+  e.gnu_vector_ = (flags >> 5) & 1;
+  e.tensor_ = (flags >> 6) & 1;
+  e.has_go = (flags >> 7) & 1;
+  e.dumped_ = (flags >> 8) & 1;
+  e.has_locx = (flags >> 9) & 1;
+  if ( flags & (1 << 10) )
+  {
+    auto &cold = e.cold();
+    auto len = r.uleb();
+    if ( r.p + len > r.end ) return false;
+    cold.fullname_.assign((const char *)r.p, len);
+    r.p += len;
+    cold.cont_type_ = r.uleb();
+    cold.abs_ = r.uleb();
+    cold.locx_ = r.uleb();
+  }
+  if ( flags & (1 << 12) )
+    lv[&e] = r.uleb();
+  if ( is_method )
+  {
+    auto &m = static_cast<Method &>(e);
+    m.virt_ = (int)r.sleb();
+    m.vtbl_index_ = r.uleb();
+    m.this_arg_ = r.uleb();
+    auto mf = r.uleb();
+    m.art_ = mf & 1;
+    m.def_ = (mf >> 1) & 1;
+    m.expl_ = (mf >> 2) & 1;
+    m.ref_ = (mf >> 3) & 1;
+    m.rval_ref_ = (mf >> 4) & 1;
+  }
+  if ( flags & (1 << 11) )
+  {
+    e.m_comp = els.new_compound();
+    return read_comp(r, *e.m_comp, els, lv);
+  }
+  return !r.err;
+}
+
+bool UnitStore::read_comp(reader &r, Compound &c, ElementList &els, LValues &lv)
+{
+  auto n = r.uleb();
+  for ( uint64_t i = 0; i < n && !r.err; i++ )
+  {
+    auto make = [&](TreeBuilder::ElementType type, uint64_t id, int level, TreeBuilder::NSpace *ns) -> Element & {
+      return c.members_.emplace_back(type, id, level, nullptr, ns);
+    };
+    if ( !read_element(r, make, false, els, lv) ) return false;
+  }
+  n = r.uleb();
+  for ( uint64_t i = 0; i < n && !r.err; i++ )
+  {
+    TreeBuilder::Parent p;
+    p.id = r.uleb();
+    p.offset = r.uleb();
+    p.access = (int)r.sleb();
+    p.virtual_ = r.uleb();
+    c.parents_.push_back(p);
+  }
+  n = r.uleb();
+  for ( uint64_t i = 0; i < n && !r.err; i++ )
+  {
+    TreeBuilder::EnumItem en;
+    en.name = r.ptr<const char *>();
+    en.value = r.uleb();
+    c.enums_.push_back(en);
+  }
+  n = r.uleb();
+  for ( uint64_t i = 0; i < n && !r.err; i++ )
+  {
+    c.params_.emplace_back();
+    auto &p = c.params_.back();
+    p.name = r.ptr<const char *>();
+    p.param_id = r.uleb();
+    p.id = r.uleb();
+    p.locx_ = r.uleb();
+    r.loc(p.loc);
+    p.pdir = (unsigned char)r.uleb();
+    auto pf = r.uleb();
+    p.ellipsis = pf & 1;
+    p.var_ = (pf >> 1) & 1;
+    p.art_ = (pf >> 2) & 1;
+    p.optional_ = (pf >> 3) & 1;
+    p.has_locx = (pf >> 4) & 1;
+  }
+  n = r.uleb();
+  for ( uint64_t i = 0; i < n && !r.err; i++ )
+  {
+    auto make = [&](TreeBuilder::ElementType, uint64_t id, int level, TreeBuilder::NSpace *ns) -> Element & {
+      return c.methods_.emplace_back(id, level, nullptr, ns);
+    };
+    if ( !read_element(r, make, true, els, lv) ) return false;
+  }
+  // pointers to elements are fixed after whole unit was read
+  n = r.uleb();
+  c.lvars_.resize(n);
+  for ( uint64_t i = 0; i < n && !r.err; i++ )
+    m_fixups.push_back( { &c.lvars_[i], r.uleb() } );
+  n = r.uleb();
+  c.nested.resize(n);
+  for ( uint64_t i = 0; i < n && !r.err; i++ )
+    m_fixups.push_back( { &c.nested[i], r.uleb() } );
+  n = r.uleb();
+  c.lvar_locs_.resize(n);
+  for ( uint64_t i = 0; i < n && !r.err; i++ )
+  {
+    m_fixups.push_back( { &c.lvar_locs_[i].first, r.uleb() } );
+    r.loc(c.lvar_locs_[i].second);
+  }
+  return !r.err;
+}
+
+bool UnitStore::load(const pos &p, ElementList &els, LValues &lv)
+{
+  if ( m_fd == -1 || p.off + p.size > m_size )
+    return false;
+  uint64_t pg = sysconf(_SC_PAGESIZE);
+  uint64_t aligned = p.off & ~(pg - 1);
+  size_t delta = p.off - aligned;
+  void *m = mmap(nullptr, p.size + delta, PROT_READ, MAP_PRIVATE, m_fd, aligned);
+  if ( m == MAP_FAILED )
+  {
+    e_->error("cannot mmap units store at %lX\n", p.off);
+    return false;
+  }
+  reader r { (const unsigned char *)m + delta, (const unsigned char *)m + delta + p.size };
+  m_elems.clear();
+  m_fixups.clear();
+  bool res = true;
+  auto n = r.uleb();
+  for ( uint64_t i = 0; i < n && res; i++ )
+  {
+    auto make = [&](TreeBuilder::ElementType type, uint64_t id, int level, TreeBuilder::NSpace *ns) -> Element & {
+      return els.emplace_back(type, id, level, nullptr, ns);
+    };
+    res = read_element(r, make, false, els, lv);
+  }
+  munmap(m, p.size + delta);
+  if ( !res )
+  {
+    e_->error("broken unit in store at %lX\n", p.off);
+    return false;
+  }
+  if ( g_mem_stats )
+    els.account();
+  for ( auto &f: m_fixups )
+    if ( f.second && f.second <= m_elems.size() )
+      *f.first = m_elems[f.second - 1];
+  m_elems.clear();
+  m_fixups.clear();
+  return true;
+}
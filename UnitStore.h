@@ -0,0 +1,58 @@
+#pragma once
+#include "TreeBuilder.h"
+
+// temporary store of compilation units spilled in -g mode when memory budget (-M) exceeded
+// units are serialized to unlinked temp file and mmapped back on load
+// pointers between elements of unit are stored as ordinal numbers of elements in DFS order,
+// pointers to strings and namespaces are stored as is - they live longer than store
+class UnitStore
+{
+ public:
+  typedef TreeBuilder::Element Element;
+  typedef TreeBuilder::Method Method;
+  typedef TreeBuilder::Compound Compound;
+  typedef TreeBuilder::ElementList ElementList;
+  typedef std::unordered_map<Element *, uint64_t> LValues;
+  struct pos {
+    uint64_t off = 0, size = 0;
+  };
+  UnitStore(ErrLog *e): e_(e)
+  {}
+  ~UnitStore();
+  // estimate memory used by unit and range of DIE offsets
+  static void measure(ElementList &, uint64_t &min_id, uint64_t &max_id, size_t &mem);
+  // serialize unit, values of const vars from unit are moved from lv
+  bool spill(ElementList &, LValues &lv, pos &);
+  bool load(const pos &, ElementList &, LValues &lv);
+  // remove values of const vars from unit without serializing it
+  static void forget(ElementList &, LValues &lv);
+  uint64_t size() const
+  {
+    return m_size;
+  }
+ protected:
+  struct reader;
+  ErrLog *e_;
+  int m_fd = -1;
+  uint64_t m_size = 0;
+  // ordinals of elements while writing
+  std::unordered_map<const Element *, uint64_t> m_ord;
+  // elements by ordinal and pointers to fix while reading
+  std::vector<Element *> m_elems;
+  std::vector<std::pair<Element **, uint64_t> > m_fixups;
+  bool open_file();
+  static void forget_el(Element &, LValues &lv);
+  static void measure_el(Element &, uint64_t &min_id, uint64_t &max_id, size_t &mem, size_t el_size);
+  void number(Element &);
+  inline uint64_t ord(const Element *e) const
+  {
+    if ( !e ) return 0;
+    auto oi = m_ord.find(e);
+    return oi == m_ord.end() ? 0 : oi->second;
+  }
+  void write_element(std::string &, Element &, bool is_method, LValues &);
+  void write_comp(std::string &, Compound &, LValues &);
+  template <typename F>
+  bool read_element(reader &, F make, bool is_method, ElementList &, LValues &);
+  bool read_comp(reader &, Compound &, ElementList &, LValues &);
+};
@@ -2,54 +2,190 @@
 #include "ElfFile.h"
 #include "JsonRender.h"
 #include "PlainRender.h"
+#include "BinRender.h"
+#ifdef USE_SQLITE
+#include "SqlRender.h"
+#endif
 #include "nfilter.h"
+#include "MemStats.h"
+#include "Timings.h"
+#include <memory>
+#include <thread>
 
-extern int g_opt_d, g_opt_f, g_opt_F, g_opt_g, g_opt_l, g_opt_m, g_opt_L, g_opt_s, g_opt_v, g_opt_V, g_opt_x, g_opt_z;
+extern int g_opt_a, g_opt_d, g_opt_f, g_opt_F, g_opt_g, g_opt_l, g_opt_m, g_opt_L, g_opt_M, g_opt_s, g_opt_T, g_opt_v, g_opt_V, g_opt_x, g_opt_z;
 extern FILE *g_outf;
 
-int use_json = 0, opt_n = 0;
+int use_json = 0, use_bin = 0, opt_n = 0;
 
 bool need_nested() {
-  return opt_n && !use_json;
+  return opt_n && !use_json && !use_bin;
 }
 
 void usage(const char *prog)
 {
   printf("%s usage: [options] elf-file\n", prog);
   printf("Options:\n");
+  printf("-a addr - find function and chain of inlined subroutines for address. With -f also dump unwind rules\n");
   printf("-d - dump debug info\n");
   printf("-f - add functions\n");
   printf("-F - dump file names for decl_file attribute\n");
   printf("-g - dump all elements in last pass\n");
   printf("-I - original elf file for .debug\n");
   printf("-j - produce json\n");
-  printf("-k - keep already dumped types\n");
+  printf("-k - keep already dumped types with different layout. With -g types are compared by name only\n");
   printf("-l - add levels\n");
   printf("-m - process CUDA mercury\n");
   printf("-n - dump nested types\n");
   printf("-L - process lexical blocks\n");
+  printf("-M mb - memory budget for -g option, units above it are spilled to temp file\n");
   printf("-N - filter file name\n");
   printf("-o out-file\n");
+  printf("-O dir - write output of each unit to own file in dir with manifest.json. Only for text and --ndjson\n");
   printf("-s - dump section names\n");
+  printf("-T num - threads for rendering of units with -g option and for writing of -O files, default is number of cpus\n");
   printf("-v - verbose mode\n");
   printf("-V - dump vars\n");
   printf("-x - dump local vars and locations. Also turns on -L & -V\n");
   printf("-z - dump uncompressed sections\n");
+  printf("--bindb - produce binary database of types, functions and vars, see BinDb.h. Use with -o\n");
+#ifdef USE_SQLITE
+  printf("--sqlite db - load types, functions and vars into sqlite db\n");
+#endif
+  printf("--shard-size=mb - with -O put units into files of this size instead of one file per unit\n");
+  printf("--compact - produce json with numbers, short keys and table of strings\n");
+  printf("--ndjson - produce json with one record per line for each type, function and var\n");
+  printf("--mem-stats[=json] - dump memory usage to stderr for each unit and at exit\n");
+  printf("--timings[=N] - dump json with time of processing phases and N slowest units (default 10) to stderr\n");
   exit(6);
 }
 
+static void dump_reg(RegNames *rn, unsigned int reg)
+{
+  auto name = rn ? rn->reg_name(reg) : nullptr;
+  if ( name )
+    g_sink->put(name);
+  else
+    g_sink->printf("r%d", reg);
+}
+
+void dump_cfa(IGetCFA *cfa, RegNames *rn, uint64_t addr)
+{
+  CFARow row;
+  if ( !cfa->find_cfa(addr, row) )
+    return;
+  g_sink->printf("  cfa %lX-%lX: ", row.start, row.end);
+  if ( row.cfa.type == cfa_reg_off )
+  {
+    dump_reg(rn, row.cfa.reg);
+    g_sink->printf("%+ld", row.cfa.off);
+  } else if ( row.cfa.type == cfa_expr )
+    g_sink->printf("expr(%d)", row.cfa.len);
+  else
+    g_sink->put("undefined");
+  for ( size_t i = 0; i < row.count; i++ )
+  {
+    auto &r = row.regs[i];
+    g_sink->put(' ');
+    dump_reg(rn, r.reg);
+    switch(r.type)
+    {
+      case cfa_undefined: g_sink->put("=undef");
+       break;
+      case cfa_same_value: g_sink->put("=same");
+       break;
+      case cfa_offset: g_sink->printf("=[cfa%+ld]", r.off);
+       break;
+      case cfa_val_offset: g_sink->printf("=cfa%+ld", r.off);
+       break;
+      case cfa_register: g_sink->put('=');
+        dump_reg(rn, r.off);
+       break;
+      case cfa_expression: g_sink->printf("=[expr(%d)]", r.len);
+       break;
+      case cfa_val_expression: g_sink->printf("=expr(%d)", r.len);
+       break;
+    }
+  }
+  g_sink->put('\n');
+}
+
+void dump_addr(const AddrIndex &ai, uint64_t addr)
+{
+  std::vector<const AddrScope *> chain;
+  g_sink->printf("%lX:\n", addr);
+  if ( !ai.find_chain(addr, chain) )
+  {
+    g_sink->put("  not found\n");
+    return;
+  }
+  for ( auto s: chain )
+  {
+    if ( s->tag == Dwarf32::Tag::DW_TAG_lexical_block )
+      continue;
+    auto name = ai.get_name(s);
+    g_sink->printf("  %s %s tag %lX\n", s->tag == Dwarf32::Tag::DW_TAG_inlined_subroutine ? "inlined" : "function",
+      name ? name : "<unknown>", s->id);
+  }
+}
+
+static const struct option s_long_opts[] = {
+  { "mem-stats", optional_argument, nullptr, 0x100 },
+  { "timings", optional_argument, nullptr, 0x101 },
+  { "ndjson", no_argument, nullptr, 0x102 },
+  { "compact", no_argument, nullptr, 0x103 },
+  { "bindb", no_argument, nullptr, 0x104 },
+  { "shard-size", required_argument, nullptr, 0x106 },
+#ifdef USE_SQLITE
+  { "sqlite", required_argument, nullptr, 0x105 },
+#endif
+  { nullptr, 0, nullptr, 0 }
+};
+
 int main(int argc, char* argv[]) 
 {
   FILE *fp = NULL;
   std::string iname;
+  std::vector<uint64_t> addrs;
+  const char *shard_dir = nullptr;
+  int shard_mb = 0;
+#ifdef USE_SQLITE
+  const char *sql_db = nullptr;
+#endif
   // read options
   while(1)
   {
-    int c = getopt(argc, argv, "dfFgjklmnLsvVxo:I:N:");
+    int c = getopt_long(argc, argv, "dfFgjklmnLsvVxa:o:I:M:N:O:T:", s_long_opts, nullptr);
     if ( c == -1 )
       break;
     switch(c)
     {
+      case 0x100:
+         if ( optarg && !strcmp(optarg, "json") )
+           g_mem_stats = 2;
+         else if ( optarg )
+           usage(argv[0]);
+         else
+           g_mem_stats = 1;
+        break;
+      case 0x101:
+         start_timings(optarg ? atoi(optarg) : 10);
+         if ( !g_timings )
+           usage(argv[0]);
+        break;
+      case 0x102:
+         use_json = 2;
+        break;
+      case 0x103:
+         use_json = 3;
+        break;
+      case 0x104:
+         use_bin = 1;
+        break;
+#ifdef USE_SQLITE
+      case 0x105:
+         sql_db = optarg;
+        break;
+#endif
       case 'd': g_opt_d = 1;
         break;
       case 'f': g_opt_f = 1;
@@ -87,9 +223,29 @@ int main(int argc, char* argv[])
          if ( NULL == fp )
            fprintf(stderr, "cannot open file %s, error %s", optarg, strerror(errno));
         break;
+      case 'a':
+         g_opt_a = 1;
+         addrs.push_back(strtoull(optarg, nullptr, 16));
+        break;
       case 'I':
          iname = optarg;
         break;
+      case 'M':
+         g_opt_M = atoi(optarg);
+        break;
+      case 'O':
+         shard_dir = optarg;
+        break;
+      case 0x106:
+         shard_mb = atoi(optarg);
+         if ( shard_mb <= 0 )
+           usage(argv[0]);
+        break;
+      case 'T':
+         g_opt_T = atoi(optarg);
+         if ( g_opt_T < 0 )
+           usage(argv[0]);
+        break;
       case 'N':
          add_filter(optarg);
         break;
@@ -100,10 +256,44 @@ int main(int argc, char* argv[])
   if (optind == argc )
     usage(argv[0]);
 
+  if ( shard_dir && ((use_json && use_json != 2) || use_bin || !addrs.empty()) )
+  {
+    fprintf(stderr, "-O can be used only for text or --ndjson output\n");
+    usage(argv[0]);
+  }
+#ifdef USE_SQLITE
+  if ( shard_dir && sql_db )
+  {
+    fprintf(stderr, "-O can be used only for text or --ndjson output\n");
+    usage(argv[0]);
+  }
+#endif
+
   FLog ferr(stderr);
   TreeBuilder *render = nullptr;
-  if ( use_json )
-    render = new JsonRender(&ferr);
+  JsonRender *jrender = nullptr;
+  BinRender *brender = nullptr;
+#ifdef USE_SQLITE
+  SqlRender *srender = nullptr;
+#endif
+  // for address lookup we don't need to render anything
+  if ( !addrs.empty() )
+    render = new TreeBuilder(&ferr);
+#ifdef USE_SQLITE
+  else if ( sql_db )
+  {
+    render = srender = new SqlRender(&ferr);
+    if ( srender->open(sql_db) != SQLITE_OK )
+    {
+      delete render;
+      return 2;
+    }
+  }
+#endif
+  else if ( use_bin )
+    render = brender = new BinRender(&ferr);
+  else if ( use_json )
+    render = jrender = new JsonRender(&ferr, use_json == 3 ? jm_compact : (use_json == 2 ? jm_ndjson : jm_plain));
   else
     render = new PlainRender(&ferr);
   bool success;
@@ -125,12 +315,61 @@ int main(int argc, char* argv[])
 
     // setup g_outf
     g_outf = (fp == NULL) ? stdout : fp;
+    // with -O output is collected in memory and cut to files by ShardWriter
+    OutSink file_sink(g_outf), mem_sink;
+    OutSink &sink = shard_dir ? mem_sink : file_sink;
+    g_sink = &sink;
+    std::unique_ptr<ShardWriter> shards;
+    if ( shard_dir )
+    {
+      unsigned threads = g_opt_T ? g_opt_T : std::thread::hardware_concurrency();
+      shards.reset(new ShardWriter(&sink, shard_dir, use_json ? "ndjson" : "txt", shard_mb, threads));
+      if ( !shards->open() )
+      {
+        delete render;
+        return 2;
+      }
+      g_shards = shards.get();
+    }
 
-    if ( use_json )
-      fprintf(g_outf, "{");
-    file.GetAllClasses();
-    if ( use_json )
-      fprintf(g_outf, "}\n");
+    if ( !addrs.empty() )
+    {
+      AddrIndex ai;
+      file.SetAddrIndex(&ai);
+      file.GetUnitsByAddr(addrs);
+      if ( g_opt_v )
+        g_sink->printf("// address index: %ld segments\n", ai.size());
+      for ( auto a: addrs )
+      {
+        dump_addr(ai, a);
+        if ( g_opt_f )
+          dump_cfa(&file, render->m_rnames, a);
+      }
+    } else {
+      if ( jrender )
+        jrender->begin_output();
+      file.GetAllClasses();
+      if ( jrender )
+        jrender->end_output();
+      if ( brender )
+        brender->end_output();
+#ifdef USE_SQLITE
+      if ( srender )
+        srender->finish();
+#endif
+    }
+    if ( g_shards )
+    {
+      if ( !g_shards->finish() )
+        fprintf(stderr, "cannot write files to %s\n", shard_dir);
+      g_shards = nullptr;
+    }
+    sink.flush();
+    g_sink = nullptr;
+    if ( g_mem_stats )
+      dump_mem_stats(stderr, nullptr);
+    if ( g_timings )
+      dump_timings(stderr);
   }
 
   if ( fp != NULL )
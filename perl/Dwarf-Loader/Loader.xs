@@ -77,14 +77,14 @@ class PerlRenderer: public TreeBuilder
    PDWARF(DParamIter, std::vector<FormalParam>) };
    PDWARF(DParent, Parent) };
    PDWARF(DParentIter, std::vector<Parent>) };
-   PDWARF(DMemberIter, std::vector<Element>) };
+   PDWARF(DMemberIter, MemberList) };
    PDWARF(DLVarIter, std::vector<Element *>) };
    PDWARF(DEnumIter, std::vector<EnumItem>)
      char ate_; // from Element::ate_ for proper enums decoding
    };
    struct DMethodIter {
      ~DMethodIter();
-     DMethodIter(struct IDwarf *_e, std::list<Method> &m): e(_e) {
+     DMethodIter(struct IDwarf *_e, MethodList &m): e(_e) {
        t = new std::vector<Element *>;
        t->reserve( m.size() );
        for ( auto &im: m ) t->push_back( &im );
@@ -277,7 +277,7 @@ class PerlRenderer: public TreeBuilder
      return nullptr;
    }
 
-   std::list< std::list<Element> > m_storage;
+   std::list< ElementList > m_storage;
    /* main maps for names -> Element & ID -> Element */
    std::unordered_map< std::string_view, Element *> m_names;
    std::unordered_map< uint64_t, Element *> m_id;
@@ -722,7 +722,7 @@ abs(SV *self)
  INIT:
   auto *d = dwarf_magic_ext<PerlRenderer::DElem>(self, 1, &delem_magic_vt);
  CODE:
-  RETVAL = d->t->abs_;
+  RETVAL = d->t->get_abs();
  OUTPUT:
   RETVAL
 
@@ -785,7 +785,7 @@ cont_id(SV *self)
  INIT:
   auto *d = dwarf_magic_ext<PerlRenderer::DElem>(self, 1, &delem_magic_vt);
  CODE:
-  RETVAL = d->t->cont_type_;
+  RETVAL = d->t->get_cont_type();
  OUTPUT:
   RETVAL
 
@@ -797,11 +797,11 @@ cont(SV *self)
   MAGIC* magic;
   auto *d = dwarf_magic_ext<PerlRenderer::DElem>(self, 1, &delem_magic_vt);
  PPCODE:
-  if ( !d->t->cont_type_ ) {
+  if ( !d->t->get_cont_type() ) {
     ST(0) = &PL_sv_undef;
     XSRETURN(1);
   }
-  auto c_obj = d->e->pr.by_id(d->t->cont_type_);
+  auto c_obj = d->e->pr.by_id(d->t->get_cont_type());
   if ( !c_obj ) {
     ST(0) = &PL_sv_undef;
     XSRETURN(1);
@@ -1069,11 +1069,12 @@ fname(SV *self)
  INIT:
   auto *d = dwarf_magic_ext<PerlRenderer::DElem>(self, 1, &delem_magic_vt);
  PPCODE:
-  if ( d->t->fullname_.empty() ) {
+  auto fname = d->t->get_fullname();
+  if ( !fname ) {
     ST(0) = &PL_sv_undef;
     XSRETURN(1);
   }
-  ST(0) = sv_2mortal( newSVpv( d->t->fullname_.c_str(), d->t->fullname_.size() ) );
+  ST(0) = sv_2mortal( newSVpv( fname->c_str(), fname->size() ) );
   XSRETURN(1);
 
 void
@@ -4,14 +4,75 @@
 
 struct LocListXItem;
 
+// hits/misses of decoded loclists/rnglists cache
+struct ListCacheStat
+{
+  size_t loc_hits = 0,
+   loc_misses = 0,
+   rng_hits = 0,
+   rng_misses = 0;
+};
+
 struct IGetLoclistX
 {
   virtual bool get_loclistx(uint64_t off, std::list<LocListXItem> &, uint64_t) = 0;
+  // memoized version of get_loclistx, returned list is owned by implementor. nullptr if cannot be decoded
+  virtual const std::list<LocListXItem> *get_cached_loclistx(uint64_t off, uint64_t) = 0;
   virtual bool get_rnglistx(int64_t off, uint64_t base_addr, unsigned char addr_size,
    /* out param */ std::list<std::pair<uint64_t, uint64_t> > &) = 0;
+  virtual const ListCacheStat *get_cache_stat() const = 0;
+  // pc can be any address inside function
   virtual bool find_dfa(uint64_t pc, uint64_t &res) = 0;
 };
 
+// compiled unwind rule for register or CFA
+enum cfa_rule_type
+{
+  cfa_undefined = 0,
+  cfa_same_value,
+  cfa_offset,         // saved at CFA + off
+  cfa_val_offset,     // value is CFA + off
+  cfa_register,       // saved in register off
+  cfa_expression,     // saved at address from expr
+  cfa_val_expression, // value is result of expr
+  cfa_reg_off,        // for CFA only - reg + off
+  cfa_expr,           // for CFA only - result of expr
+};
+
+struct CFARule
+{
+  union {
+    int64_t off = 0;
+    const unsigned char *expr;
+  };
+  uint32_t len = 0;  // length of expr
+  uint16_t reg = 0;
+  unsigned char type = cfa_undefined;
+  inline bool is_expr() const
+  {
+    return type == cfa_expr || type == cfa_expression || type == cfa_val_expression;
+  }
+  bool operator==(const CFARule &r) const
+  {
+    if ( type != r.type || reg != r.reg || len != r.len ) return false;
+    return is_expr() ? expr == r.expr : off == r.off;
+  }
+};
+
+// unwind rules for range of addresses
+struct CFARow
+{
+  uint64_t start, end;
+  CFARule cfa;
+  const CFARule *regs; // sorted by reg
+  size_t count;
+};
+
+struct IGetCFA
+{
+  virtual bool find_cfa(uint64_t pc, CFARow &) = 0;
+};
+
 struct ISectionNames
 {
   virtual int find_sname(uint64_t, std::string &) = 0;